@@ -0,0 +1,359 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../inc/arrayops.h"
+#include "../inc/batch.h"
+#include "../inc/cache.h"
+#include "../inc/daemon.h"
+#include "../inc/lexer.h"
+#include "../inc/profiler.h"
+#include "../inc/interpreter.h"
+
+/* HELPERS */
+// returns the fastest wall time of several runs of a function, in seconds
+double time_best(const std::function<void()>& fn, int reps = 5){
+    double best = 1e30;
+    for (int i = 0; i < reps; i++){
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed.count() < best)
+            best = elapsed.count();
+    }
+    return best;
+}
+// generates a script of roughly the given size by repeating a block that uses every kind of token
+std::string generate_script(size_t size){
+    const std::string snippet = R"(begin
+    let int ctr_a = 0;
+    let float ratio = 1.25;
+    let char letter = 'q';
+    let bool flag = true;
+    while (ctr_a < 19)
+        if ((ctr_a % 2) == 0 && flag != false || !flag)
+            ctr_a = ctr_a + 1;
+        else
+            ctr_a = (ctr_a * 2) - (ctr_a / 3) ** 1;
+        end
+        print ctr_a ' ' letter;
+    end
+    println ratio [int][5];
+end
+)";
+    std::string script;
+    script.reserve(size + snippet.size());
+    while (script.size() < size)
+        script += snippet;
+    return script;
+}
+
+/* BENCHMARKS */
+void bench_lexer(){
+    std::string script = generate_script(8 * 1024 * 1024);
+    std::vector<Token> tokens;
+    double secs = time_best([&](){
+        tokens.clear();
+        tokenize(script, tokens);
+    });
+    std::cout << "lexer: " << tokens.size() << " tokens from " << script.size() / (1024 * 1024) << " MB in " << secs * 1000 << " ms ("
+              << script.size() / secs / (1024 * 1024) << " MB/s)" << std::endl;
+}
+
+// lexes a large script with an increasing number of threads, to show how the parallel lexer scales with the number of cores
+void bench_parallel_lexer(){
+    std::string script = generate_script(64 * 1024 * 1024);
+    std::vector<Token> tokens;
+    double serial = time_best([&](){
+        tokens.clear();
+        tokenize(script, tokens);
+    }, 3);
+    std::cout << "parallel lexer: " << script.size() / (1024 * 1024) << " MB, serial in " << serial * 1000 << " ms" << std::endl;
+    for (unsigned threads = 1; threads <= std::max(4u, std::thread::hardware_concurrency()); threads *= 2){
+        double secs = time_best([&](){
+            tokens.clear();
+            tokenize_parallel(script, tokens, threads);
+        }, 3);
+        std::cout << "    " << threads << " threads: " << secs * 1000 << " ms (" << script.size() / secs / (1024 * 1024) << " MB/s, "
+                  << serial / secs << "x)" << std::endl;
+    }
+}
+
+// a tight arithmetic loop, dominated by the cost of evaluating arithmetic and comparisons
+const std::string LOOP_SCRIPT = R"(begin
+    let int ctr = 0;
+    let int prev = 0;
+    let int curr = 1;
+    let int tmp = 0;
+    while (ctr < 2000000)
+        tmp = (curr + prev) % 1000;
+        prev = curr;
+        curr = tmp;
+        ctr = ctr + 1;
+    end
+    curr;
+end
+)";
+
+// runs the arithmetic loop on a backend
+void bench_loop(const std::string& name, Backend backend){
+    Interpreter interpreter;
+    interpreter.set_backend(backend);
+    double secs = time_best([&](){
+        if (interpreter.run(LOOP_SCRIPT))
+            interpreter.display_err();
+    }, 3);
+    std::cout << name << ": 2000000 iterations in " << secs * 1000 << " ms (" << 2000000 / secs / 1e6 << " M iterations/s)" << std::endl;
+}
+void bench_tree_walker(){
+    bench_loop("tree walker", TreeWalker);
+}
+void bench_stack_vm(){
+    bench_loop("stack vm", StackVM);
+}
+void bench_register_vm(){
+    bench_loop("register vm", RegisterVM);
+}
+void bench_jit(){
+    bench_loop("jit", Tiered);
+}
+void bench_flat(){
+    bench_loop("flat tree walker", FlatTreeWalker);
+}
+
+// compares starting a long script from its source with starting it from its .nebc cache
+void bench_cache(){
+    const std::string path = "nebula_bench_cache.neb";
+    std::ofstream file(path, std::ios::trunc);
+    file << "let int x = 0\nlet float y = 0.5\n";
+    for (int i = 0; i < 20000; i++)
+        file << "x = (x + " << i + 1 << ") % 977\ny = y * 1.5 - 0.25\n";
+    file.close();
+    double secs[2];
+    for (int cached = 0; cached < 2; cached++){
+        std::remove(cache_path(path).c_str());
+        secs[cached] = time_best([&](){
+            Interpreter interpreter;
+            interpreter.set_cache(cached);
+            if (interpreter.run_file(path))
+                interpreter.display_err();
+        });
+    }
+    std::remove(cache_path(path).c_str());
+    std::remove(path.c_str());
+    std::cout << "cache: 40000 statements in " << secs[0] * 1000 << " ms from source, " << secs[1] * 1000 << " ms from cache" << std::endl;
+}
+
+// fills a million element int array and sums it, the elements are stored unboxed so both passes are linear in memory
+void bench_array(){
+    const int count = 1000000;
+    long long total = 0;
+    size_t bytes = 0;
+    double secs = time_best([&](){
+        NebulaArray arr(INT);
+        for (int i = 0; i < count; i++)
+            arr.put(i, i);
+        total = 0;
+        const int* data = arr.data<int>();
+        for (int i = 0; i < arr.length(); i++)
+            total += data[i];
+        bytes = arr.bytes_used();
+    });
+    std::cout << "array: " << count << " ints filled and summed in " << secs * 1000 << " ms, " << bytes / 1024 << " KB (sum "
+              << total << ")" << std::endl;
+}
+
+// adds two million element float arrays and sums the result, with the scalar loops and with the widest kernels available
+void bench_simd(){
+    const int count = 1000000;
+    Value lhs(FLOAT, true), rhs(FLOAT, true);
+    for (int i = 0; i < count; i++){
+        lhs.as_arr().put(i, i * 0.5);
+        rhs.as_arr().put(i, 1.0 - i);
+    }
+    SimdLevel detected = get_simd_level();
+    const char* names[] = {"scalar", "sse2", "avx2"};
+    for (SimdLevel level : {SimdScalar, detected}){
+        set_simd_level(level);
+        double total = 0;
+        double secs = time_best([&](){
+            total = array_sum(array_arith(ArithAdd, lhs, rhs)).as<double>();
+        });
+        std::cout << "simd (" << names[level] << "): " << count << " floats added and summed in " << secs * 1000 << " ms (sum "
+                  << total << ")" << std::endl;
+    }
+    set_simd_level(detected);
+}
+
+// prints a million lines of fib.neb style output to /dev/null, so the cost is formatting and buffering rather than the terminal
+void bench_print(){
+    const std::string script = R"(let int prev = 0
+let int curr = 1
+let int i = 0
+let float ratio = 0.5
+while (i < 1000000)
+    let int next = (prev + curr) % 1000000
+    prev = curr
+    curr = next
+    ratio = ratio * 1.25
+    println i ' ' curr ' ' ratio
+    i = i + 1
+end
+)";
+    std::ofstream null("/dev/null");
+    const char* names[] = {"line", "size", "exit"};
+    for (FlushPolicy policy : {FlushLine, FlushSize, FlushExit}){
+        double secs = time_best([&](){
+            Interpreter interpreter;
+            interpreter.set_output(null);
+            interpreter.set_flush_policy(policy);
+            if (interpreter.run(script))
+                interpreter.display_err();
+        }, 3);
+        std::cout << "print (flush " << names[policy] << "): 1000000 lines in " << secs * 1000 << " ms" << std::endl;
+    }
+}
+
+// runs a script made of large if blocks, only one of which is taken, with and without lazy parsing of block bodies
+void bench_lazy(){
+    std::string script = "let int taken = 3\nlet int total = 0\n";
+    for (int i = 0; i < 200; i++){
+        script += "if taken == " + std::to_string(i) + "\n";
+        for (int j = 0; j < 200; j++)
+            script += "  total = (total + " + std::to_string(j + 1) + ") * 2\n";
+        script += "end\n";
+    }
+    double secs[2];
+    for (int lazy = 0; lazy < 2; lazy++){
+        secs[lazy] = time_best([&](){
+            Interpreter interpreter;
+            interpreter.set_backend(TreeWalker);
+            interpreter.set_lazy(lazy);
+            if (interpreter.run(script))
+                interpreter.display_err();
+        });
+    }
+    std::cout << "lazy: " << script.size() / 1024 << " KB script in " << secs[0] * 1000 << " ms parsed eagerly, " << secs[1] * 1000
+              << " ms parsed lazily" << std::endl;
+}
+
+// compares the latency of running a small script by starting a nebula process for it with sending it to a running daemon
+void bench_daemon(){
+    const std::string binary = "./nebula";
+    if (access(binary.c_str(), X_OK)){
+        std::cout << "daemon: skipped, run the benchmarks from the directory nebula was built in" << std::endl;
+        return;
+    }
+    const std::string path = std::filesystem::absolute("nebula_bench_daemon.neb").string();
+    std::ofstream file(path, std::ios::trunc);
+    file << "let int i = 0\nlet int total = 0\nwhile (i < 100)\ntotal = total + i\ni = i + 1\nend\nprintln total\n";
+    file.close();
+    const int runs = 200;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; i++){
+        pid_t pid = fork();
+        if (pid == 0){
+            int null = open("/dev/null", O_WRONLY);
+            dup2(null, STDOUT_FILENO);
+            execl(binary.c_str(), binary.c_str(), path.c_str(), nullptr);
+            _exit(127);
+        }
+        waitpid(pid, nullptr, 0);
+    }
+    std::chrono::duration<double> process = std::chrono::steady_clock::now() - start;
+    const std::string socket_path = "nebula_bench_daemon.sock";
+    Daemon daemon(socket_path);
+    std::thread server([&daemon]{ daemon.serve(); });
+    DaemonReply reply;
+    while (!send_request(socket_path, RunPath, path, reply))
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; i++)
+        send_request(socket_path, RunPath, path, reply);
+    std::chrono::duration<double> served = std::chrono::steady_clock::now() - start;
+    send_request(socket_path, Shutdown, "", reply);
+    server.join();
+    std::remove(path.c_str());
+    std::cout << "daemon: " << process.count() * 1e6 / runs << " us per run with fork/exec, " << served.count() * 1e6 / runs
+              << " us per request to a daemon" << std::endl;
+}
+
+// runs the same batch of scripts on more and more threads, each script is an independent isolate so throughput should scale with cores
+void bench_batch(){
+    std::vector<std::string> scripts(64, R"(let int i = 0
+let int total = 0
+while (i < 200000)
+    total = total + 2
+    i = i + 1
+end
+total
+)");
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    double base = 0;
+    for (unsigned threads = 1; threads <= cores; threads *= 2){
+        BatchRunner runner(threads);
+        double secs = time_best([&](){ runner.run(scripts); }, 3);
+        if (threads == 1)
+            base = secs;
+        std::cout << "batch: " << scripts.size() << " scripts on " << threads << " threads in " << secs * 1000 << " ms ("
+                  << scripts.size() / secs << " scripts/s, " << base / secs << "x)" << std::endl;
+    }
+}
+
+// runs the arithmetic loop on the tree walker with and without a profiler, the cost of profiling being off shows in bench_tree_walker
+void bench_profile(){
+    double secs[2];
+    for (int profiled = 0; profiled < 2; profiled++){
+        Profiler profiler;
+        Interpreter interpreter;
+        interpreter.set_backend(TreeWalker);
+        interpreter.set_profiler(profiled ? &profiler : nullptr);
+        secs[profiled] = time_best([&](){
+            if (interpreter.run(LOOP_SCRIPT))
+                interpreter.display_err();
+        }, 3);
+    }
+    std::cout << "profile: 2000000 iterations in " << secs[0] * 1000 << " ms unprofiled, " << secs[1] * 1000 << " ms profiled ("
+              << secs[1] / secs[0] << "x)" << std::endl;
+}
+
+int main(int argc, char** argv){
+    std::vector<std::pair<std::string, std::function<void()>>> benchmarks = {
+        {"lexer", bench_lexer},
+        {"parallel_lexer", bench_parallel_lexer},
+        {"tree_walker", bench_tree_walker},
+        {"stack_vm", bench_stack_vm},
+        {"register_vm", bench_register_vm},
+        {"jit", bench_jit},
+        {"flat", bench_flat},
+        {"cache", bench_cache},
+        {"lazy", bench_lazy},
+        {"array", bench_array},
+        {"simd", bench_simd},
+        {"print", bench_print},
+        {"daemon", bench_daemon},
+        {"batch", bench_batch},
+        {"profile", bench_profile},
+    };
+    // run every benchmark, or only those named on the command line
+    for (auto& [name, fn] : benchmarks){
+        bool selected = argc == 1;
+        for (int i = 1; i < argc; i++)
+            selected |= name == argv[i];
+        if (selected)
+            fn();
+    }
+    return 0;
+}
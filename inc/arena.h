@@ -0,0 +1,49 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+#include <string_view>
+#include <utility>
+
+/*
+    a bump pointer allocator that owns everything the parser creates for a single parse. Objects are laid out contiguously in
+    allocation order, and are never destroyed individually: the whole arena is released at once by reset(). Because of this,
+    anything allocated in the arena must keep all of its memory in the arena as well (e.g. std::pmr containers built on it)
+*/
+class Arena: public std::pmr::memory_resource{
+    public:
+        Arena(size_t chunk_size = 64 * 1024);
+        ~Arena();
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+        template <typename T, typename... Args>
+        T* make(Args&&... args);
+        std::string_view copy_str(std::string_view str);
+        void reset();
+        size_t bytes_used() {return this->used;}
+    private:
+        struct Chunk{
+            Chunk* next;
+            size_t size;
+        };
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        // memory is only released all at once, when the arena is reset or destroyed
+        void do_deallocate(void*, size_t, size_t) override {}
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {return this == &other;}
+        void* grow(size_t bytes, size_t alignment);
+        Chunk* head {nullptr};
+        std::byte* curr {nullptr};
+        std::byte* end {nullptr};
+        size_t chunk_size;
+        size_t used {0};
+};
+
+// constructs a new object in the arena
+template <typename T, typename... Args>
+T* Arena::make(Args&&... args){
+    return new (this->allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+}
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef ARRAYOPS_H
+#define ARRAYOPS_H
+
+#include "../inc/nodes.hpp"
+#include "../inc/values.hpp"
+
+// vector kernels are only built for x86-64 with GCC or Clang, everywhere else arrays are always processed one element at a time
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__)) && !defined(NEBULA_NO_SIMD)
+#define NEBULA_SIMD 1
+#endif
+
+// the widest instructions the array kernels may use, each level includes those below it
+enum SimdLevel{
+    SimdScalar,
+    SimdSSE2,
+    SimdAVX2
+};
+
+SimdLevel detect_simd();
+SimdLevel get_simd_level();
+void set_simd_level(SimdLevel level);
+
+/*
+    element-wise arithmetic on int and float arrays, computing lhs <op> rhs for every element. Either operand may be a scalar of
+    the array's type, which is applied to every element. Addition, subtraction and multiplication (and division of floats) use
+    vector kernels at the current level, the other operators fall back to ArithNode::calculate per element
+*/
+Value array_arith(Operator op, const Value& lhs, const Value& rhs);
+// reductions over int and float arrays, which evaluate to a scalar of the array's type
+Value array_sum(const Value& arr);
+Value array_min(const Value& arr);
+Value array_max(const Value& arr);
+Value array_dot(const Value& lhs, const Value& rhs);
+
+#endif
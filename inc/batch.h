@@ -0,0 +1,37 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <string>
+#include <vector>
+
+#include "../inc/interpreter.h"
+#include "../inc/values.hpp"
+
+// the outcome of one script run by a BatchRunner
+struct ScriptResult{
+    int status {1}; // 0 on success, 1 on any error, like Interpreter::run
+    std::string output; // everything the script printed
+    ValueType result_type {NULL_TYPE};
+    std::string result; // the script's result, formatted as it would be printed
+    std::string err_msg;
+};
+
+/*
+    runs many independent scripts across a pool of threads. Every script is run by its own interpreter, which owns its parser,
+    scopes and output, and the tables interpreters share are never written to, so scripts run in parallel without any locking
+    and can't see each other's globals. Results are returned in the same order as the scripts
+*/
+class BatchRunner{
+    public:
+        BatchRunner(unsigned threads = 0);
+        std::vector<ScriptResult> run(const std::vector<std::string>& scripts);
+        void set_backend(Backend backend) {this->backend = backend;}
+        void set_opt_level(int level) {this->opt_level = level;}
+        unsigned get_threads() {return this->threads;}
+    private:
+        unsigned threads;
+        Backend backend {RegisterVM};
+        int opt_level {1};
+};
+
+#endif
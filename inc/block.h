@@ -1,12 +1,15 @@
 #ifndef BLOCK_H
 #define BLOCK_H
 
-#include <stack>
+#include <memory_resource>
 #include <vector>
 
+#include "../inc/jit.h"
 #include "../inc/nodes.hpp"
 #include "../inc/symtable.h"
 
+class Parser;
+
 enum BlockType{
     Base,
     Eval,
@@ -17,26 +20,33 @@ enum BlockType{
 class BlockNode: public Node{
     public:
         BlockNode() {this->node_type = Block_N; this->block_t = Base;}
-        BlockNode(SymbolTable* scope_ptr);
-        ~BlockNode();
+        BlockNode(SymbolTable* scope_ptr, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
         BlockType block_type() {return this->block_t;}
         SymbolTable* get_scope() {return this->scope;}
+        // a deferred block's body is parsed as soon as anything needs its statements
+        const std::pmr::vector<Node*>& get_statements() {if (this->parser) this->parse_body(); return this->statements;}
+        void set_statement(size_t index, Node* statement) {this->statements[index] = statement;}
         virtual Node* pop_statement();
         virtual size_t statement_count() {return this->statements.size();}
         virtual Value eval() override;
         virtual void push_statement(Node* statement);
+        void defer(Parser* parser, size_t body_pos);
+        bool is_deferred() {return this->parser != nullptr;}
+        void parse_body();
     protected:
-        std::stack<Value> eval_stack;
-        std::vector<Node*> statements;
+        std::pmr::vector<Node*> statements;
         SymbolTable* scope;
         BlockType block_t;
+        Parser* parser {nullptr}; // the parser that will build the block's body, if that has been deferred until it's needed
+        size_t body_pos {0}; // the index of the first token of a deferred body
 };
 
 class EvalBlockNode: public BlockNode{
     public: 
-        EvalBlockNode() {this->node_type = Block_N; this->block_t = Eval;}
+        EvalBlockNode(std::pmr::memory_resource* resource = std::pmr::get_default_resource()): BlockNode(nullptr, resource) {this->block_t = Eval;}
         Value eval() override;
         void set_body(Node* body) {this->body = body;}
+        Node* get_body() {return this->body;}
         void push_statement(Node* statement) override {this->body = statement;};
     private:
         Node* body;
@@ -44,25 +54,40 @@ class EvalBlockNode: public BlockNode{
 
 class CondBlockNode: public BlockNode{
     public:
-        CondBlockNode(SymbolTable* scope_ptr, Node* cond_ptr);
-        ~CondBlockNode();
+        CondBlockNode(SymbolTable* scope_ptr, Node* cond_ptr, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
         Value eval() override;
         void set_else(BlockNode* else_body);
+        void set_deferred_else() {this->deferred_else = true;}
+        Node* get_condition() {return this->condition;}
+        void set_condition(Node* condition) {this->condition = condition;}
+        BlockNode* get_else() {if (this->parser) this->parse_body(); return this->else_body;}
         Node* pop_statement() override;
         void push_statement(Node* statement) override;
         size_t statement_count() override;
     private:
         bool eval_else {false};
+        bool deferred_else {false}; // whether the deferred body of the block includes an else clause
         Node* condition;
         BlockNode* else_body {nullptr};
 };
 
+/*
+    a while loop. Once it has run enough iterations to be considered hot, it tries to compile itself to native code, which is then
+    used whenever the loop is evaluated, so long as its variables still hold the types it was compiled for
+*/
 class LoopBlockNode: public BlockNode{
     public:
-        LoopBlockNode(SymbolTable* scope_ptr, Node* cond_ptr);
+        static constexpr uint32_t HOT_ITERATIONS = 1000;
+        LoopBlockNode(SymbolTable* scope_ptr, Node* cond_ptr, std::pmr::memory_resource* resource = std::pmr::get_default_resource(), CodeHeap* code_heap = nullptr);
         Value eval() override;
+        Node* get_condition() {return this->condition;}
+        void set_condition(Node* condition) {this->condition = condition;}
+        bool is_compiled() {return this->native != nullptr;}
     private:
         Node* condition;
+        CodeHeap* code_heap; // where the loop is compiled to once it's hot, nullptr if it never will be or already has been
+        NativeLoop* native {nullptr};
+        uint32_t iterations {0};
 };
 
 
@@ -0,0 +1,48 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../inc/values.hpp"
+
+enum OpCode: uint8_t{
+    OpConst,     // pushes constants[arg]
+    OpNull,      // pushes a null value
+    OpLoad,      // pushes the value of vars[arg]
+    OpStore,     // pops a value, assigns it to vars[arg] and pushes the new value of the variable
+    OpArith,     // pops two values and pushes the result of the arithmetic operator in arg
+    OpComp,      // pops two values and pushes the result of the comparison operator in arg
+    OpLogic,     // pops two values and pushes the result of the logical operator in arg
+    OpPop,       // discards the top value of the stack
+    OpJump,      // jumps to the instruction at arg
+    OpJumpFalse, // pops a boolean and jumps to arg if it is false
+    OpPrint,     // pops a value and writes it to stdout
+    OpPrintEnd,  // ends a print statement, writing a newline if arg is set, and pushes a null value
+    OpTrap,      // throws messages[arg] as a runtime error
+    OpHalt       // stops execution, the top of the stack is the program's result
+};
+
+struct Instruction{
+    OpCode op;
+    uint32_t arg;
+};
+
+// a reference to a variable's slot in the environment, along with the type it was declared as
+struct VarRef{
+    unsigned depth;
+    unsigned slot;
+    ValueType type;
+};
+
+// a compiled program, instructions reference the constant, variable and message pools by index
+struct Chunk{
+    std::vector<Instruction> code;
+    std::vector<Value> constants;
+    std::vector<VarRef> vars;
+    std::vector<std::string> messages;
+    void clear();
+};
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "../inc/regvm.h"
+
+/*
+    compiled programs are cached in .nebc files next to their source, so a script that hasn't changed can skip lexing, parsing
+    and compilation entirely. A cache file holds the register program compiled from the source, stamped with a key derived from
+    the source's contents, and is only used if that key still matches
+*/
+uint64_t cache_key(std::string_view source, int opt_level);
+std::string cache_path(const std::string& source_path);
+std::string encode_program(uint64_t key, const RegProgram& program);
+bool decode_program(std::string_view data, uint64_t key, RegProgram& program);
+bool save_program(const std::string& path, uint64_t key, const RegProgram& program);
+bool load_program(const std::string& path, uint64_t key, RegProgram& program);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef CEMITTER_H
+#define CEMITTER_H
+
+#include <deque>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../inc/values.hpp"
+#include "../inc/nodes.hpp"
+#include "../inc/block.h"
+
+/*
+    translates a type checked program into a standalone C translation unit, which prints exactly what the interpreter would.
+    Every variable becomes a local of main, and every expression must have a type known statically, anything that can only be
+    resolved at runtime (such as pointers) is reported as an error instead
+*/
+class CEmitter{
+    public:
+        void emit(const std::deque<Node*>& statements, std::ostream& out);
+    private:
+        void emit_statement(Node* node, int depth);
+        void emit_statements(BlockNode* block, int depth);
+        std::string expr(Node* node);
+        std::string binary(Node* lhs, Node* rhs, const std::string& open, const std::string& sep, const std::string& close);
+        ValueType type_of(Node* node);
+        std::string var_name(VarNode* var);
+        std::string literal(const Value& val);
+        std::string alloc_temp(ValueType type);
+        void require_checked(Node* node);
+        [[noreturn]] void error(Node* node, const std::string& msg);
+        std::ostringstream body;
+        std::map<std::string, ValueType> vars; // ordered by name, so the same program always emits the same code
+        std::vector<ValueType> temps;
+};
+
+#endif
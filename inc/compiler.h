@@ -0,0 +1,35 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "../inc/bytecode.h"
+#include "../inc/nodes.hpp"
+#include "../inc/block.h"
+
+// compiles the AST produced by the parser into bytecode for the VM
+class Compiler{
+    public:
+        Compiler(Chunk& chunk);
+        void compile_statement(Node* statement);
+        void finish();
+    private:
+        void compile(Node* node);
+        void compile_block(BlockNode* block);
+        void compile_cond(CondBlockNode* block);
+        void compile_loop(LoopBlockNode* block);
+        void compile_print(PrintNode* print_node);
+        void emit(OpCode op, uint32_t arg = 0);
+        size_t emit_jump(OpCode op);
+        void patch_jump(size_t pos);
+        uint32_t add_constant(const Value& val);
+        uint32_t add_var(const VarRef& var);
+        uint32_t add_message(const std::string& msg);
+        Chunk& chunk;
+        size_t statement_count {0};
+        std::unordered_map<uint64_t, uint32_t> var_ids;
+};
+
+#endif
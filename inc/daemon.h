@@ -0,0 +1,65 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/un.h>
+
+#include "../inc/regvm.h"
+#include "../inc/values.hpp"
+
+class Interpreter;
+
+// the kinds of request a daemon accepts
+enum RequestKind: uint8_t{
+    RunPath = 'p',   // run the script at an absolute path, which the daemon reads itself
+    RunSource = 's', // run the source code sent with the request
+    Shutdown = 'q'   // stop serving once the reply has been sent
+};
+
+// what a daemon sends back for a request
+struct DaemonReply{
+    int status {1}; // 0 on success, 1 on any error, like Interpreter::run
+    std::string output; // everything the script printed
+    ValueType result_type {NULL_TYPE};
+    std::string result; // the script's result, formatted as it would be printed
+    std::string err_msg;
+};
+
+/*
+    a long running process that runs scripts for clients connecting over a Unix domain socket, so they skip process startup. The
+    register programs compiled from scripts are cached by a hash of their source, so a script that's run again skips lexing,
+    parsing and compilation too. Each script is run by a worker process forked for its request, on a fresh interpreter, so
+    scripts can't see each other's globals, and one that crashes or runs for a long time doesn't affect the daemon or any other
+    client. A request is a kind byte followed by a length prefixed payload, see send_request
+*/
+class Daemon{
+    public:
+        static constexpr size_t MAX_PROGRAMS = 256; // the cache is cleared once it holds this many programs
+        static constexpr int RECEIVE_TIMEOUT_MS = 1000; // how long a client has to send its request
+        static constexpr int COMPILE_TIMEOUT_MS = 2000; // how long a script may take to compile before its compiler is killed
+        Daemon(const std::string& socket_path): socket_path(socket_path) {}
+        bool serve();
+        size_t cached_programs() {return this->programs.size();}
+        const std::string& get_err() {return this->err_msg;}
+    private:
+        bool claim_path(const sockaddr_un& addr);
+        void reap_workers(bool wait_all);
+        const RegProgram* prepare(RequestKind kind, const std::string& payload, DaemonReply& reply);
+        bool compile(Interpreter& compiler, std::string_view source, uint64_t key, RegProgram& program, DaemonReply& reply);
+        DaemonReply run(const RegProgram& program);
+        std::string socket_path;
+        std::string err_msg;
+        std::unordered_map<uint64_t, RegProgram> programs;
+        std::vector<pid_t> workers; // the workers that haven't been waited for yet
+};
+
+bool send_request(const std::string& socket_path, RequestKind kind, std::string_view payload, DaemonReply& reply);
+int run_client(const std::string& socket_path, const std::string& file_path, bool show_result = false);
+
+#endif
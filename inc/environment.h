@@ -0,0 +1,26 @@
+#ifndef ENVIRONMENT_H
+#define ENVIRONMENT_H
+
+#include <vector>
+
+#include "../inc/values.hpp"
+
+/*
+    the runtime storage for variables. Every call frame is a contiguous run of slots in a single array, and variables are
+    addressed by how many frames up they live (depth) and their index within that frame (slot), both of which are resolved by the parser
+*/
+class Environment{
+    public:
+        Environment() {this->bases.push_back(0);}
+        Value& at(unsigned depth, unsigned slot) {return this->slots[this->bases[this->bases.size() - 1 - depth] + slot];}
+        Value& local(unsigned slot) {return this->slots[this->bases.back() + slot];}
+        void reserve(size_t frame_size);
+        void push_frame(size_t frame_size);
+        void pop_frame();
+        size_t frame_count() {return this->bases.size();}
+    private:
+        std::vector<Value> slots;
+        std::vector<size_t> bases;
+};
+
+#endif
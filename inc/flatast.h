@@ -0,0 +1,85 @@
+#ifndef FLATAST_H
+#define FLATAST_H
+
+#include <cstdint>
+#include <vector>
+
+#include "../inc/environment.h"
+#include "../inc/values.hpp"
+#include "../inc/nodes.hpp"
+#include "../inc/block.h"
+
+// the kinds of node in a flat tree, each is evaluated just like the parser's node of the same kind
+enum FlatKind: uint8_t{
+    FlatNull,    // evaluates to null, this replaces type names, symbols and parameters
+    FlatLiteral, // a = the index of the constant
+    FlatVar,     // a = the slot, b = the depth
+    FlatDecl,    // a variable that is evaluated before it has been assigned to, which always fails
+    FlatAsgn,    // a = the slot, b = the depth, c = the value assigned
+    FlatComp,    // a <op> b
+    FlatLogic,   // a <op> b
+    FlatArith,   // a <op> b, computed as b <op> a just like ArithNode
+    FlatPrint,   // prints the nodes listed from a to a + b, in order, then a newline if op is set
+    FlatBlock,   // evaluates the nodes listed from a to a + b
+    FlatCond,    // evaluates the block b if a is true, otherwise the block c if there is one
+    FlatLoop     // evaluates the nodes listed from b to b + c for as long as a is true
+};
+
+/*
+    a node of a flat tree. Children are referred to by their index in the tree rather than by pointer, and nodes with any number
+    of children refer to a run of the tree's list of indices. Every node is 16 bytes, so four share a cache line
+*/
+struct FlatNode{
+    FlatKind kind;
+    uint8_t op {0};        // the operator of a binary node, or whether a print ends with a newline
+    uint8_t type {0};      // the declared type of the variable an assignment writes
+    bool checked {false};  // whether the type checker proved the types this node relies on
+    uint32_t a {0};
+    uint32_t b {0};
+    uint32_t c {0};
+};
+
+/*
+    an AST laid out in a single array of compact nodes, which are all evaluated by one switch rather than through virtual calls.
+    Every statement's children are stored before it, so evaluation mostly walks forwards through memory
+*/
+struct FlatTree{
+    static constexpr uint32_t NONE = UINT32_MAX;
+    std::vector<FlatNode> nodes;
+    std::vector<uint32_t> lists; // the children of print and block nodes
+    std::vector<Value> constants;
+    std::vector<uint32_t> statements; // the top-level statements, in order
+    void clear();
+    size_t memory_used();
+};
+
+// converts the parser's AST to a flat tree, throwing if it contains a node that can't be flattened
+class Flattener{
+    public:
+        Flattener(FlatTree& tree): tree(tree) {this->tree.clear();}
+        void add_statement(Node* statement);
+    private:
+        uint32_t flatten(Node* node);
+        uint32_t flatten_list(const std::pmr::vector<Node*>& nodes, bool reversed = false);
+        uint32_t flatten_block(BlockNode* block);
+        uint32_t add(const FlatNode& node);
+        FlatTree& tree;
+};
+
+// evaluates a flat tree, with the same semantics as the tree walker
+class FlatWalker{
+    public:
+        Value run(const FlatTree& tree, Environment& env);
+        void set_output(OutputBuffer* output) {this->output = output;}
+    private:
+        Value eval(uint32_t index);
+        Value operand(uint32_t index);
+        Value eval_list(uint32_t start, uint32_t count);
+        const FlatNode* nodes {nullptr};
+        const uint32_t* lists {nullptr};
+        const Value* constants {nullptr};
+        Environment* env {nullptr};
+        OutputBuffer* output {&OutputBuffer::standard()};
+};
+
+#endif
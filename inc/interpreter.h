@@ -1,28 +1,86 @@
 #ifndef INTERPRETER_H
 #define INTERPRETER_H
 
+#include <istream>
+#include <ostream>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <stack>
 
 #include "block.h"
+#include "bytecode.h"
 #include "lexer.h"
 #include "parser.h"
+#include "typechecker.h"
 #include "values.hpp"
 #include "nodes.hpp"
+#include "vm.h"
+#include "regvm.h"
+#include "flatast.h"
+#include "output.h"
+#include "profiler.h"
+
+// the strategies the interpreter can use to evaluate a parsed program
+enum Backend{
+    TreeWalker,
+    StackVM,
+    RegisterVM,
+    Tiered, // walks the tree, compiling hot loops to native code
+    FlatTreeWalker // walks a copy of the tree flattened into one array
+};
 
 class Interpreter{
     public:
-        Interpreter() {};
+        Interpreter();
         int run_file(const std::string& file_path);
-        int run(const std::string& expr);
+        int run(std::string_view expr);
+        int run_stream(std::istream& in);
+        int emit_c(std::string_view expr, std::ostream& out);
+        int compile(std::string_view expr, RegProgram& program);
+        int run_program(const RegProgram& program);
         Value result();
         void display_err();
+        static void display_err(const std::string& err_msg);
+        const std::string& get_err() {return this->err_msg;}
+        void set_backend(Backend backend) {this->backend = backend; this->parser.set_jit(backend == Tiered);}
+        Backend get_backend() {return this->backend;}
+        void set_dispatch(Dispatch dispatch) {this->reg_vm.set_dispatch(dispatch);}
+        void set_opt_level(int level) {this->opt_level = level;}
+        void set_cache(bool use_cache) {this->use_cache = use_cache;}
+        void set_lazy(bool lazy) {this->lazy = lazy;}
+        void set_flush_policy(FlushPolicy policy) {this->output.set_policy(policy);}
+        void set_output(std::ostream& out) {this->output.set_stream(out);}
+        int get_opt_level() {return this->opt_level;}
+        // only the tree walker evaluates nodes one by one, so profiling a program also selects it
+        void set_profiler(Profiler* profiler) {this->profiler = profiler; if (profiler) this->set_backend(TreeWalker);}
     private:
-        int set_tokens(const std::string& expr);
+        int set_tokens(std::string_view expr);
+        int prepare(std::string_view expr, bool lazy = false);
+        int check_types();
+        int eval_tree();
+        int eval_bytecode();
+        int eval_registers();
+        int compile_registers();
+        int exec_registers();
+        void reserve_globals();
+        int eval_flat();
+        Value eval_statement(Node* statement);
+        Backend backend {RegisterVM};
+        int opt_level {1}; // 0 evaluates the program exactly as parsed, 1 runs the optimizer over it first
+        bool use_cache {false}; // whether run_file loads and saves compiled programs as .nebc files, which is opt-in since they're written beside the script
+        bool lazy {false}; // whether the tree walker parses the bodies of blocks only once they're evaluated
+        OutputBuffer output; // everything the program prints, which every backend writes through
+        Profiler* profiler {nullptr}; // records where the tree walker spends its time, if it's set
+        Chunk chunk;
+        VM vm;
+        RegProgram reg_program;
+        RegVM reg_vm;
+        FlatTree flat_tree;
+        FlatWalker flat_walker;
+        TypeChecker checker;
         std::string err_msg;
         std::vector<Token> tokens;
-        std::stack<Value> eval_stack;
+        Value last_result;
         Parser parser;
 };
 
@@ -0,0 +1,88 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "../inc/bytecode.h"
+#include "../inc/environment.h"
+#include "../inc/values.hpp"
+
+// hot loops are only compiled to native code on x86-64 Linux, everywhere else they are always interpreted
+#if defined(__x86_64__) && defined(__linux__) && !defined(NEBULA_NO_JIT)
+#define NEBULA_JIT 1
+#endif
+
+class Node;
+class LoopBlockNode;
+
+// a variable used by a compiled loop, only the variables it writes are copied back to the environment
+struct JitVar{
+    VarRef ref;
+    uint32_t cell;
+    bool written {false};
+};
+
+/*
+    a while loop compiled to native code. The code works on an array of 8 byte cells holding the loop's variables and constants,
+    followed by temporaries. Variables are copied in from the environment before the code runs and back out after
+*/
+class NativeLoop{
+    public:
+        using Entry = void (*)(uint64_t* cells);
+        bool run(Value& last);
+    private:
+        friend class JitCompiler;
+        Entry entry {nullptr};
+        Environment* env {nullptr};
+        std::vector<JitVar> vars;
+        std::vector<uint64_t> cells;
+        uint32_t ran_cell {0}; // set to 1 by the code if the body ran at least once
+        uint32_t result_cell {0}; // holds the value of the body's last statement
+        ValueType result_type {NULL_TYPE};
+};
+
+// owns the executable memory and bookkeeping of every loop compiled from one parse, it is released along with the parser's arena
+class CodeHeap{
+    public:
+        CodeHeap() {}
+        ~CodeHeap();
+        CodeHeap(const CodeHeap&) = delete;
+        CodeHeap& operator=(const CodeHeap&) = delete;
+        NativeLoop* create_loop();
+        NativeLoop::Entry install(const std::vector<uint8_t>& code);
+        void reset();
+    private:
+        std::vector<std::unique_ptr<NativeLoop>> loops;
+        std::vector<std::pair<void*, size_t>> regions;
+};
+
+/*
+    a baseline compiler from a while loop to x86-64. Only loops whose condition and body are made up of arithmetic, comparisons,
+    logic and assignments on INT, FLOAT and BOOL variables are supported, anything else is left to the interpreter
+*/
+class JitCompiler{
+    public:
+        JitCompiler(CodeHeap& heap): heap(heap) {}
+        NativeLoop* compile(LoopBlockNode* loop);
+    private:
+        std::optional<ValueType> check(Node* node);
+        uint32_t emit(Node* node, uint32_t target = NO_CELL);
+        void emit_into(Node* node, uint32_t dst);
+        uint32_t var_cell(Node* node, bool write);
+        uint32_t alloc_temp();
+        static constexpr uint32_t NO_CELL = UINT32_MAX;
+        CodeHeap& heap;
+        NativeLoop loop;
+        std::vector<uint8_t> code;
+        std::unordered_map<uint64_t, uint32_t> var_cells;
+        std::unordered_map<Node*, uint32_t> const_cells;
+        std::unordered_map<Node*, ValueType> types; // the type of every expression, found while checking the loop is supported
+        uint32_t next_temp {0};
+};
+
+#endif
@@ -1,7 +1,11 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include <cstdint>
+#include <deque>
+#include <istream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 enum TokenType{
@@ -53,14 +57,41 @@ enum TokenType{
     Other // this should only be used by the lexer itself for ambiguous cases
 };
 
+// a token's text is a view into the source it was read from, so the source must outlive it
 struct Token{
     Token() {}
-    Token(TokenType type) {this->type = type; this->txt = "";};
-    Token(TokenType type, const std::string& txt) {this->type = type; this->txt = txt;};
+    Token(TokenType type, std::string_view txt = {}, uint32_t line = 0, uint32_t col = 0) {this->type = type; this->txt = txt; this->line = line; this->col = col;};
     TokenType type;
-    std::string txt; 
+    std::string_view txt; 
+    uint32_t line {0}; // the line and column the token starts at, both counted from 1
+    uint32_t col {0};
 };
 
-void tokenize(const std::string& statement, std::vector<Token>& tokens);
+void tokenize(std::string_view statement, std::vector<Token>& tokens, uint32_t first_line = 1, uint32_t first_col = 1);
+void tokenize_parallel(std::string_view src, std::vector<Token>& tokens, unsigned threads = 0);
+size_t find_break(std::string_view src);
+std::string describe_location(uint32_t line, uint32_t col);
+
+/*
+    lexes a source incrementally, reading it in chunks that are cut at the last statement break they contain. Tokens refer to
+    the chunk they were read from, so chunks are kept until every one of their tokens has been released by the consumer
+*/
+class TokenStream{
+    public:
+        TokenStream(std::istream& in, size_t chunk_size = 64 * 1024): in(in) {this->chunk_size = chunk_size;}
+        bool next(std::vector<Token>& tokens);
+        void release(size_t consumed);
+        size_t buffered_chunks() {return this->chunks.size();}
+    private:
+        std::istream& in;
+        size_t chunk_size;
+        std::string pending; // text read after the last break of the previous chunk
+        std::deque<std::string> chunks;
+        std::deque<size_t> chunk_ends; // the total number of tokens produced once each chunk was lexed
+        size_t produced {0};
+        uint32_t line {1};
+        uint32_t col {1};
+        bool done {false};
+};
 
 #endif
\ No newline at end of file
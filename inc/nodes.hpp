@@ -1,10 +1,18 @@
 #ifndef NODES_H
 #define NODES_H
 
+#include <cstdint>
 #include <stdexcept>
 #include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <type_traits>
+#include <vector>
 
 #include "../inc/values.hpp"
+#include "../inc/environment.h"
+#include "../inc/symtable.h"
+#include "../inc/output.h"
 
 enum NodeType{
     Type_N,
@@ -43,20 +51,50 @@ enum Operator{
     Assignment
 };
 
+class Node;
+class Profiler;
+// the profiler recording evaluations on this thread, if any. It's constinit so reading it never needs to check it's initialized
+extern thread_local constinit Profiler* active_profiler;
+Value profile_eval(Node*& child);
+
 // the base class that all nodes in the AST must derive from
 class Node{
     public:
         virtual Value eval() = 0;      
         NodeType get_node_type() {return this->node_type;}
+        static Value eval_child(Node*& child);
+        void set_location(uint32_t line, uint32_t col) {this->line = line; this->col = col;}
+        uint32_t get_line() {return this->line;}
+        uint32_t get_col() {return this->col;}
+        void set_checked() {this->checked = true;}
+        bool is_checked() {return this->checked;}
     protected:
+        friend Value profile_eval(Node*& child);
         NodeType node_type;
+        Node* replacement {nullptr}; // the node this one has rewritten itself to, which its parent installs in its place
+        bool checked {false}; // set by the type checker once the types this node relies on are proven, so eval can skip checking them
+        uint32_t line {0};
+        uint32_t col {0};
 };
+// evaluates a child node, then replaces the parent's pointer to it if the child rewrote itself while being evaluated
+inline Value Node::eval_child(Node*& child){
+    if (active_profiler) [[unlikely]]
+        return profile_eval(child);
+    Value val = child->eval();
+    if (child->replacement) [[unlikely]] {
+        Node* next = child->replacement;
+        child->replacement = nullptr;
+        child = next;
+    }
+    return val;
+}
 
 // this is the simplest type of node, it simply evaluates to a given value
 class LiteralNode: public Node{
     public:
         LiteralNode(const Value& val) {this->value = val; this->node_type = Literal_N;};
         Value eval() override {return this->value;};
+        const Value& get_value() {return this->value;}
     private:
         Value value;
 };
@@ -64,11 +102,11 @@ class LiteralNode: public Node{
 // this node only holds a user defined symbol
 class SymNode: public Node{
     public:
-        SymNode(const std::string& sym) {this->symbol = sym; this->node_type = Sym_N;}
+        SymNode(std::string_view sym) {this->symbol = sym; this->node_type = Sym_N;}
         Value eval() override {return std::move(Value(NULL_TYPE));}
-        std::string get_sym() {return std::move(this->symbol);}
+        std::string_view get_sym() {return this->symbol;}
     private:
-        std::string symbol;
+        std::string_view symbol;
 };
 
 // this node only holds the name of a type
@@ -95,22 +133,27 @@ class PtrNode: public ValNode{
         PtrNode(Value* val_ptr);
         void assign(const Value& new_val) override {*this->val_ptr = new_val;}
         Value eval() override;
+        Value* get_ptr() {return this->val_ptr;}
     protected:
         Value* val_ptr;
 };
 
-// this node represents a variable
-class VarNode: public ValNode{
+// this node represents a variable, it reads and writes the variable's slot in the environment directly
+class VarNode final: public ValNode{
     public:
         VarNode(ValueType val_type) {this->val_type = val_type; this->initialized = false; this->node_type = Var_N;}
-        VarNode(const std::shared_ptr<Value>& val, bool initialized);
+        VarNode(Environment* env, const Symbol& symbol, bool initialized);
         Value eval() override; 
         bool is_initialized() {return this->initialized;}
         bool operator==(VarNode& rhs);
         void assign(const Value& new_val) override;
-        void set_ptr(const std::shared_ptr<Value>& val) {this->val_ptr = val;}
+        unsigned get_depth() {return this->depth;}
+        unsigned get_slot() {return this->slot;}
+        Environment* get_env() {return this->env;}
     private:
-        std::shared_ptr<Value> val_ptr;
+        Environment* env {nullptr};
+        unsigned depth {0};
+        unsigned slot {0};
         bool initialized;
         
 };
@@ -118,28 +161,49 @@ class VarNode: public ValNode{
 // this node assigns a variable to the result of the right child. The right child must evaluate to the same type as the variable. This node evaluates to the new value of the variable
 class AsgnNode: public Node{
     public:
-        AsgnNode(ValNode* lhs, Node* rhs);
+        AsgnNode(ValNode* lhs, Node* rhs, std::pmr::memory_resource* resource = nullptr);
         Value eval() override;
-    private:
+        ValNode* get_lhs() {return this->lhs;}
+        Node* get_rhs() {return this->rhs;}
+        void set_rhs(Node* rhs) {this->rhs = rhs;}
+    protected:
         ValNode* lhs;
         Node* rhs;
+        std::pmr::memory_resource* resource; // where the specialised version of this node is allocated, if it may have one
+};
+
+// an assignment to a variable, which writes the variable directly rather than through the ValNode interface
+class VarAsgnNode: public AsgnNode{
+    public:
+        VarAsgnNode(const AsgnNode& generic): AsgnNode(generic) {this->resource = nullptr;}
+        Value eval() override;
 };
 
 // this node will return a value that always evaluates to bool, it accepts any type, but certain opperations only apply to certain types
 class CompNode: public Node{
     public:
-        CompNode(Node* lhs, Node* rhs, Operator op);
+        CompNode(Node* lhs, Node* rhs, Operator op, std::pmr::memory_resource* resource = nullptr);
         Value eval() override;
-        Operator op;
+        static Value apply(Operator op, const Value& lhs_val, const Value& rhs_val);
+        static Value compute(Operator op, const Value& lhs_val, const Value& rhs_val);
         template <typename T>
-        bool compare(T lhs_val, T rhs_val, bool is_numeric);
-    private:
+        static bool compare(Operator op, T lhs_val, T rhs_val, bool is_numeric);
+        Node* get_lhs() {return this->lhs;}
+        Node* get_rhs() {return this->rhs;}
+        void set_lhs(Node* lhs) {this->lhs = lhs;}
+        void set_rhs(Node* rhs) {this->rhs = rhs;}
+        Operator op;
+    protected:
+        void quicken(ValueType type);
+        Value deoptimise(const Value& lhs_val, const Value& rhs_val);
         Node* lhs;
         Node* rhs;
+        std::pmr::memory_resource* resource; // where specialised versions of this node are allocated, nullptr once it must stay generic
+        CompNode* generic {nullptr}; // the node a specialised node was created from
 };
 template <typename T> 
-bool CompNode::compare(T lhs_val, T rhs_val, bool is_numeric){
-    switch (this->op){
+bool CompNode::compare(Operator op, T lhs_val, T rhs_val, bool is_numeric){
+    switch (op){
         case GreatherThan:
             if (!is_numeric)
                 throw std::runtime_error("cannot use the '>' operator on non-numeric values");
@@ -159,34 +223,93 @@ bool CompNode::compare(T lhs_val, T rhs_val, bool is_numeric){
     return false;
 }
 
+// a comparison that has only seen operands of one type, it reverts to the generic node if it sees any other
+template <typename T, Operator Op>
+class QuickCompNode: public CompNode{
+    public:
+        static constexpr ValueType TYPE = std::is_same_v<T, int> ? INT : FLOAT;
+        QuickCompNode(CompNode* generic): CompNode(*generic) {this->generic = generic; this->resource = nullptr;}
+        Value eval() override{
+            Value lhs_val = eval_child(this->lhs);
+            Value rhs_val = eval_child(this->rhs);
+            if (!this->checked && (lhs_val.get_type() != TYPE || rhs_val.get_type() != TYPE)) [[unlikely]]
+                return this->deoptimise(lhs_val, rhs_val);
+            return Value::create(BOOL, CompNode::compare(Op, lhs_val.as<T>(), rhs_val.as<T>(), true));
+        }
+};
+template <Operator Op>
+using IntCompNode = QuickCompNode<int, Op>;
+template <Operator Op>
+using FloatCompNode = QuickCompNode<double, Op>;
+
 // this node will perform a given logical operation on its children, and evaluates to the result of that operation. The children MUST evaluate to a boolean
 class BoolLogicNode: public Node{
     public: 
-        BoolLogicNode(Node* lhs, Node* rhs, Operator op);
+        BoolLogicNode(Node* lhs, Node* rhs, Operator op, std::pmr::memory_resource* resource = nullptr);
         Value eval() override;
-    private:
+        static Value apply(Operator op, const Value& lhs_val, const Value& rhs_val);
+        static Value compute(Operator op, const Value& lhs_val, const Value& rhs_val);
+        Node* get_lhs() {return this->lhs;}
+        Node* get_rhs() {return this->rhs;}
+        void set_lhs(Node* lhs) {this->lhs = lhs;}
+        void set_rhs(Node* rhs) {this->rhs = rhs;}
+        Operator get_op() {return this->op;}
+    protected:
+        Value deoptimise(const Value& lhs_val, const Value& rhs_val);
         Node* lhs;
         Node* rhs;
         Operator op;
+        std::pmr::memory_resource* resource; // where specialised versions of this node are allocated, nullptr once it must stay generic
+        BoolLogicNode* generic {nullptr}; // the node a specialised node was created from
+};
+
+// a logical operation that skips the operator dispatch, both operands are still checked to be booleans
+template <Operator Op>
+class QuickLogicNode: public BoolLogicNode{
+    public:
+        QuickLogicNode(BoolLogicNode* generic): BoolLogicNode(*generic) {this->generic = generic; this->resource = nullptr;}
+        Value eval() override{
+            Value lhs_val = eval_child(this->lhs);
+            Value rhs_val = eval_child(this->rhs);
+            if (!this->checked && (lhs_val.get_type() != BOOL || rhs_val.get_type() != BOOL)) [[unlikely]]
+                return this->deoptimise(lhs_val, rhs_val);
+            if constexpr (Op == LogicOr)
+                return Value::create(BOOL, lhs_val.as<bool>() || rhs_val.as<bool>());
+            else
+                return Value::create(BOOL, lhs_val.as<bool>() && rhs_val.as<bool>());
+        }
 };
 
-// this node performans arithmetic on two numeric noes and evaluates to the result
+/*
+    this node performans arithmetic on two numeric noes and evaluates to the result. The first time it is evaluated, it rewrites
+    itself to a node specialised for the type of its operands, such as IntArithNode<ArithAdd>
+*/
 class ArithNode: public Node{
     public:
-        ArithNode(Node* lhs, Node* rhs, Operator op);
+        ArithNode(Node* lhs, Node* rhs, Operator op, std::pmr::memory_resource* resource = nullptr);
         Value eval() override; 
+        static Value apply(Operator op, const Value& lhs_val, const Value& rhs_val);
+        static Value compute(Operator op, const Value& lhs_val, const Value& rhs_val);
         template <typename T>
-        Value calculate(T lhs_val, T rhs_val, bool return_int);
-    private:
+        static Value calculate(Operator op, T lhs_val, T rhs_val, bool return_int);
+        Node* get_lhs() {return this->lhs;}
+        Node* get_rhs() {return this->rhs;}
+        void set_lhs(Node* lhs) {this->lhs = lhs;}
+        void set_rhs(Node* rhs) {this->rhs = rhs;}
+        Operator get_op() {return this->op;}
+    protected:
+        void quicken(ValueType type);
+        Value deoptimise(const Value& lhs_val, const Value& rhs_val);
         Node* lhs;
         Node* rhs;
         Operator op;
-
+        std::pmr::memory_resource* resource; // where specialised versions of this node are allocated, nullptr once it must stay generic
+        ArithNode* generic {nullptr}; // the node a specialised node was created from
 };
 
 template <typename T>
-Value ArithNode::calculate(T lhs_val, T rhs_val, bool return_int){
-    double ret_val;
+Value ArithNode::calculate(Operator op, T lhs_val, T rhs_val, bool return_int){
+    double ret_val = 0;
     switch (op){
         case ArithAdd:
             ret_val = lhs_val + rhs_val;
@@ -198,33 +321,71 @@ Value ArithNode::calculate(T lhs_val, T rhs_val, bool return_int){
             ret_val = lhs_val * rhs_val;
             break;
         case ArithDiv:
+            // integer division by zero would trap, floats divide to infinity or NaN instead
+            if (std::is_integral_v<T> && rhs_val == 0)
+                throw std::runtime_error("cannot divide by zero");
             ret_val = lhs_val / rhs_val;
             break;
         case ArithMod:
-            return_int = true;
-            ret_val = static_cast<int>(lhs_val) % static_cast<int>(rhs_val);
+            if constexpr (std::is_floating_point_v<T>)
+                throw std::runtime_error("cannot use the '%' operator on floats");
+            else{
+                if (rhs_val == 0)
+                    throw std::runtime_error("cannot divide by zero");
+                return_int = true;
+                ret_val = static_cast<int>(lhs_val) % static_cast<int>(rhs_val);
+            }
             break;
         case ArithPow:
             ret_val = 1;
             for (int i = 0; i < lhs_val; i++)
                 ret_val *= rhs_val;
             break;
-    
+        default:
+            throw std::runtime_error("invalid arithmetic operator");
     }
     if (return_int)
         return Value::create(INT, static_cast<int>(ret_val));
     else    
         return Value::create(FLOAT, ret_val);
 }
-// this node represents a print statement
+
+// arithmetic that has only seen operands of one type, it reverts to the generic node if it sees any other
+template <typename T, Operator Op>
+class QuickArithNode: public ArithNode{
+    public:
+        static constexpr ValueType TYPE = std::is_same_v<T, int> ? INT : FLOAT;
+        QuickArithNode(ArithNode* generic): ArithNode(*generic) {this->generic = generic; this->resource = nullptr;}
+        Value eval() override{
+            Value lhs_val = eval_child(this->lhs);
+            Value rhs_val = eval_child(this->rhs);
+            if (!this->checked && (lhs_val.get_type() != TYPE || rhs_val.get_type() != TYPE)) [[unlikely]]
+                return this->deoptimise(lhs_val, rhs_val);
+            // the operands are swapped to match ArithNode::apply
+            return ArithNode::calculate(Op, rhs_val.as<T>(), lhs_val.as<T>(), TYPE == INT);
+        }
+};
+template <Operator Op>
+using IntArithNode = QuickArithNode<int, Op>;
+template <Operator Op>
+using FloatArithNode = QuickArithNode<double, Op>;
+// this node represents a print statement, which writes to the interpreter's output buffer, or to stdout if it has none
 class PrintNode: public Node{
     public:
-        PrintNode(bool newline) {this->node_type = Print_N; this->newline = newline;}
+        PrintNode(bool newline, std::pmr::memory_resource* resource = std::pmr::get_default_resource(), OutputBuffer* output = nullptr): args(resource){
+            this->node_type = Print_N;
+            this->newline = newline;
+            this->output = output ? output : &OutputBuffer::standard();
+        }
         Value eval() override;
         void push_arg(Node* arg) {this->args.push_back(arg);};
+        const std::pmr::vector<Node*>& get_args() {return this->args;}
+        void set_arg(size_t index, Node* arg) {this->args[index] = arg;}
+        bool has_newline() {return this->newline;}
     private:
-        std::vector<Node*> args;
+        std::pmr::vector<Node*> args;
         bool newline;
+        OutputBuffer* output;
 };
 
 // this node represents a parameter, be it an index or a type
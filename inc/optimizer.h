@@ -0,0 +1,25 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "../inc/arena.h"
+#include "../inc/nodes.hpp"
+#include "../inc/block.h"
+
+/*
+    simplifies a parsed and type checked program without changing its output. Constant subexpressions are folded into literals,
+    eval blocks are replaced by the expression they wrap, and branches of if blocks with constant conditions are pruned.
+    New nodes are allocated from the arena of the parser the program came from
+*/
+class Optimizer{
+    public:
+        Optimizer(Arena& arena): arena(arena) {}
+        Node* optimize(Node* node);
+    private:
+        Node* optimize_block(BlockNode* block);
+        void optimize_statements(BlockNode* block);
+        Node* fold(Node* node, Value (*apply)(Operator, const Value&, const Value&), Operator op, Node* lhs, Node* rhs);
+        Node* make_literal(Node* original, const Value& val);
+        Arena& arena;
+};
+
+#endif
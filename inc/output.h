@@ -0,0 +1,47 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <string_view>
+
+#include "../inc/values.hpp"
+
+// when buffered output is written to its stream
+enum FlushPolicy{
+    FlushLine, // at the end of every print statement, so output appears as soon as it's printed
+    FlushSize, // whenever the buffer fills up
+    FlushExit  // only once the program has finished running, the buffer grows to hold everything printed until then
+};
+
+/*
+    collects everything a program prints in a large buffer, which is written to the output stream in as few calls as possible.
+    Values are formatted by Value::format rather than through iostreams
+*/
+class OutputBuffer{
+    public:
+        static constexpr size_t CAPACITY = 64 * 1024;
+        OutputBuffer(std::ostream& out = std::cout, FlushPolicy policy = FlushSize);
+        OutputBuffer(const OutputBuffer&) = delete;
+        OutputBuffer& operator=(const OutputBuffer&) = delete;
+        ~OutputBuffer() {this->flush();}
+        static OutputBuffer& standard();
+        void write(const Value& val);
+        void write(std::string_view str);
+        void end_print(bool newline);
+        void flush();
+        void set_policy(FlushPolicy policy) {this->policy = policy;}
+        FlushPolicy get_policy() {return this->policy;}
+        void set_stream(std::ostream& out) {this->flush(); this->out = &out;}
+        size_t pending() {return this->used;}
+    private:
+        char* reserve(size_t bytes);
+        std::ostream* out;
+        FlushPolicy policy;
+        std::unique_ptr<char[]> buffer;
+        size_t capacity {CAPACITY};
+        size_t used {0};
+};
+
+#endif
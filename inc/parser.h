@@ -1,11 +1,16 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include <stdexcept>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 #include <stack>
 
+#include "../inc/arena.h"
 #include "../inc/values.hpp"
+#include "../inc/environment.h"
+#include "../inc/jit.h"
 #include "../inc/lexer.h"
 #include "../inc/symtable.h"
 #include "../inc/nodes.hpp"
@@ -15,33 +20,63 @@ class Parser{
     public:
         Parser() {this->curr_scope = &this->global_scope;}
         Parser(const std::vector<Token>& tokens);
+        Parser(std::vector<Token>&& tokens);
         ~Parser();
         void parse(); 
-        void reset(const std::vector<Token>& new_tokens);
+        void reset(std::vector<Token>&& new_tokens);
+        void reset(TokenStream* new_stream);
         bool validate(std::string& error_msg);
         Node* next_expr();
+        Node* parse_next();
+        void release();
+        Environment& get_environment() {return this->env;}
+        std::deque<Node*>& get_statements() {return this->node_stack;}
+        Arena& get_arena() {return this->arena;}
+        size_t global_frame_size() {return this->global_scope.frame_size();}
+        void set_jit(bool jit) {this->jit = jit;}
+        void set_lazy(bool lazy) {this->lazy = lazy;}
+        void set_output(OutputBuffer* output) {this->output = output;}
+        void parse_deferred(BlockNode* block, size_t pos);
     private:
         Node* pop_node();
         size_t stack_size();
         void push_node(Node* node);
         void push_block(BlockNode* block);
+        bool defer_block(BlockNode* block);
         void parse_expr();
         void parse_bin_expr(NodeType type, Operator op);
         void clear();
-        size_t token_count;
+        template <typename T, typename... Args>
+        T* make_node(const Token& token, Args&&... args);
+        bool has_tokens(size_t count = 1);
+        [[noreturn]] void throw_located(const std::runtime_error& err);
+        size_t token_count {0};
         size_t curr_pos {0};
         int eval_count  {0}; // keeps track of the number of eval blocks currentlty open
         bool return_next {false};
         SymbolTable global_scope;
+        Environment env;
         SymbolTable* curr_scope;
         BlockNode* curr_block {nullptr};
         std::stack<SymbolTable*> scope_stack;
         std::deque<Node*> node_stack;
         std::stack<BlockNode*> block_stack;
         std::vector<Token> tokens;
-        std::vector<Node*> statements;
-        std::vector<SymbolTable*> scopes; // this is to store scopes that have been declared, but aren't on the stack
-        std::vector<Node*> nodes; // see above, but for nodes
+        TokenStream* stream {nullptr}; // the source tokens are pulled from while streaming, if any
+        size_t consumed {0}; // the number of streamed tokens that have already been released
+        Arena arena; // owns every node and scope created by the current parse
+        CodeHeap code_heap; // owns the native code of every loop compiled from the current parse
+        bool jit {false}; // whether loops may be compiled to native code once they're hot
+        bool lazy {false}; // whether the bodies of blocks are only parsed once they're evaluated
+        OutputBuffer* output {nullptr}; // where print statements write, stdout if this is null
 };      
 
+// allocates a node from the arena, recording the position of the token it was parsed from
+template <typename T, typename... Args>
+T* Parser::make_node(const Token& token, Args&&... args){
+    T* node = this->arena.make<T>(std::forward<Args>(args)...);
+    node->set_location(token.line, token.col);
+    return node;
+}
+
 #endif
\ No newline at end of file
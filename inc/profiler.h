@@ -0,0 +1,76 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "../inc/nodes.hpp"
+
+// what a profiler recorded for one source line, times are in nanoseconds
+struct LineProfile{
+    uint32_t line {0};
+    uint64_t evals {0}; // the number of times a node on this line was evaluated
+    uint64_t inclusive {0}; // the time spent evaluating this line, including the lines it ran, like the body of a loop
+    uint64_t exclusive {0}; // the time spent evaluating this line itself
+};
+
+/*
+    records how often the nodes of each source line are evaluated by the tree walker and how long they take. Node::eval_child
+    reports to the profiler that's active on its thread, which costs a single untaken branch while no profiler is active. Time
+    is only measured when evaluation moves to a different line, so the nodes within a line don't each pay for reading the
+    clock. The lines being evaluated form a stack, which is kept as a tree so it can be written out as folded stacks
+*/
+class Profiler{
+    public:
+        Profiler();
+        std::vector<LineProfile> hot_lines();
+        void report(std::ostream& out, std::string_view source, size_t count = 20);
+        void write_folded(std::ostream& out, std::string_view source);
+        void clear();
+    private:
+        friend class ProfilerScope;
+        friend Value profile_eval(Node*& child);
+        // an open evaluation of a line
+        struct Frame{
+            uint32_t line;
+            uint32_t stack; // the stack this evaluation belongs to
+            uint64_t start;
+            uint64_t children {0}; // the time spent in lines evaluated from this one
+        };
+        // a distinct stack of lines, identified by the stack it was entered from and its innermost line
+        struct Stack{
+            uint32_t line;
+            uint32_t parent;
+            uint64_t exclusive {0};
+        };
+        bool enter(uint32_t line);
+        void leave();
+        void unwind(size_t depth);
+        LineProfile& line_profile(uint32_t line);
+        std::vector<LineProfile> lines; // indexed by line
+        std::vector<uint32_t> open; // the number of open frames for each line, so recursion isn't counted twice
+        std::vector<Frame> frames;
+        std::vector<Stack> stacks; // the first stack is the root, which has no line
+        std::unordered_map<uint64_t, uint32_t> stack_ids;
+};
+
+/*
+    makes a profiler active on the current thread for as long as it's in scope, a null profiler leaves profiling off. Frames left
+    open when the scope ends, by an error thrown part way through evaluation, are closed then
+*/
+class ProfilerScope{
+    public:
+        ProfilerScope(Profiler* profiler);
+        ProfilerScope(const ProfilerScope&) = delete;
+        ProfilerScope& operator=(const ProfilerScope&) = delete;
+        ~ProfilerScope();
+    private:
+        Profiler* profiler;
+        Profiler* previous;
+        size_t depth {0}; // the number of frames open when the scope began
+};
+
+#endif
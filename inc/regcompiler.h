@@ -0,0 +1,49 @@
+#ifndef REGCOMPILER_H
+#define REGCOMPILER_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../inc/regvm.h"
+#include "../inc/nodes.hpp"
+#include "../inc/block.h"
+
+bool has_side_effects(Node* node);
+
+/*
+    compiles the AST produced by the parser into a program for the register VM. Every variable and constant gets its own register,
+    and temporaries are allocated above them in a stack-like fashion, so an expression never needs more registers than its depth
+*/
+class RegCompiler{
+    public:
+        static constexpr uint32_t NO_REGISTER = UINT32_MAX;
+        RegCompiler(RegProgram& program);
+        void add_statement(Node* statement);
+        void finish();
+    private:
+        void collect(Node* node);
+        uint32_t compile(Node* node, uint32_t target = NO_REGISTER);
+        void compile_into(Node* node, uint32_t dst);
+        uint32_t compile_binary(Node* lhs, Node* rhs, RegOp op, Operator generic_op, uint32_t target);
+        void compile_statements(BlockNode* block, uint32_t dst);
+        uint32_t compile_cond(CondBlockNode* block, uint32_t target);
+        uint32_t compile_loop(LoopBlockNode* block);
+        uint32_t compile_print(PrintNode* print_node, uint32_t target);
+        uint32_t compile_condition(BlockNode* block, Node* condition);
+        std::optional<ValueType> static_type(Node* node);
+        uint32_t var_register(VarNode* var);
+        uint32_t alloc_temp();
+        size_t emit(RegOp op, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0, uint32_t d = 0);
+        uint32_t add_message(const std::string& msg);
+        RegProgram& program;
+        std::vector<Node*> statements;
+        std::unordered_map<uint64_t, uint32_t> var_regs;
+        std::unordered_map<Node*, uint32_t> const_regs; // the register of every literal, relative to the first constant
+        uint32_t const_base {0};
+        uint32_t next_temp {0};
+};
+
+#endif
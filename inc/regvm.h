@@ -0,0 +1,105 @@
+#ifndef REGVM_H
+#define REGVM_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../inc/bytecode.h"
+#include "../inc/environment.h"
+#include "../inc/output.h"
+#include "../inc/values.hpp"
+
+// GCC and Clang support taking the address of a label, which lets the VM jump straight to the next instruction's handler
+#if defined(__GNUC__) && !defined(NEBULA_NO_COMPUTED_GOTO)
+#define NEBULA_COMPUTED_GOTO 1
+#endif
+
+/*
+    instructions for the register VM, every operand is a register index unless noted otherwise. The typed instructions are
+    only emitted when the type checker has proven their operand types, so they never check them
+*/
+enum RegOp: uint8_t{
+    RegMove,      // a = b
+    RegNull,      // a = null
+    RegStore,     // a = b, throwing if b isn't of type c. Used for assignments the type checker couldn't prove
+    RegArith,     // a = b <d> c, where d is the arithmetic operator
+    RegComp,      // a = b <d> c, where d is the comparison operator
+    RegLogic,     // a = b <d> c, where d is the logical operator
+    RegAddI,      // a = b + c, on integers
+    RegSubI,      // a = c - b, operands are swapped to match ArithNode::apply
+    RegMulI,      // a = b * c
+    RegDivI,      // a = c / b
+    RegModI,      // a = c % b
+    RegLtI,       // a = b < c
+    RegGtI,       // a = b > c
+    RegEqI,       // a = b == c
+    RegNeI,       // a = b != c
+    RegAddF,      // a = b + c, on floats
+    RegSubF,      // a = c - b
+    RegMulF,      // a = b * c
+    RegDivF,      // a = c / b
+    RegLtF,       // a = b < c
+    RegGtF,       // a = b > c
+    RegAnd,       // a = b && c, on booleans
+    RegOr,        // a = b || c
+    RegCheckBool, // throws if a isn't a boolean
+    RegJump,      // jumps to instruction a
+    RegJumpFalse, // jumps to instruction b if a is false
+    RegJumpTrue,  // jumps to instruction b if a is true
+    RegPrint,     // writes a to stdout
+    RegPrintEnd,  // writes a newline if b is set, flushes stdout and sets a to null
+    RegTrap,      // throws messages[a] as a runtime error
+    RegHalt       // stops execution, a holds the program's result
+};
+
+struct RegInstruction{
+    RegOp op;
+    uint32_t a {0};
+    uint32_t b {0};
+    uint32_t c {0};
+    uint32_t d {0};
+    const void* handler {nullptr}; // the address of the op's handler, filled in the first time the program runs threaded
+};
+
+/*
+    a compiled program for the register VM. Registers are laid out as the program's variables, followed by its constants,
+    followed by temporaries. Variables are copied in from the environment when the program starts and back out when it stops
+*/
+struct RegProgram{
+    std::vector<RegInstruction> code;
+    std::vector<VarRef> vars;
+    std::vector<Value> constants;
+    std::vector<std::string> messages;
+    uint32_t register_count {0};
+    bool threaded {false}; // whether the handlers of the instructions have been resolved
+    void clear();
+};
+
+// the dispatch strategy the register VM uses, threaded dispatch is only available with GCC and Clang
+enum Dispatch{
+    SwitchDispatch,
+    ThreadedDispatch
+};
+
+// a register based virtual machine that runs programs produced by the register compiler
+class RegVM{
+    public:
+        RegVM() {}
+        Value run(RegProgram& program, Environment& env);
+        void set_dispatch(Dispatch dispatch) {this->dispatch = dispatch;}
+        Dispatch get_dispatch() {return this->dispatch;}
+        void set_output(OutputBuffer* output) {this->output = output;}
+    private:
+        template <bool Threaded>
+        Value execute(RegProgram& program);
+#ifdef NEBULA_COMPUTED_GOTO
+        Dispatch dispatch {ThreadedDispatch};
+#else
+        Dispatch dispatch {SwitchDispatch};
+#endif
+        std::vector<Value> regs;
+        OutputBuffer* output {&OutputBuffer::standard()};
+};
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <string>
+#include <string_view>
+
+/*
+    a read-only view of a source file. Regular files are memory mapped, so they can be lexed without ever being copied,
+    anything that can't be mapped (pipes, empty files, etc.) is read in a single pass instead
+*/
+class SourceFile{
+    public:
+        SourceFile() {}
+        ~SourceFile();
+        SourceFile(const SourceFile&) = delete;
+        SourceFile& operator=(const SourceFile&) = delete;
+        bool open(const std::string& file_path);
+        void close();
+        std::string_view view() {return std::string_view(this->data, this->size);}
+        bool is_mapped() {return this->mapped;}
+    private:
+        bool read_stream(int fd);
+        const char* data {nullptr};
+        size_t size {0};
+        bool mapped {false};
+        std::string buffer; // holds the contents of files that couldn't be mapped
+};
+
+#endif
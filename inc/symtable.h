@@ -1,25 +1,57 @@
 #ifndef SYM_TABLE_H
 #define SYM_TABLE_H
 
-#include <memory>
+#include <functional>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 
 #include "../inc/values.hpp"
 
+// the location of a variable in the environment, along with its declared type
+struct Symbol{
+    unsigned depth; // the number of call frames between the reference and the variable, always 0 until functions are implemented
+    unsigned slot;  // the variable's index within its frame
+    ValueType type;
+};
+
+// allows symbols to be looked up by string_view without allocating a key
+struct SymbolHash{
+    using is_transparent = void;
+    size_t operator()(std::string_view symbol) const {return std::hash<std::string_view>{}(symbol);}
+};
+
+/*
+    maps the variables of a scope to slots in their frame. Nested scopes allocate their slots after those of their parent,
+    so sibling scopes share slots, and the root scope tracks how many slots the whole frame needs. Every symbol records
+    the order it was declared in, so names can be resolved as they were when a scope was created
+*/
 class SymbolTable{
     public:
-        SymbolTable() {}
-        SymbolTable(SymbolTable* parent);
-        void create(const std::string& symbol, ValueType type);
+        SymbolTable(std::pmr::memory_resource* resource = std::pmr::get_default_resource()): table(resource) {}
+        SymbolTable(SymbolTable* parent, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+        const Symbol& create(std::string_view symbol, ValueType type);
         void clear();
         // getters
-        std::shared_ptr<Value> get(const std::string& val);
-        bool exists(const std::string& symbol);
+        const Symbol* get(std::string_view symbol);
+        const Symbol* lookup(std::string_view symbol);
+        bool exists(std::string_view symbol);
         SymbolTable* get_parent() {return this->parent;}
+        size_t frame_size() {return this->root->max_slots;}
     private:
         SymbolTable* parent {nullptr};
-        std::unordered_map<std::string, std::shared_ptr<Value>> table;
+        SymbolTable* root {this};
+        unsigned base {0};
+        unsigned next_slot {0};
+        unsigned max_slots {0};
+        unsigned declarations {0}; // the number of symbols created in the whole frame, only kept by the root
+        unsigned visible {0}; // the number of symbols that had been created in the frame when this scope was
+        struct Entry{
+            Symbol symbol;
+            unsigned order; // the number of symbols created in the frame before this one
+        };
+        std::pmr::unordered_map<std::pmr::string, Entry, SymbolHash, std::equal_to<>> table;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,28 @@
+#ifndef TYPECHECKER_H
+#define TYPECHECKER_H
+
+#include <optional>
+#include <string>
+
+#include "../inc/values.hpp"
+#include "../inc/nodes.hpp"
+#include "../inc/block.h"
+
+/*
+    checks the types of a parsed program before it is evaluated. Type errors are thrown as soon as they are found, and every
+    node whose operand types are proven is marked as checked, so its runtime type checks can be skipped
+*/
+class TypeChecker{
+    public:
+        void check(Node* statement);
+    private:
+        // the static type of an expression, or nullopt if it can only be known at runtime
+        using StaticType = std::optional<ValueType>;
+        StaticType infer(Node* node);
+        StaticType infer_block(BlockNode* block);
+        StaticType infer_statements(BlockNode* block);
+        void check_condition(BlockNode* block, Node* condition);
+        [[noreturn]] void error(Node* node, const std::string& msg);
+};
+
+#endif
@@ -2,12 +2,12 @@
 #define VALUE_H
 
 #include <iostream>
-#include <vector>
+#include <memory>
 #include <cstring>
 #include <cstddef>
 #include <stdexcept>
 
-class NebulaArray;
+class Value;
 
 enum ValueType{
     INT,
@@ -17,12 +17,65 @@ enum ValueType{
     NULL_TYPE
 };
 
+/*
+    this is the internal representation of arrays for nebula, simmilar to a minimized version of std::vector. Elements are stored
+    unboxed in one buffer of the array's element type, so an int array takes 4 bytes per element and is read linearly
+*/
+class NebulaArray{
+    public:
+        NebulaArray() {this->arr_ptr = nullptr; this->val_type = NULL_TYPE;}
+        NebulaArray(ValueType type);
+        NebulaArray(const NebulaArray& other);
+        NebulaArray& operator=(const NebulaArray& other);
+        ~NebulaArray();
+        static size_t element_size(ValueType type);
+        Value get(int index) const;
+        void set(int index, const Value& val);
+        template <typename T>
+        T at(int index) const;
+        template <typename T>
+        void put(int index, const T& val);
+        template <typename T>
+        const T* data() const {return reinterpret_cast<const T*>(this->arr_ptr);}
+        template <typename T>
+        T* data() {return reinterpret_cast<T*>(this->arr_ptr);}
+        int length() const {return this->size;}
+        void resize(int size);
+        ValueType get_type() const {return this->val_type;}
+        size_t bytes_used() const {return this->capacity * element_size(this->val_type);}
+    private:
+        int size {0};
+        int capacity {32};
+        std::byte* arr_ptr;
+        ValueType val_type;
+        static std::byte* allocate(std::byte* old_ptr, size_t bytes);
+        void reserve_index(int index);
+        void realloc();
+};
+
+// reads an element as T, which must be the array's element type. The index must already be in range
+template <typename T>
+T NebulaArray::at(int index) const{
+    T retval;
+    std::memcpy(&retval, this->arr_ptr + index * sizeof(T), sizeof(T));
+    return retval;
+}
+// writes an element as T, which must be the array's element type. Writing one past the end appends it
+template <typename T>
+void NebulaArray::put(int index, const T& val){
+    this->reserve_index(index);
+    std::memcpy(this->arr_ptr + index * sizeof(T), &val, sizeof(T));
+}
+
+// scalar values are stored inline, only arrays own heap memory
 class Value{
     public:
-        Value() {}
-        ~Value();
-        Value(ValueType type, const std::vector<std::byte>& val, bool is_arr = false);
-        Value(ValueType type, bool is_arr = false) {this->type = type;};
+        Value() {this->val.int_val = 0;}
+        Value(ValueType type, bool is_arr = false);
+        Value(const Value& other);
+        Value(Value&& other) noexcept = default;
+        Value& operator=(const Value& other);
+        Value& operator=(Value&& other) noexcept = default;
         template <typename T>
         static Value create(ValueType type, const T& val, bool is_arr = false);
         template <typename T>
@@ -32,64 +85,93 @@ class Value{
         T as() const;
         template <typename T>
         void update(const T& new_val);
+        template <typename T>
+        void set(ValueType type, const T& new_val);
         bool operator==(const Value& rhs) const;
         ValueType get_type() const {return this->type;};
         bool is_null() {return this->type == NULL_TYPE;}
+        static constexpr size_t MAX_FORMATTED = 32; // the most characters format can write, %g never needs more than "-1.79769e+308"
+        size_t format(char* dst) const;
         friend std::ostream& operator<<(std::ostream& out, const Value& val); 
-        bool is_array() {return this->is_arr;}
+        bool is_array() const {return this->arr != nullptr;}
         NebulaArray& as_arr();
+        const NebulaArray& as_arr() const {return const_cast<Value*>(this)->as_arr();}
     private:
-        std::vector<std::byte> val;
-        ValueType type;
-        bool is_arr;
-        NebulaArray* arr {nullptr};
+        union{
+            int int_val;
+            double float_val;
+            char char_val;
+            bool bool_val;
+        } val;
+        ValueType type {NULL_TYPE};
+        std::unique_ptr<NebulaArray> arr;
 };
 
+inline Value::Value(ValueType type, bool is_arr){
+    this->val.int_val = 0;
+    this->type = type;
+    if (is_arr)
+        this->arr = std::make_unique<NebulaArray>(type);
+}
+
+inline Value::Value(const Value& other){
+    this->val = other.val;
+    this->type = other.type;
+    if (other.arr)
+        this->arr = std::make_unique<NebulaArray>(*other.arr);
+}
+
+inline Value& Value::operator=(const Value& other){
+    if (this == &other)
+        return *this;
+    this->val = other.val;
+    this->type = other.type;
+    if (other.arr)
+        this->arr = std::make_unique<NebulaArray>(*other.arr);
+    else
+        this->arr.reset();
+    return *this;
+}
+
 template <typename T>
 Value Value::create(ValueType type, const T& val, bool is_arr){
-    std::vector<std::byte> bytes;
-    bytes.resize(sizeof(T));
-    std::memcpy(&bytes[0], &val, sizeof(T));
-    return std::move(Value(type, bytes, is_arr));
+    Value ret(type, is_arr);
+    ret.update(val);
+    return ret;
 }
 
 // this creates a new dynamically allocated Value of a given type USE WITH CAUTION
 template <typename T>
 Value* Value::create_dyn(ValueType type, const T& val, bool is_arr){
-    std::vector<std::byte> bytes;
-    bytes.resize(sizeof(T));
-    std::memcpy(&bytes[0], &val, sizeof(T));
-    return new Value(type, bytes, is_arr);
+    Value* ret = new Value(type, is_arr);
+    ret->update(val);
+    return ret;
 }
 
 
 template <typename T>
 T Value::as() const{
+    static_assert(sizeof(T) <= sizeof(val), "type is too large to be stored in a value");
     if (this->type ==  NULL_TYPE)
         throw std::runtime_error("cannot evaluate void value");
     T retval;
-    std::memcpy(&retval, &this->val[0], sizeof(T));
+    std::memcpy(&retval, &this->val, sizeof(T));
     return retval;
 }
 
 template <typename T>
 void Value::update(const T& new_val){
-    std::memcpy(&this->val[0], &new_val, sizeof(T));
+    static_assert(sizeof(T) <= sizeof(val), "type is too large to be stored in a value");
+    std::memcpy(&this->val, &new_val, sizeof(T));
 }
 
-// this is the internal representation of arrays for nebula, simmilar to a minimized version of std::vector
-class NebulaArray{
-    public:
-        NebulaArray() {this->arr_ptr = nullptr; this->val_type = NULL_TYPE;}
-        NebulaArray(ValueType type);
-        ~NebulaArray();
-        Value& get(int index);
-    private:
-        int size {0};
-        int capacity {32};
-        Value* arr_ptr;
-        ValueType val_type;
-        void realloc();
-};
+// overwrites the value with a scalar of the given type, this avoids building a temporary value in hot loops
+template <typename T>
+void Value::set(ValueType type, const T& new_val){
+    if (this->arr)
+        this->arr.reset();
+    this->type = type;
+    this->update(new_val);
+}
 
 #endif
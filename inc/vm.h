@@ -0,0 +1,22 @@
+#ifndef VM_H
+#define VM_H
+
+#include <vector>
+
+#include "../inc/bytecode.h"
+#include "../inc/environment.h"
+#include "../inc/output.h"
+#include "../inc/values.hpp"
+
+// a stack based virtual machine that runs chunks produced by the compiler
+class VM{
+    public:
+        VM() {}
+        Value run(const Chunk& chunk, Environment& env);
+        void set_output(OutputBuffer* output) {this->output = output;}
+    private:
+        std::vector<Value> stack;
+        OutputBuffer* output {&OutputBuffer::standard()};
+};
+
+#endif
@@ -0,0 +1,72 @@
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string_view>
+
+#include "../inc/arena.h"
+
+Arena::Arena(size_t chunk_size){
+    this->chunk_size = chunk_size;
+}
+
+Arena::~Arena(){
+    while (this->head){
+        Chunk* next = this->head->next;
+        std::free(this->head);
+        this->head = next;
+    }
+}
+
+// bumps the current pointer, only falling back to a new chunk when the current one is full
+void* Arena::do_allocate(size_t bytes, size_t alignment){
+    uintptr_t aligned = (reinterpret_cast<uintptr_t>(this->curr) + alignment - 1) & ~(alignment - 1);
+    if (this->curr && aligned + bytes <= reinterpret_cast<uintptr_t>(this->end)){
+        this->curr = reinterpret_cast<std::byte*>(aligned + bytes);
+        this->used += bytes;
+        return reinterpret_cast<void*>(aligned);
+    }
+    return this->grow(bytes, alignment);
+}
+
+// allocates a new chunk large enough for the given allocation and makes it the current chunk
+void* Arena::grow(size_t bytes, size_t alignment){
+    size_t size = this->chunk_size;
+    while (size < bytes + alignment + sizeof(Chunk))
+        size *= 2;
+    Chunk* chunk = static_cast<Chunk*>(std::malloc(size));
+    if (!chunk)
+        throw std::bad_alloc();
+    chunk->next = this->head;
+    chunk->size = size;
+    this->head = chunk;
+    this->curr = reinterpret_cast<std::byte*>(chunk + 1);
+    this->end = reinterpret_cast<std::byte*>(chunk) + size;
+    return this->do_allocate(bytes, alignment);
+}
+
+// copies a string into the arena, the returned view is valid until the arena is reset
+std::string_view Arena::copy_str(std::string_view str){
+    char* buf = static_cast<char*>(this->allocate(str.size() ? str.size() : 1, 1));
+    std::memcpy(buf, str.data(), str.size());
+    return std::string_view(buf, str.size());
+}
+
+/*
+    releases everything allocated in the arena. The most recent chunk is kept to be reused by the next parse, so resetting
+    an arena that fit in one chunk is constant time
+*/
+void Arena::reset(){
+    if (!this->head)
+        return;
+    Chunk* chunk = this->head->next;
+    while (chunk){
+        Chunk* next = chunk->next;
+        std::free(chunk);
+        chunk = next;
+    }
+    this->head->next = nullptr;
+    this->curr = reinterpret_cast<std::byte*>(this->head + 1);
+    this->end = reinterpret_cast<std::byte*>(this->head) + this->head->size;
+    this->used = 0;
+}
@@ -0,0 +1,346 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+
+#include "../inc/arrayops.h"
+#include "../inc/nodes.hpp"
+#include "../inc/values.hpp"
+
+// NEBULA_SIMD is decided by arrayops.h
+#ifdef NEBULA_SIMD
+#include <immintrin.h>
+#endif
+
+enum ReduceOp{
+    ReduceSum,
+    ReduceMin,
+    ReduceMax,
+    ReduceDot
+};
+
+// returns the widest level of vector instructions the CPU supports
+SimdLevel detect_simd(){
+#ifdef NEBULA_SIMD
+    if (__builtin_cpu_supports("avx2"))
+        return SimdAVX2;
+    // every x86-64 CPU has SSE2
+    return SimdSSE2;
+#else
+    return SimdScalar;
+#endif
+}
+
+// atomic so interpreters on other threads can read it while it's being set
+static std::atomic<SimdLevel> simd_level = detect_simd();
+
+SimdLevel get_simd_level(){
+    return simd_level;
+}
+// selects the level the kernels use, this can't be wider than the CPU supports, so it's mostly useful for testing narrower paths
+void set_simd_level(SimdLevel level){
+    simd_level = std::min(level, detect_simd());
+}
+
+/* SCALAR KERNELS */
+// applies an element-wise operation to two elements. Ints wrap on overflow, just as they do in the vector kernels
+template <typename T, Operator Op>
+inline T scalar_op(T lhs, T rhs){
+    if constexpr (std::is_same_v<T, int>){
+        uint32_t x = lhs, y = rhs;
+        if constexpr (Op == ArithAdd)
+            return static_cast<int>(x + y);
+        else if constexpr (Op == ArithSub)
+            return static_cast<int>(x - y);
+        else
+            return static_cast<int>(x * y);
+    }
+    else{
+        if constexpr (Op == ArithAdd)
+            return lhs + rhs;
+        else if constexpr (Op == ArithSub)
+            return lhs - rhs;
+        else if constexpr (Op == ArithMul)
+            return lhs * rhs;
+        else
+            return lhs / rhs;
+    }
+}
+// maps the elements from start to n, an operand with a step of 0 is a scalar applied to every element
+template <typename T, Operator Op>
+void map_scalar(const T* a, size_t a_step, const T* b, size_t b_step, T* out, size_t start, size_t n){
+    for (size_t i = start; i < n; i++)
+        out[i] = scalar_op<T, Op>(a[i * a_step], b[i * b_step]);
+}
+// combines an element, or the product of two for a dot product, into a partial reduction
+template <typename T>
+inline T fold(ReduceOp op, T result, T val){
+    switch (op){
+        case ReduceMin:
+            return std::min(result, val);
+        case ReduceMax:
+            return std::max(result, val);
+        default:
+            return scalar_op<T, ArithAdd>(result, val);
+    }
+}
+
+#ifdef NEBULA_SIMD
+/*
+    VECTOR KERNELS. Each kernel processes as many whole vectors as fit in the array and returns how many elements that covered,
+    leaving the rest to the scalar kernels. The AVX2 kernels are compiled for AVX2 alone, and are only called once the CPU is
+    known to support it
+*/
+#define SSE_LOAD_I(p) _mm_loadu_si128(reinterpret_cast<const __m128i*>(p))
+#define SSE_STORE_I(p, v) _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v)
+#define AVX_LOAD_I(p) _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))
+#define AVX_STORE_I(p, v) _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v)
+
+// runs EXPR over every whole vector, an operand with a step of 0 was broadcast into a_vec or b_vec up front
+#define VECTOR_MAP(WIDTH, LOAD, STORE, EXPR) \
+    for (; i + WIDTH <= n; i += WIDTH){ \
+        auto x = a_step ? LOAD(a + i) : a_vec; \
+        auto y = b_step ? LOAD(b + i) : b_vec; \
+        STORE(out + i, EXPR); \
+    }
+/*
+    accumulates every whole vector into acc with EXPR, then folds acc's lanes into the result. The float min and max take the
+    accumulator as their second operand, which they return if either is NaN, so NaNs are skipped just as std::min and std::max
+    skip them in fold
+*/
+#define VECTOR_REDUCE(T, WIDTH, STORE, INIT, EXPR) { \
+        auto acc = INIT; \
+        for (; i + WIDTH <= n; i += WIDTH) \
+            acc = EXPR; \
+        alignas(32) T lanes[WIDTH]; \
+        STORE(lanes, acc); \
+        for (T lane : lanes) \
+            result = fold(op, result, lane); \
+    }
+
+// SSE2 has no 32-bit min, max or multiply, so the min and max are built from a comparison
+inline __m128i sse2_min_epi32(__m128i x, __m128i y){
+    __m128i greater = _mm_cmpgt_epi32(x, y);
+    return _mm_or_si128(_mm_and_si128(greater, y), _mm_andnot_si128(greater, x));
+}
+inline __m128i sse2_max_epi32(__m128i x, __m128i y){
+    __m128i greater = _mm_cmpgt_epi32(x, y);
+    return _mm_or_si128(_mm_and_si128(greater, x), _mm_andnot_si128(greater, y));
+}
+// and the multiply from two 64-bit multiplies of the even and odd lanes, keeping the low half of each, which wraps like ints do
+inline __m128i sse2_mullo_epi32(__m128i x, __m128i y){
+    __m128i even = _mm_mul_epu32(x, y);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(x, 32), _mm_srli_epi64(y, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+size_t map_sse2(Operator op, const int* a, size_t a_step, const int* b, size_t b_step, int* out, size_t n){
+    __m128i a_vec = _mm_set1_epi32(a[0]), b_vec = _mm_set1_epi32(b[0]);
+    size_t i = 0;
+    switch (op){
+        case ArithAdd: VECTOR_MAP(4, SSE_LOAD_I, SSE_STORE_I, _mm_add_epi32(x, y)) break;
+        case ArithSub: VECTOR_MAP(4, SSE_LOAD_I, SSE_STORE_I, _mm_sub_epi32(x, y)) break;
+        case ArithMul: VECTOR_MAP(4, SSE_LOAD_I, SSE_STORE_I, sse2_mullo_epi32(x, y)) break;
+        default: break;
+    }
+    return i;
+}
+size_t map_sse2(Operator op, const double* a, size_t a_step, const double* b, size_t b_step, double* out, size_t n){
+    __m128d a_vec = _mm_set1_pd(a[0]), b_vec = _mm_set1_pd(b[0]);
+    size_t i = 0;
+    switch (op){
+        case ArithAdd: VECTOR_MAP(2, _mm_loadu_pd, _mm_storeu_pd, _mm_add_pd(x, y)) break;
+        case ArithSub: VECTOR_MAP(2, _mm_loadu_pd, _mm_storeu_pd, _mm_sub_pd(x, y)) break;
+        case ArithMul: VECTOR_MAP(2, _mm_loadu_pd, _mm_storeu_pd, _mm_mul_pd(x, y)) break;
+        case ArithDiv: VECTOR_MAP(2, _mm_loadu_pd, _mm_storeu_pd, _mm_div_pd(x, y)) break;
+        default: break;
+    }
+    return i;
+}
+size_t reduce_sse2(ReduceOp op, const int* a, const int* b, size_t n, int& result){
+    size_t i = 0;
+    switch (op){
+        case ReduceSum: VECTOR_REDUCE(int, 4, SSE_STORE_I, _mm_setzero_si128(), _mm_add_epi32(acc, SSE_LOAD_I(a + i))) break;
+        case ReduceMin: VECTOR_REDUCE(int, 4, SSE_STORE_I, _mm_set1_epi32(a[0]), sse2_min_epi32(acc, SSE_LOAD_I(a + i))) break;
+        case ReduceMax: VECTOR_REDUCE(int, 4, SSE_STORE_I, _mm_set1_epi32(a[0]), sse2_max_epi32(acc, SSE_LOAD_I(a + i))) break;
+        case ReduceDot:
+            VECTOR_REDUCE(int, 4, SSE_STORE_I, _mm_setzero_si128(), _mm_add_epi32(acc, sse2_mullo_epi32(SSE_LOAD_I(a + i), SSE_LOAD_I(b + i))))
+            break;
+    }
+    return i;
+}
+size_t reduce_sse2(ReduceOp op, const double* a, const double* b, size_t n, double& result){
+    size_t i = 0;
+    switch (op){
+        case ReduceSum: VECTOR_REDUCE(double, 2, _mm_store_pd, _mm_setzero_pd(), _mm_add_pd(acc, _mm_loadu_pd(a + i))) break;
+        case ReduceMin: VECTOR_REDUCE(double, 2, _mm_store_pd, _mm_set1_pd(a[0]), _mm_min_pd(_mm_loadu_pd(a + i), acc)) break;
+        case ReduceMax: VECTOR_REDUCE(double, 2, _mm_store_pd, _mm_set1_pd(a[0]), _mm_max_pd(_mm_loadu_pd(a + i), acc)) break;
+        case ReduceDot:
+            VECTOR_REDUCE(double, 2, _mm_store_pd, _mm_setzero_pd(), _mm_add_pd(acc, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i))))
+            break;
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t map_avx2(Operator op, const int* a, size_t a_step, const int* b, size_t b_step, int* out, size_t n){
+    __m256i a_vec = _mm256_set1_epi32(a[0]), b_vec = _mm256_set1_epi32(b[0]);
+    size_t i = 0;
+    switch (op){
+        case ArithAdd: VECTOR_MAP(8, AVX_LOAD_I, AVX_STORE_I, _mm256_add_epi32(x, y)) break;
+        case ArithSub: VECTOR_MAP(8, AVX_LOAD_I, AVX_STORE_I, _mm256_sub_epi32(x, y)) break;
+        case ArithMul: VECTOR_MAP(8, AVX_LOAD_I, AVX_STORE_I, _mm256_mullo_epi32(x, y)) break;
+        default: break;
+    }
+    return i;
+}
+__attribute__((target("avx2")))
+size_t map_avx2(Operator op, const double* a, size_t a_step, const double* b, size_t b_step, double* out, size_t n){
+    __m256d a_vec = _mm256_set1_pd(a[0]), b_vec = _mm256_set1_pd(b[0]);
+    size_t i = 0;
+    switch (op){
+        case ArithAdd: VECTOR_MAP(4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_add_pd(x, y)) break;
+        case ArithSub: VECTOR_MAP(4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_sub_pd(x, y)) break;
+        case ArithMul: VECTOR_MAP(4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_mul_pd(x, y)) break;
+        case ArithDiv: VECTOR_MAP(4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_div_pd(x, y)) break;
+        default: break;
+    }
+    return i;
+}
+__attribute__((target("avx2")))
+size_t reduce_avx2(ReduceOp op, const int* a, const int* b, size_t n, int& result){
+    size_t i = 0;
+    switch (op){
+        case ReduceSum: VECTOR_REDUCE(int, 8, AVX_STORE_I, _mm256_setzero_si256(), _mm256_add_epi32(acc, AVX_LOAD_I(a + i))) break;
+        case ReduceMin: VECTOR_REDUCE(int, 8, AVX_STORE_I, _mm256_set1_epi32(a[0]), _mm256_min_epi32(acc, AVX_LOAD_I(a + i))) break;
+        case ReduceMax: VECTOR_REDUCE(int, 8, AVX_STORE_I, _mm256_set1_epi32(a[0]), _mm256_max_epi32(acc, AVX_LOAD_I(a + i))) break;
+        case ReduceDot:
+            VECTOR_REDUCE(int, 8, AVX_STORE_I, _mm256_setzero_si256(), _mm256_add_epi32(acc, _mm256_mullo_epi32(AVX_LOAD_I(a + i), AVX_LOAD_I(b + i))))
+            break;
+    }
+    return i;
+}
+__attribute__((target("avx2")))
+size_t reduce_avx2(ReduceOp op, const double* a, const double* b, size_t n, double& result){
+    size_t i = 0;
+    switch (op){
+        case ReduceSum: VECTOR_REDUCE(double, 4, _mm256_store_pd, _mm256_setzero_pd(), _mm256_add_pd(acc, _mm256_loadu_pd(a + i))) break;
+        case ReduceMin: VECTOR_REDUCE(double, 4, _mm256_store_pd, _mm256_set1_pd(a[0]), _mm256_min_pd(_mm256_loadu_pd(a + i), acc)) break;
+        case ReduceMax: VECTOR_REDUCE(double, 4, _mm256_store_pd, _mm256_set1_pd(a[0]), _mm256_max_pd(_mm256_loadu_pd(a + i), acc)) break;
+        case ReduceDot:
+            VECTOR_REDUCE(double, 4, _mm256_store_pd, _mm256_setzero_pd(), _mm256_add_pd(acc, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i))))
+            break;
+    }
+    return i;
+}
+#endif
+
+/* DISPATCH */
+// maps every element of two operands into out, using the widest kernel available for the operator and finishing with scalars
+template <typename T>
+void map_elements(Operator op, const T* a, size_t a_step, const T* b, size_t b_step, T* out, size_t n){
+    size_t done = 0;
+#ifdef NEBULA_SIMD
+    if (simd_level == SimdAVX2)
+        done = map_avx2(op, a, a_step, b, b_step, out, n);
+    else if (simd_level == SimdSSE2)
+        done = map_sse2(op, a, a_step, b, b_step, out, n);
+#endif
+    switch (op){
+        case ArithAdd: map_scalar<T, ArithAdd>(a, a_step, b, b_step, out, done, n); break;
+        case ArithSub: map_scalar<T, ArithSub>(a, a_step, b, b_step, out, done, n); break;
+        case ArithMul: map_scalar<T, ArithMul>(a, a_step, b, b_step, out, done, n); break;
+        default: map_scalar<T, ArithDiv>(a, a_step, b, b_step, out, done, n); break;
+    }
+}
+// reduces an array, or the products of two for a dot product, using the widest kernel available and finishing with scalars
+template <typename T>
+T reduce_elements(ReduceOp op, const T* a, const T* b, size_t n){
+    T result = (op == ReduceMin || op == ReduceMax) ? a[0] : T(0);
+    size_t i = 0;
+#ifdef NEBULA_SIMD
+    if (simd_level == SimdAVX2)
+        i = reduce_avx2(op, a, b, n, result);
+    else if (simd_level == SimdSSE2)
+        i = reduce_sse2(op, a, b, n, result);
+#endif
+    for (; i < n; i++)
+        result = fold(op, result, op == ReduceDot ? scalar_op<T, ArithMul>(a[i], b[i]) : a[i]);
+    return result;
+}
+
+// computes lhs <op> rhs into out, either operand may be a scalar
+template <typename T>
+void map_values(Operator op, const Value& lhs, const Value& rhs, NebulaArray& out){
+    // a scalar is read through a step of 0, so it's applied to every element
+    T lhs_scalar = lhs.is_array() ? T() : lhs.as<T>();
+    T rhs_scalar = rhs.is_array() ? T() : rhs.as<T>();
+    const T* a = lhs.is_array() ? lhs.as_arr().data<T>() : &lhs_scalar;
+    const T* b = rhs.is_array() ? rhs.as_arr().data<T>() : &rhs_scalar;
+    size_t a_step = lhs.is_array(), b_step = rhs.is_array();
+    T* dst = out.data<T>();
+    size_t n = out.length();
+    constexpr bool is_int = std::is_same_v<T, int>;
+    if (op == ArithAdd || op == ArithSub || op == ArithMul || (op == ArithDiv && !is_int)){
+        map_elements(op, a, a_step, b, b_step, dst, n);
+        return;
+    }
+    // the remaining operators have no vector instructions, and match scalar arithmetic exactly
+    if (!is_int && op == ArithMod)
+        throw std::runtime_error("cannot use the '%' operator on float arrays");
+    for (size_t i = 0; i < n; i++)
+        dst[i] = ArithNode::calculate(op, a[i * a_step], b[i * b_step], is_int).template as<T>();
+}
+
+Value array_arith(Operator op, const Value& lhs, const Value& rhs){
+    ValueType type = lhs.get_type();
+    if (type != rhs.get_type())
+        throw std::runtime_error("cannot perform arithmetic on differing types");
+    if (type != INT && type != FLOAT)
+        throw std::runtime_error("invalid operation for non-numeric types");
+    if (lhs.is_array() && rhs.is_array() && lhs.as_arr().length() != rhs.as_arr().length())
+        throw std::runtime_error("cannot perform arithmetic on arrays of differing lengths");
+    Value result(type, true);
+    result.as_arr().resize(lhs.is_array() ? lhs.as_arr().length() : rhs.as_arr().length());
+    if (result.as_arr().length() == 0)
+        return result;
+    if (type == INT)
+        map_values<int>(op, lhs, rhs, result.as_arr());
+    else
+        map_values<double>(op, lhs, rhs, result.as_arr());
+    return result;
+}
+
+// reduces an int or float array, or two of the same length for a dot product
+Value reduce_values(ReduceOp op, const Value& lhs, const Value* rhs){
+    if (!lhs.is_array() || (rhs && !rhs->is_array()))
+        throw std::runtime_error("cannot reduce a non-array value");
+    ValueType type = lhs.get_type();
+    if (type != INT && type != FLOAT)
+        throw std::runtime_error("invalid operation for non-numeric types");
+    const NebulaArray& arr = lhs.as_arr();
+    if (rhs && (rhs->get_type() != type || rhs->as_arr().length() != arr.length()))
+        throw std::runtime_error("cannot take the dot product of arrays of differing types or lengths");
+    if (arr.length() == 0){
+        if (op == ReduceMin || op == ReduceMax)
+            throw std::runtime_error("cannot find the minimum or maximum of an empty array");
+        return type == INT ? Value::create(INT, 0) : Value::create(FLOAT, 0.0);
+    }
+    if (type == INT)
+        return Value::create(INT, reduce_elements<int>(op, arr.data<int>(), rhs ? rhs->as_arr().data<int>() : nullptr, arr.length()));
+    return Value::create(FLOAT, reduce_elements<double>(op, arr.data<double>(), rhs ? rhs->as_arr().data<double>() : nullptr, arr.length()));
+}
+
+Value array_sum(const Value& arr){
+    return reduce_values(ReduceSum, arr, nullptr);
+}
+Value array_min(const Value& arr){
+    return reduce_values(ReduceMin, arr, nullptr);
+}
+Value array_max(const Value& arr){
+    return reduce_values(ReduceMax, arr, nullptr);
+}
+Value array_dot(const Value& lhs, const Value& rhs){
+    return reduce_values(ReduceDot, lhs, &rhs);
+}
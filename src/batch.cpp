@@ -0,0 +1,44 @@
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+#include <thread>
+
+#include "../inc/batch.h"
+
+// uses the given number of threads, or one for every core if it's 0
+BatchRunner::BatchRunner(unsigned threads){
+    this->threads = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+}
+
+// runs every script on a fresh interpreter, with each thread taking the next script that hasn't been started
+std::vector<ScriptResult> BatchRunner::run(const std::vector<std::string>& scripts){
+    std::vector<ScriptResult> results(scripts.size());
+    std::atomic<size_t> next_script {0};
+    auto worker = [&](){
+        for (size_t i = next_script++; i < scripts.size(); i = next_script++){
+            ScriptResult& result = results[i];
+            Interpreter interpreter;
+            std::ostringstream out;
+            interpreter.set_backend(this->backend);
+            interpreter.set_opt_level(this->opt_level);
+            interpreter.set_output(out);
+            result.status = interpreter.run(scripts[i]);
+            result.output = out.str();
+            if (result.status){
+                result.err_msg = interpreter.get_err();
+                continue;
+            }
+            Value val = interpreter.result();
+            char buffer[Value::MAX_FORMATTED];
+            result.result_type = val.get_type();
+            result.result.assign(buffer, val.format(buffer));
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < std::min<size_t>(this->threads, scripts.size()); i++)
+        workers.emplace_back(worker);
+    worker();
+    for (std::thread& thread : workers)
+        thread.join();
+    return results;
+}
@@ -4,23 +4,24 @@
 
 #include "../inc/nodes.hpp"
 #include "../inc/block.h"
+#include "../inc/parser.h"
 
 /* Base block methods */
-BlockNode::BlockNode(SymbolTable* scope_ptr){
+// the block's statements are allocated from the given resource, which is normally the parser's arena
+BlockNode::BlockNode(SymbolTable* scope_ptr, std::pmr::memory_resource* resource): statements(resource){
     this->scope = scope_ptr;
     this->node_type = Block_N;
     this->block_t = Base;
 }
-BlockNode::~BlockNode(){
-    for (int i = 0; i < this->statements.size(); i++)
-        delete this->statements[i];
-    delete this->scope;
-}
+// evaluates every statement in the block, only the value of the last one is kept and returned
 Value BlockNode::eval(){
+    if (this->parser)
+        this->parse_body();
+    Value last(NULL_TYPE);
     size_t statement_count = statements.size();
     for (int i = 0; i < statement_count; i++)
-        this->eval_stack.push(std::move(statements[i]->eval()));
-    return this->eval_stack.top();
+        last = eval_child(statements[i]);
+    return last;
 }
 void BlockNode::push_statement(Node* statement){
     this->statements.push_back(statement);
@@ -30,23 +31,28 @@ Node* BlockNode::pop_statement(){
     this->statements.pop_back();
     return retval;
 }
+// leaves the block's body to be parsed from the given token the first time it's needed
+void BlockNode::defer(Parser* parser, size_t body_pos){
+    this->parser = parser;
+    this->body_pos = body_pos;
+}
+// builds the statements of a deferred block, including the else clause of a conditional
+void BlockNode::parse_body(){
+    Parser* parser = this->parser;
+    this->parser = nullptr;
+    parser->parse_deferred(this, this->body_pos);
+}
 
 /* Eval block methods */
 Value EvalBlockNode::eval(){
-    return this->body->eval();
+    return eval_child(this->body);
 }
 
 /* Conditional Block Methods */
-CondBlockNode::CondBlockNode(SymbolTable* scope_ptr, Node* cond_ptr){
-    this->scope = scope_ptr;
+CondBlockNode::CondBlockNode(SymbolTable* scope_ptr, Node* cond_ptr, std::pmr::memory_resource* resource): BlockNode(scope_ptr, resource){
     this->condition = cond_ptr;
     this->node_type = Block_N;
     this->block_t = Conditional;
-    this->eval_stack.push(Value(NULL_TYPE)); // this is so that the node can evaluate to something, even if the condition is false
-}
-CondBlockNode::~CondBlockNode(){
-    delete this->else_body;
-    BlockNode::~BlockNode();
 }
 /* 
     this sets the given block to the conditional block's else clause, all nodes to pushed to the conditional after this function is
@@ -75,31 +81,48 @@ size_t CondBlockNode::statement_count(){
     return this->statements.size();
 }
 Value CondBlockNode::eval(){
-    Value cond_val = this->condition->eval();
-    if (cond_val.get_type() != BOOL)
+    Value cond_val = eval_child(this->condition);
+    if (!this->checked && cond_val.get_type() != BOOL)
         throw std::runtime_error("invalid conditional");
     if (cond_val.as<bool>())
         return BlockNode::eval();
+    // a deferred body is only parsed here if it has an else clause to run
+    if (this->parser && this->deferred_else)
+        this->parse_body();
     if (this->else_body)
         return else_body->eval();
-    return Value(this->eval_stack.top());
+    // the conditional evaluates to null when neither branch runs
+    return Value(NULL_TYPE);
 }
 
 /* Loop Block Functions */
-LoopBlockNode::LoopBlockNode(SymbolTable* scope_ptr, Node* cond_ptr){
-    this->scope = scope_ptr;
+LoopBlockNode::LoopBlockNode(SymbolTable* scope_ptr, Node* cond_ptr, std::pmr::memory_resource* resource, CodeHeap* code_heap): BlockNode(scope_ptr, resource){
     this->condition = cond_ptr;
+    this->code_heap = code_heap;
     this->node_type = Block_N;
     this->block_t = Loop;
-    this->eval_stack.push(Value(NULL_TYPE)); // this is so that the node can evaluate to something, even if the loop never runs
 }
+// runs the loop's body until its condition is false, evaluating to the value of the last iteration, or null if it never ran
 Value LoopBlockNode::eval(){
-    Value cond_val = this->condition->eval();
-    if (cond_val.get_type() != BOOL)
-        throw std::runtime_error("invalid conditional");
-    while (this->condition->eval().as<bool>()){
-        this->eval_stack.push(BlockNode::eval());
-        //this->scope->clear();
+    if (this->parser)
+        this->parse_body();
+    Value last(NULL_TYPE);
+    if (this->native && this->native->run(last))
+        return last;
+    while (true){
+        Value cond_val = eval_child(this->condition);
+        if (!this->checked && cond_val.get_type() != BOOL)
+            throw std::runtime_error("invalid conditional");
+        if (!cond_val.as<bool>())
+            break;
+        last = BlockNode::eval();
+        // the loop is only compiled once, after its nodes have been specialised, and the remaining iterations run natively
+        if (this->code_heap && ++this->iterations == HOT_ITERATIONS){
+            this->native = JitCompiler(*this->code_heap).compile(this);
+            this->code_heap = nullptr;
+            if (this->native && this->native->run(last))
+                break;
+        }
     }
-    return Value(this->eval_stack.top()); 
+    return last;
 }
\ No newline at end of file
@@ -0,0 +1,244 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+
+#include "../inc/cache.h"
+#include "../inc/regvm.h"
+#include "../inc/source.h"
+
+/*
+    a cache file is a fixed size header followed by the program's code, variables, constants and messages, in that order. Every
+    field is a 32 or 64 bit integer in the machine's byte order, so a mapped file is read by copying its fields straight out
+*/
+static const char MAGIC[4] = {'N', 'E', 'B', 'C'};
+static const uint32_t VERSION = 1; // must be bumped whenever the format or the meaning of any instruction changes
+
+struct CacheHeader{
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t code_count;
+    uint32_t var_count;
+    uint32_t const_count;
+    uint32_t message_count;
+    uint32_t register_count;
+    uint32_t padding;
+};
+
+// the key is the 64 bit FNV-1a hash of the source, mixed with anything else that changes the compiled program
+uint64_t cache_key(std::string_view source, int opt_level){
+    uint64_t hash = 14695981039346656037ULL;
+    for (char c : source){
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    hash ^= static_cast<uint64_t>(opt_level) + 1;
+    hash *= 1099511628211ULL;
+    return hash;
+}
+
+// a script's cache lives beside it, with its .neb extension replaced, or with .nebc appended if it has another extension
+std::string cache_path(const std::string& source_path){
+    std::string_view ext = ".neb";
+    if (source_path.size() > ext.size() && source_path.compare(source_path.size() - ext.size(), ext.size(), ext) == 0)
+        return source_path + "c";
+    return source_path + ".nebc";
+}
+
+static void put32(std::string& out, uint32_t val){
+    out.append(reinterpret_cast<const char*>(&val), sizeof(val));
+}
+
+// encodes a program in the cache format, stamped with a key
+std::string encode_program(uint64_t key, const RegProgram& program){
+    CacheHeader header {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.key = key;
+    header.code_count = program.code.size();
+    header.var_count = program.vars.size();
+    header.const_count = program.constants.size();
+    header.message_count = program.messages.size();
+    header.register_count = program.register_count;
+    std::string out(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const RegInstruction& instr : program.code){
+        put32(out, instr.op);
+        put32(out, instr.a);
+        put32(out, instr.b);
+        put32(out, instr.c);
+        put32(out, instr.d);
+    }
+    for (const VarRef& var : program.vars){
+        put32(out, var.depth);
+        put32(out, var.slot);
+        put32(out, var.type);
+    }
+    // constants are stored as their type followed by 8 bytes holding their value
+    for (const Value& constant : program.constants){
+        uint64_t bits = 0;
+        switch (constant.get_type()){
+            case INT: bits = static_cast<uint32_t>(constant.as<int>()); break;
+            case FLOAT: {
+                double float_val = constant.as<double>();
+                std::memcpy(&bits, &float_val, sizeof(float_val));
+                break;
+            }
+            case CHAR: bits = static_cast<unsigned char>(constant.as<char>()); break;
+            case BOOL: bits = constant.as<bool>(); break;
+            default: break;
+        }
+        put32(out, constant.get_type());
+        out.append(reinterpret_cast<const char*>(&bits), sizeof(bits));
+    }
+    for (const std::string& msg : program.messages){
+        put32(out, msg.size());
+        out += msg;
+    }
+    return out;
+}
+
+// writes a program to a cache file, which is written to a temporary file first so a concurrent run never sees it half written
+bool save_program(const std::string& path, uint64_t key, const RegProgram& program){
+    std::string out = encode_program(key, program);
+    std::string tmp_path = path + ".tmp." + std::to_string(getpid());
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!file.write(out.data(), out.size()))
+            return false;
+    }
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0){
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+// reads fields from a cache file, failing rather than reading past its end
+class CacheReader{
+    public:
+        CacheReader(std::string_view data): data(data) {}
+        bool read(void* dst, size_t size){
+            if (this->data.size() - this->pos < size)
+                return false;
+            std::memcpy(dst, this->data.data() + this->pos, size);
+            this->pos += size;
+            return true;
+        }
+        bool read32(uint32_t& val) {return this->read(&val, sizeof(val));}
+        bool at_end() {return this->pos == this->data.size();}
+    private:
+        std::string_view data;
+        size_t pos {0};
+};
+
+// checks that every operand of an instruction refers to something that exists, so a damaged file can't crash the VM
+static bool valid_instruction(const RegInstruction& instr, const RegProgram& program){
+    uint32_t regs = program.register_count, code_size = program.code.size();
+    switch (instr.op){
+        case RegJump:
+            return instr.a < code_size;
+        case RegJumpFalse:
+        case RegJumpTrue:
+            return instr.a < regs && instr.b < code_size;
+        case RegTrap:
+            return instr.a < program.messages.size();
+        case RegNull:
+        case RegCheckBool:
+        case RegPrint:
+        case RegPrintEnd:
+        case RegHalt:
+            return instr.a < regs;
+        case RegMove:
+        case RegStore:
+            return instr.a < regs && instr.b < regs;
+        default:
+            return instr.op < RegHalt && instr.a < regs && instr.b < regs && instr.c < regs;
+    }
+}
+
+/*
+    decodes a program encoded by encode_program, returns false if the data is damaged or has a different key. The program is only
+    modified if it decodes successfully
+*/
+bool decode_program(std::string_view data, uint64_t key, RegProgram& program){
+    CacheReader reader(data);
+    CacheHeader header;
+    if (!reader.read(&header, sizeof(header)) || std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+        return false;
+    if (header.version != VERSION || header.key != key)
+        return false;
+    // every record takes at least 4 bytes, so counts larger than the file must be damaged
+    size_t size = data.size();
+    if (header.code_count > size / 4 || header.var_count > size / 4 || header.const_count > size / 4 || header.message_count > size / 4)
+        return false;
+    RegProgram loaded;
+    loaded.register_count = header.register_count;
+    loaded.code.resize(header.code_count);
+    for (RegInstruction& instr : loaded.code){
+        uint32_t op;
+        if (!reader.read32(op) || !reader.read32(instr.a) || !reader.read32(instr.b) || !reader.read32(instr.c) || !reader.read32(instr.d))
+            return false;
+        if (op > RegHalt)
+            return false;
+        instr.op = static_cast<RegOp>(op);
+    }
+    loaded.vars.resize(header.var_count);
+    for (VarRef& var : loaded.vars){
+        uint32_t type;
+        if (!reader.read32(var.depth) || !reader.read32(var.slot) || !reader.read32(type) || type > NULL_TYPE)
+            return false;
+        // only whole programs are cached, and they can only refer to the global frame
+        if (var.depth != 0)
+            return false;
+        var.type = static_cast<ValueType>(type);
+    }
+    loaded.constants.reserve(header.const_count);
+    for (uint32_t i = 0; i < header.const_count; i++){
+        uint32_t type;
+        uint64_t bits;
+        if (!reader.read32(type) || !reader.read(&bits, sizeof(bits)) || type > NULL_TYPE)
+            return false;
+        Value constant(static_cast<ValueType>(type));
+        switch (constant.get_type()){
+            case INT: constant.update(static_cast<int>(static_cast<uint32_t>(bits))); break;
+            case FLOAT: {
+                double float_val;
+                std::memcpy(&float_val, &bits, sizeof(float_val));
+                constant.update(float_val);
+                break;
+            }
+            case CHAR: constant.update(static_cast<char>(bits)); break;
+            case BOOL: constant.update(bits != 0); break;
+            default: break;
+        }
+        loaded.constants.push_back(constant);
+    }
+    loaded.messages.resize(header.message_count);
+    for (std::string& msg : loaded.messages){
+        uint32_t len;
+        if (!reader.read32(len) || len > size)
+            return false;
+        msg.resize(len);
+        if (!reader.read(msg.data(), len))
+            return false;
+    }
+    if (!reader.at_end() || loaded.code.empty() || loaded.code.back().op != RegHalt)
+        return false;
+    if (loaded.register_count < loaded.vars.size() + loaded.constants.size())
+        return false;
+    for (const RegInstruction& instr : loaded.code){
+        if (!valid_instruction(instr, loaded))
+            return false;
+    }
+    program = std::move(loaded);
+    return true;
+}
+
+// loads a program from a cache file, returns false if the file doesn't exist, is damaged, or was made from different source
+bool load_program(const std::string& path, uint64_t key, RegProgram& program){
+    SourceFile file;
+    return file.open(path) && decode_program(file.view(), key, program);
+}
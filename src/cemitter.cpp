@@ -0,0 +1,286 @@
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+#include "../inc/cemitter.h"
+#include "../inc/lexer.h"
+#include "../inc/regcompiler.h"
+
+/*
+    the helpers every emitted program starts with. Arithmetic helpers take their operands in source order, but compute rhs <op> lhs
+    just as ArithNode::apply does, and integer arithmetic wraps rather than overflowing. Values are printed the way
+    Value::format prints them
+*/
+static const char* PRELUDE = R"(#include <stdio.h>
+#include <stdlib.h>
+
+static void nb_divide_by_zero(void) {fputs("nebula error: cannot divide by zero\n", stderr); exit(1);}
+
+static inline int nb_add_i(int lhs, int rhs) {return (int)((unsigned)rhs + (unsigned)lhs);}
+static inline int nb_sub_i(int lhs, int rhs) {return (int)((unsigned)rhs - (unsigned)lhs);}
+static inline int nb_mul_i(int lhs, int rhs) {return (int)((unsigned)rhs * (unsigned)lhs);}
+static inline int nb_div_i(int lhs, int rhs) {if (!lhs) nb_divide_by_zero(); return rhs / lhs;}
+static inline int nb_mod_i(int lhs, int rhs) {if (!lhs) nb_divide_by_zero(); return rhs % lhs;}
+static inline int nb_pow_i(int lhs, int rhs) {double ret = 1; for (int i = 0; i < rhs; i++) ret *= lhs; return (int)ret;}
+static inline double nb_add_f(double lhs, double rhs) {return rhs + lhs;}
+static inline double nb_sub_f(double lhs, double rhs) {return rhs - lhs;}
+static inline double nb_mul_f(double lhs, double rhs) {return rhs * lhs;}
+static inline double nb_div_f(double lhs, double rhs) {return rhs / lhs;}
+static inline double nb_pow_f(double lhs, double rhs) {double ret = 1; for (int i = 0; i < rhs; i++) ret *= lhs; return ret;}
+static inline void nb_print_i(int val) {printf("%d", val);}
+static inline void nb_print_f(double val) {printf("%g", val);}
+static inline void nb_print_c(char val) {putchar(val);}
+static inline void nb_print_b(int val) {fputs(val ? "true" : "false", stdout);}
+)";
+
+static const char* c_type(ValueType type){
+    switch (type){
+        case FLOAT:
+            return "double";
+        case CHAR:
+            return "char";
+        default:
+            return "int";
+    }
+}
+
+// the suffix of the helpers for a type
+static const char* type_suffix(ValueType type){
+    switch (type){
+        case INT:
+            return "i";
+        case FLOAT:
+            return "f";
+        case CHAR:
+            return "c";
+        default:
+            return "b";
+    }
+}
+
+// writes the translation unit for a list of top-level statements to out, throwing if any of them can't be translated
+void CEmitter::emit(const std::deque<Node*>& statements, std::ostream& out){
+    this->body.str("");
+    this->vars.clear();
+    this->temps.clear();
+    for (Node* statement : statements)
+        this->emit_statement(statement, 1);
+    out << "/* generated by nebula --emit-c */\n" << PRELUDE << "\nint main(void){\n";
+    for (auto& [name, type] : this->vars)
+        out << "    " << c_type(type) << " " << name << " = 0;\n";
+    for (size_t i = 0; i < this->temps.size(); i++)
+        out << "    " << c_type(this->temps[i]) << " t" << i << " = 0;\n";
+    out << this->body.str() << "    return 0;\n}\n";
+}
+
+// emits a node whose value is discarded, blocks and prints can only be emitted this way
+void CEmitter::emit_statement(Node* node, int depth){
+    std::string indent(depth * 4, ' ');
+    switch (node->get_node_type()){
+        case Print_N: {
+            PrintNode* print_node = static_cast<PrintNode*>(node);
+            const std::pmr::vector<Node*>& args = print_node->get_args();
+            // arguments are stored in reverse order by the parser
+            for (int i = args.size() - 1; i >= 0; i--){
+                ValueType type = this->type_of(args[i]);
+                if (type == NULL_TYPE)
+                    this->error(args[i], "cannot print a null value");
+                this->body << indent << "nb_print_" << type_suffix(type) << "(" << this->expr(args[i]) << ");\n";
+            }
+            if (print_node->has_newline())
+                this->body << indent << "putchar('\\n');\n";
+            return;
+        }
+        case Block_N:
+            break;
+        case Asgn_N:
+            this->body << indent << this->expr(node) << ";\n";
+            return;
+        // type names, symbols and parameters have no effect
+        case Type_N:
+        case Sym_N:
+        case Param_N:
+            return;
+        default:
+            this->body << indent << "(void)" << this->expr(node) << ";\n";
+            return;
+    }
+    BlockNode* block = static_cast<BlockNode*>(node);
+    switch (block->block_type()){
+        case Eval:
+            this->emit_statement(static_cast<EvalBlockNode*>(block)->get_body(), depth);
+            return;
+        case Conditional: {
+            CondBlockNode* cond = static_cast<CondBlockNode*>(block);
+            if (!cond->is_checked())
+                this->error(cond, "the type of this condition is only known at runtime");
+            this->body << indent << "if (" << this->expr(cond->get_condition()) << "){\n";
+            this->emit_statements(cond, depth + 1);
+            if (cond->get_else()){
+                this->body << indent << "}\n" << indent << "else{\n";
+                this->emit_statements(cond->get_else(), depth + 1);
+            }
+            this->body << indent << "}\n";
+            return;
+        }
+        case Loop: {
+            LoopBlockNode* loop = static_cast<LoopBlockNode*>(block);
+            if (!loop->is_checked())
+                this->error(loop, "the type of this condition is only known at runtime");
+            this->body << indent << "while (" << this->expr(loop->get_condition()) << "){\n";
+            this->emit_statements(loop, depth + 1);
+            this->body << indent << "}\n";
+            return;
+        }
+        default:
+            this->body << indent << "{\n";
+            this->emit_statements(block, depth + 1);
+            this->body << indent << "}\n";
+            return;
+    }
+}
+
+void CEmitter::emit_statements(BlockNode* block, int depth){
+    for (Node* statement : block->get_statements())
+        this->emit_statement(statement, depth);
+}
+
+// returns a C expression that evaluates to the same value as a node
+std::string CEmitter::expr(Node* node){
+    switch (node->get_node_type()){
+        case Literal_N:
+            return this->literal(static_cast<LiteralNode*>(node)->get_value());
+        case Var_N: {
+            VarNode* var = static_cast<VarNode*>(node);
+            if (!var->is_initialized())
+                this->error(node, "cannot evaluate an unitialized variable");
+            return this->var_name(var);
+        }
+        case Asgn_N: {
+            AsgnNode* asgn = static_cast<AsgnNode*>(node);
+            if (asgn->get_lhs()->get_node_type() != Var_N)
+                this->error(node, "pointers cannot be emitted as C");
+            this->require_checked(node);
+            return "(" + this->var_name(static_cast<VarNode*>(asgn->get_lhs())) + " = " + this->expr(asgn->get_rhs()) + ")";
+        }
+        case Comp_N: {
+            CompNode* comp = static_cast<CompNode*>(node);
+            this->require_checked(node);
+            const char* ops[] = {" < ", " > ", " == ", " != "};
+            return this->binary(comp->get_lhs(), comp->get_rhs(), "(", ops[comp->op], ")");
+        }
+        // both operands are always evaluated by the interpreter, so the bitwise operators are used rather than short circuiting
+        case BoolLogic_N: {
+            BoolLogicNode* logic = static_cast<BoolLogicNode*>(node);
+            this->require_checked(node);
+            return this->binary(logic->get_lhs(), logic->get_rhs(), "(", logic->get_op() == LogicAnd ? " & " : " | ", ")");
+        }
+        case Arith_N: {
+            ArithNode* arith = static_cast<ArithNode*>(node);
+            this->require_checked(node);
+            ValueType type = this->type_of(arith->get_lhs());
+            if (arith->get_op() == ArithMod && type == FLOAT)
+                this->error(node, "cannot use the '%' operator on floats");
+            const char* names[] = {"add", "sub", "mul", "div", "mod", "pow"};
+            std::string helper = std::string("nb_") + names[arith->get_op() - ArithAdd] + "_" + type_suffix(type);
+            return this->binary(arith->get_lhs(), arith->get_rhs(), helper + "(", ", ", ")");
+        }
+        case Block_N:
+            if (static_cast<BlockNode*>(node)->block_type() == Eval)
+                return this->expr(static_cast<EvalBlockNode*>(node)->get_body());
+            this->error(node, "blocks can only be emitted as statements");
+        case Print_N:
+            this->error(node, "print can only be emitted as a statement");
+        default:
+            this->error(node, "this expression cannot be emitted as C");
+    }
+}
+
+/*
+    joins the expressions of two operands. C doesn't sequence the operands of most operators, so if either has side effects they
+    are first stored to temporaries with the comma operator, which evaluates them left to right as the interpreter does
+*/
+std::string CEmitter::binary(Node* lhs, Node* rhs, const std::string& open, const std::string& sep, const std::string& close){
+    std::string lhs_expr = this->expr(lhs), rhs_expr = this->expr(rhs);
+    if (!has_side_effects(lhs) && !has_side_effects(rhs))
+        return open + lhs_expr + sep + rhs_expr + close;
+    std::string lhs_temp = this->alloc_temp(this->type_of(lhs)), rhs_temp = this->alloc_temp(this->type_of(rhs));
+    return "(" + lhs_temp + " = " + lhs_expr + ", " + rhs_temp + " = " + rhs_expr + ", " + open + lhs_temp + sep + rhs_temp + close + ")";
+}
+
+// returns the type of an expression, which the type checker must have proven
+ValueType CEmitter::type_of(Node* node){
+    switch (node->get_node_type()){
+        case Literal_N:
+            return static_cast<LiteralNode*>(node)->get_value().get_type();
+        case Var_N:
+            return static_cast<VarNode*>(node)->get_type();
+        case Asgn_N:
+            return static_cast<AsgnNode*>(node)->get_lhs()->get_type();
+        case Comp_N:
+        case BoolLogic_N:
+            return BOOL;
+        // both operands have the same type as the result, '%' only accepts integers
+        case Arith_N:
+            return this->type_of(static_cast<ArithNode*>(node)->get_lhs());
+        case Block_N:
+            if (static_cast<BlockNode*>(node)->block_type() == Eval)
+                return this->type_of(static_cast<EvalBlockNode*>(node)->get_body());
+            this->error(node, "blocks can only be emitted as statements");
+        default:
+            return NULL_TYPE;
+    }
+}
+
+// every slot becomes a local, a slot reused by a variable of another type in a different scope gets a local of its own
+std::string CEmitter::var_name(VarNode* var){
+    std::string name = "v" + std::to_string(var->get_depth()) + "_" + std::to_string(var->get_slot()) + type_suffix(var->get_type());
+    this->vars[name] = var->get_type();
+    return name;
+}
+
+std::string CEmitter::literal(const Value& val){
+    switch (val.get_type()){
+        case INT:
+            // INT_MIN can't be written as a literal, since the minus is applied to a positive constant that doesn't fit in an int
+            if (val.as<int>() == INT_MIN)
+                return "(-2147483647 - 1)";
+            return std::to_string(val.as<int>());
+        case FLOAT: {
+            double float_val = val.as<double>();
+            if (std::isnan(float_val))
+                return "(0.0 / 0.0)";
+            if (std::isinf(float_val))
+                return float_val > 0 ? "(1.0 / 0.0)" : "(-1.0 / 0.0)";
+            // 17 significant digits are enough for the literal to round trip exactly
+            char buffer[32];
+            std::snprintf(buffer, sizeof(buffer), "%.17g", float_val);
+            std::string text = buffer;
+            if (text.find_first_of(".e") == std::string::npos)
+                text += ".0";
+            return "(" + text + ")";
+        }
+        case CHAR:
+            return "((char)" + std::to_string(static_cast<int>(val.as<char>())) + ")";
+        case BOOL:
+            return val.as<bool>() ? "1" : "0";
+        default:
+            throw std::runtime_error("cannot emit a null literal as C");
+    }
+}
+
+std::string CEmitter::alloc_temp(ValueType type){
+    this->temps.push_back(type);
+    return "t" + std::to_string(this->temps.size() - 1);
+}
+
+void CEmitter::require_checked(Node* node){
+    if (!node->is_checked())
+        this->error(node, "the types of this expression are only known at runtime");
+}
+
+void CEmitter::error(Node* node, const std::string& msg){
+    throw std::runtime_error("cannot emit C: " + msg + describe_location(node->get_line(), node->get_col()));
+}
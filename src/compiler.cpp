@@ -0,0 +1,201 @@
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../inc/bytecode.h"
+#include "../inc/compiler.h"
+#include "../inc/nodes.hpp"
+#include "../inc/block.h"
+
+// empties every pool of the chunk
+void Chunk::clear(){
+    this->code.clear();
+    this->constants.clear();
+    this->vars.clear();
+    this->messages.clear();
+}
+
+Compiler::Compiler(Chunk& chunk): chunk(chunk){
+    this->chunk.clear();
+}
+
+// compiles a top-level statement, only the value of the last compiled statement is kept on the stack
+void Compiler::compile_statement(Node* statement){
+    if (this->statement_count)
+        this->emit(OpPop);
+    this->compile(statement);
+    this->statement_count++;
+}
+
+// terminates the chunk, this must be called before the chunk is run
+void Compiler::finish(){
+    if (!this->statement_count)
+        this->emit(OpNull);
+    this->emit(OpHalt);
+}
+
+// compiles a single node, every node leaves exactly one value on the stack
+void Compiler::compile(Node* node){
+    switch (node->get_node_type()){
+        case Literal_N:
+            this->emit(OpConst, this->add_constant(static_cast<LiteralNode*>(node)->get_value()));
+            break;
+        case Var_N: {
+            VarNode* var = static_cast<VarNode*>(node);
+            // a declaration is only ever evaluated on its own before it has been assigned to
+            if (!var->is_initialized())
+                this->emit(OpTrap, this->add_message("cannot evaluate an unitialized variable"));
+            else
+                this->emit(OpLoad, this->add_var({var->get_depth(), var->get_slot(), var->get_type()}));
+            break;
+        }
+        // pointers don't live in the environment, so they can't be addressed by the VM yet
+        case Ptr_N:
+            this->emit(OpTrap, this->add_message("pointers are not supported by the bytecode backend"));
+            break;
+        case Asgn_N: {
+            AsgnNode* asgn = static_cast<AsgnNode*>(node);
+            this->compile(asgn->get_rhs());
+            if (asgn->get_lhs()->get_node_type() != Var_N){
+                this->emit(OpTrap, this->add_message("pointers are not supported by the bytecode backend"));
+                break;
+            }
+            VarNode* var = static_cast<VarNode*>(asgn->get_lhs());
+            this->emit(OpStore, this->add_var({var->get_depth(), var->get_slot(), var->get_type()}));
+            break;
+        }
+        case Comp_N: {
+            CompNode* comp = static_cast<CompNode*>(node);
+            this->compile(comp->get_lhs());
+            this->compile(comp->get_rhs());
+            this->emit(OpComp, comp->op);
+            break;
+        }
+        case BoolLogic_N: {
+            BoolLogicNode* logic = static_cast<BoolLogicNode*>(node);
+            this->compile(logic->get_lhs());
+            this->compile(logic->get_rhs());
+            this->emit(OpLogic, logic->get_op());
+            break;
+        }
+        case Arith_N: {
+            ArithNode* arith = static_cast<ArithNode*>(node);
+            this->compile(arith->get_lhs());
+            this->compile(arith->get_rhs());
+            this->emit(OpArith, arith->get_op());
+            break;
+        }
+        case Print_N:
+            this->compile_print(static_cast<PrintNode*>(node));
+            break;
+        case Block_N: {
+            BlockNode* block = static_cast<BlockNode*>(node);
+            switch (block->block_type()){
+                case Eval:
+                    this->compile(static_cast<EvalBlockNode*>(block)->get_body());
+                    break;
+                case Conditional:
+                    this->compile_cond(static_cast<CondBlockNode*>(block));
+                    break;
+                case Loop:
+                    this->compile_loop(static_cast<LoopBlockNode*>(block));
+                    break;
+                default:
+                    this->compile_block(block);
+                    break;
+            }
+            break;
+        }
+        // type names, symbols and parameters all evaluate to null
+        default:
+            this->emit(OpNull);
+            break;
+    }
+}
+
+// compiles the statements of a block, the block evaluates to the value of its last statement
+void Compiler::compile_block(BlockNode* block){
+    const std::pmr::vector<Node*>& statements = block->get_statements();
+    if (statements.empty()){
+        this->emit(OpNull);
+        return;
+    }
+    for (size_t i = 0; i < statements.size(); i++){
+        if (i)
+            this->emit(OpPop);
+        this->compile(statements[i]);
+    }
+}
+
+// compiles an if block, which evaluates to null if the condition is false and there is no else clause
+void Compiler::compile_cond(CondBlockNode* block){
+    this->compile(block->get_condition());
+    size_t else_jump = this->emit_jump(OpJumpFalse);
+    this->compile_block(block);
+    size_t end_jump = this->emit_jump(OpJump);
+    this->patch_jump(else_jump);
+    if (block->get_else())
+        this->compile_block(block->get_else());
+    else
+        this->emit(OpNull);
+    this->patch_jump(end_jump);
+}
+
+// compiles a while loop, which evaluates to the value of the last iteration, or null if it never ran
+void Compiler::compile_loop(LoopBlockNode* block){
+    this->emit(OpNull);
+    size_t loop_start = this->chunk.code.size();
+    this->compile(block->get_condition());
+    size_t exit_jump = this->emit_jump(OpJumpFalse);
+    this->emit(OpPop);
+    this->compile_block(block);
+    this->emit(OpJump, loop_start);
+    this->patch_jump(exit_jump);
+}
+
+// arguments are stored in reverse order by the parser, each one is printed as soon as it's evaluated
+void Compiler::compile_print(PrintNode* print_node){
+    const std::pmr::vector<Node*>& args = print_node->get_args();
+    for (int i = args.size() - 1; i >= 0; i--){
+        this->compile(args[i]);
+        this->emit(OpPrint);
+    }
+    this->emit(OpPrintEnd, print_node->has_newline());
+}
+
+void Compiler::emit(OpCode op, uint32_t arg){
+    this->chunk.code.push_back({op, arg});
+}
+
+// emits a jump with a placeholder target and returns its position so it can be patched later
+size_t Compiler::emit_jump(OpCode op){
+    this->emit(op, 0);
+    return this->chunk.code.size() - 1;
+}
+
+// sets the target of the jump at the given position to the next instruction to be emitted
+void Compiler::patch_jump(size_t pos){
+    this->chunk.code[pos].arg = this->chunk.code.size();
+}
+
+uint32_t Compiler::add_constant(const Value& val){
+    this->chunk.constants.push_back(val);
+    return this->chunk.constants.size() - 1;
+}
+
+// returns the index of a variable in the chunk, every reference to the same slot and type shares one index
+uint32_t Compiler::add_var(const VarRef& var){
+    uint64_t key = (static_cast<uint64_t>(var.depth) << 40) | (static_cast<uint64_t>(var.type) << 32) | var.slot;
+    auto var_itt = this->var_ids.find(key);
+    if (var_itt != this->var_ids.end())
+        return var_itt->second;
+    this->chunk.vars.push_back(var);
+    uint32_t id = this->chunk.vars.size() - 1;
+    this->var_ids[key] = id;
+    return id;
+}
+
+uint32_t Compiler::add_message(const std::string& msg){
+    this->chunk.messages.push_back(msg);
+    return this->chunk.messages.size() - 1;
+}
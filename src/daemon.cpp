@@ -0,0 +1,353 @@
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../inc/daemon.h"
+#include "../inc/cache.h"
+#include "../inc/interpreter.h"
+#include "../inc/source.h"
+
+/* SOCKET HELPERS */
+// sends the whole buffer, returns false if the connection was lost. Writing to a closed socket must not raise SIGPIPE
+static bool send_all(int fd, const void* data, size_t size){
+    const char* ptr = static_cast<const char*>(data);
+    while (size){
+        ssize_t sent = send(fd, ptr, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0)
+            return false;
+        ptr += sent;
+        size -= sent;
+    }
+    return true;
+}
+// reads exactly size bytes, returns false if the connection was closed first
+static bool recv_all(int fd, void* data, size_t size){
+    char* ptr = static_cast<char*>(data);
+    while (size){
+        ssize_t received = recv(fd, ptr, size, 0);
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received <= 0)
+            return false;
+        ptr += received;
+        size -= received;
+    }
+    return true;
+}
+// strings are sent as their length as a 32-bit integer, followed by their bytes
+static bool send_str(int fd, std::string_view str){
+    uint32_t size = str.size();
+    return send_all(fd, &size, sizeof(size)) && send_all(fd, str.data(), size);
+}
+static bool recv_str(int fd, std::string& str){
+    uint32_t size;
+    if (!recv_all(fd, &size, sizeof(size)))
+        return false;
+    str.resize(size);
+    return recv_all(fd, str.data(), size);
+}
+// fills in the address of a socket path, returns false if the path is too long to be one
+static bool socket_address(const std::string& path, sockaddr_un& addr){
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+        return false;
+    std::memcpy(addr.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+/* DAEMON */
+// sends a reply to a request, failures are ignored since there's nobody left to tell
+static void send_reply(int fd, const DaemonReply& reply){
+    uint8_t header[2] = {static_cast<uint8_t>(reply.status), static_cast<uint8_t>(reply.result_type)};
+    send_all(fd, header, sizeof(header)) && send_str(fd, reply.output) && send_str(fd, reply.result) && send_str(fd, reply.err_msg);
+}
+
+/*
+    makes the socket's path free to bind to. Only a socket left behind by a daemon that has exited is removed, anything else at
+    the path, including the socket of a daemon that's still running, is an error. Returns false on error
+*/
+bool Daemon::claim_path(const sockaddr_un& addr){
+    struct stat info;
+    if (lstat(this->socket_path.c_str(), &info) < 0)
+        return errno == ENOENT;
+    if (!S_ISSOCK(info.st_mode)){
+        this->err_msg = "\"" + this->socket_path + "\" already exists and is not a socket";
+        return false;
+    }
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    bool listening = probe >= 0 && connect(probe, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0;
+    if (probe >= 0)
+        close(probe);
+    if (listening){
+        this->err_msg = "a daemon is already listening on \"" + this->socket_path + "\"";
+        return false;
+    }
+    return unlink(this->socket_path.c_str()) == 0;
+}
+
+// collects the workers that have finished, or waits for every one of them if wait_all is set
+void Daemon::reap_workers(bool wait_all){
+    std::erase_if(this->workers, [wait_all](pid_t pid){
+        return waitpid(pid, nullptr, wait_all ? 0 : WNOHANG) != 0;
+    });
+}
+
+/*
+    listens on the daemon's socket and answers requests until one asks it to shut down. Returns false if the socket couldn't be
+    set up. A request is read by the daemon itself, which looks up its program or has a child compile it, but the script is run
+    by a worker forked for the request, which replies to the client and exits. A script that crashes only takes its worker down, and a slow script doesn't
+    hold up anyone else's. Clients have RECEIVE_TIMEOUT_MS to send their request before they're dropped
+*/
+bool Daemon::serve(){
+    sockaddr_un addr;
+    if (!socket_address(this->socket_path, addr)){
+        this->err_msg = "socket path is too long: \"" + this->socket_path + "\"";
+        return false;
+    }
+    if (!this->claim_path(addr)){
+        if (this->err_msg.empty())
+            this->err_msg = "failed to remove the old socket at \"" + this->socket_path + "\": " + std::strerror(errno);
+        return false;
+    }
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0){
+        this->err_msg = std::string("failed to create socket: ") + std::strerror(errno);
+        return false;
+    }
+    if (bind(server, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(server, 16) < 0){
+        this->err_msg = "failed to listen on \"" + this->socket_path + "\": " + std::strerror(errno);
+        close(server);
+        return false;
+    }
+    timeval timeout {RECEIVE_TIMEOUT_MS / 1000, (RECEIVE_TIMEOUT_MS % 1000) * 1000};
+    bool running = true;
+    while (running){
+        int client = accept(server, nullptr, nullptr);
+        if (client < 0){
+            if (errno == EINTR)
+                continue;
+            this->err_msg = std::string("failed to accept a connection: ") + std::strerror(errno);
+            break;
+        }
+        this->reap_workers(false);
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        // a client that disconnects or stalls part way through a request is simply dropped
+        uint8_t kind;
+        std::string payload;
+        if (!recv_all(client, &kind, sizeof(kind)) || !recv_str(client, payload)){
+            close(client);
+            continue;
+        }
+        DaemonReply reply;
+        const RegProgram* program = nullptr;
+        if (kind == Shutdown){
+            reply.status = 0;
+            running = false;
+        }
+        else
+            program = this->prepare(static_cast<RequestKind>(kind), payload, reply);
+        if (program){
+            pid_t pid = fork();
+            if (pid == 0){
+                close(server);
+                // the worker may take as long as it likes to send a large output to a slow client, it only holds itself up
+                timeval no_timeout {0, 0};
+                setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &no_timeout, sizeof(no_timeout));
+                send_reply(client, this->run(*program));
+                _exit(0);
+            }
+            if (pid > 0){
+                this->workers.push_back(pid);
+                close(client);
+                continue;
+            }
+            reply.err_msg = std::string("failed to start a worker: ") + std::strerror(errno);
+        }
+        send_reply(client, reply);
+        close(client);
+    }
+    close(server);
+    unlink(this->socket_path.c_str());
+    this->reap_workers(true);
+    return !running;
+}
+
+/*
+    finds the program for a request, compiling its script only if it isn't already cached. Returns nullptr if there's nothing
+    to run, in which case the reply holds the error
+*/
+const RegProgram* Daemon::prepare(RequestKind kind, const std::string& payload, DaemonReply& reply){
+    SourceFile file;
+    std::string_view source = payload;
+    if (kind == RunPath){
+        if (!file.open(payload)){
+            reply.err_msg = "failed to read source file: \"" + payload + "\"";
+            return nullptr;
+        }
+        source = file.view();
+    }
+    else if (kind != RunSource){
+        reply.err_msg = "unrecognized request";
+        return nullptr;
+    }
+    // compiling declares the script's globals, so it's done on an interpreter of its own
+    Interpreter compiler;
+    uint64_t key = cache_key(source, compiler.get_opt_level());
+    auto program = this->programs.find(key);
+    if (program == this->programs.end()){
+        RegProgram compiled;
+        if (!this->compile(compiler, source, key, compiled, reply))
+            return nullptr;
+        if (this->programs.size() >= MAX_PROGRAMS)
+            this->programs.clear();
+        program = this->programs.emplace(key, std::move(compiled)).first;
+    }
+    return &program->second;
+}
+
+/*
+    compiles a script in a child process, which sends the program back encoded as it would be cached, so a script that crashes
+    the compiler, like one nested deeply enough to overflow the stack, can't take the daemon down with it. A compiler that hasn't
+    finished within COMPILE_TIMEOUT_MS is killed, since every other client is waiting on it. Returns false if the script didn't
+    compile, in which case the reply holds the error
+*/
+bool Daemon::compile(Interpreter& compiler, std::string_view source, uint64_t key, RegProgram& program, DaemonReply& reply){
+    int channel[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, channel) < 0){
+        reply.err_msg = std::string("failed to start the compiler: ") + std::strerror(errno);
+        return false;
+    }
+    pid_t pid = fork();
+    if (pid == 0){
+        close(channel[0]);
+        RegProgram compiled;
+        uint8_t ok = !compiler.compile(source, compiled);
+        send_all(channel[1], &ok, sizeof(ok)) && send_str(channel[1], ok ? encode_program(key, compiled) : compiler.get_err());
+        _exit(0);
+    }
+    close(channel[1]);
+    if (pid < 0){
+        close(channel[0]);
+        reply.err_msg = std::string("failed to start the compiler: ") + std::strerror(errno);
+        return false;
+    }
+    timeval timeout {COMPILE_TIMEOUT_MS / 1000, (COMPILE_TIMEOUT_MS % 1000) * 1000};
+    setsockopt(channel[0], SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    uint8_t ok;
+    std::string data;
+    // a compiler that exits closes the channel, so only a receive that times out leaves errno set to EAGAIN
+    errno = 0;
+    bool received = recv_all(channel[0], &ok, sizeof(ok)) && recv_str(channel[0], data);
+    bool timed_out = !received && (errno == EAGAIN || errno == EWOULDBLOCK);
+    close(channel[0]);
+    if (timed_out)
+        kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+    if (timed_out)
+        reply.err_msg = "the script took too long to compile";
+    else if (!received)
+        reply.err_msg = "the compiler crashed while compiling the script";
+    else if (!ok)
+        reply.err_msg = data;
+    else if (!decode_program(data, key, program))
+        reply.err_msg = "the compiler sent back a damaged program";
+    else
+        return true;
+    return false;
+}
+
+// runs a compiled program on a fresh interpreter, this is what a worker does
+DaemonReply Daemon::run(const RegProgram& program){
+    DaemonReply reply;
+    Interpreter interpreter;
+    std::ostringstream out;
+    interpreter.set_output(out);
+    reply.status = interpreter.run_program(program);
+    reply.output = out.str();
+    if (reply.status){
+        reply.err_msg = interpreter.get_err();
+        return reply;
+    }
+    Value result = interpreter.result();
+    char buffer[Value::MAX_FORMATTED];
+    reply.result_type = result.get_type();
+    reply.result.assign(buffer, result.format(buffer));
+    return reply;
+}
+
+/* CLIENT */
+/*
+    sends a request to the daemon listening on a socket and waits for its reply. Returns false if the daemon couldn't be reached,
+    a daemon that was reached but didn't reply, because the worker running the script crashed, is reported as an error reply
+*/
+bool send_request(const std::string& socket_path, RequestKind kind, std::string_view payload, DaemonReply& reply){
+    sockaddr_un addr;
+    if (!socket_address(socket_path, addr))
+        return false;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return false;
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0){
+        close(fd);
+        return false;
+    }
+    uint8_t kind_byte = kind;
+    uint8_t header[2];
+    DaemonReply received;
+    bool ok = send_all(fd, &kind_byte, sizeof(kind_byte)) && send_str(fd, payload) && recv_all(fd, header, sizeof(header))
+              && recv_str(fd, received.output) && recv_str(fd, received.result) && recv_str(fd, received.err_msg);
+    close(fd);
+    if (ok){
+        received.status = header[0];
+        received.result_type = static_cast<ValueType>(header[1]);
+    }
+    else
+        received.err_msg = "the daemon didn't reply, the script may have crashed its worker";
+    reply = std::move(received);
+    return true;
+}
+
+/*
+    runs a script on the daemon and prints what it printed, just as if it had been run locally, followed by its result if
+    show_result is set. A path of "-" sends the source read from stdin, any other path is sent as an absolute path for the daemon
+    to read. Returns the exit code for nebula
+*/
+int run_client(const std::string& socket_path, const std::string& file_path, bool show_result){
+    DaemonReply reply;
+    bool sent;
+    if (file_path == "-"){
+        std::string source(std::istreambuf_iterator<char>(std::cin), {});
+        sent = send_request(socket_path, RunSource, source, reply);
+    }
+    else
+        sent = send_request(socket_path, RunPath, std::filesystem::absolute(file_path).string(), reply);
+    if (!sent){
+        std::cerr << "error: failed to reach the daemon at \"" << socket_path << "\"" << std::endl;
+        return 1;
+    }
+    std::cout.write(reply.output.data(), reply.output.size());
+    std::cout.flush();
+    if (reply.status){
+        Interpreter::display_err(reply.err_msg);
+        return 1;
+    }
+    if (show_result && reply.result_type != NULL_TYPE)
+        std::cout << reply.result << std::endl;
+    return 0;
+}
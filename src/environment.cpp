@@ -0,0 +1,26 @@
+#include <stdexcept>
+#include <vector>
+
+#include "../inc/values.hpp"
+#include "../inc/environment.h"
+
+// ensures the current frame has room for at least the given number of slots
+void Environment::reserve(size_t frame_size){
+    size_t required = this->bases.back() + frame_size;
+    if (this->slots.size() < required)
+        this->slots.resize(required);
+}
+
+// creates a new frame on top of the current one
+void Environment::push_frame(size_t frame_size){
+    this->bases.push_back(this->slots.size());
+    this->slots.resize(this->slots.size() + frame_size);
+}
+
+// destroys the current frame and all of its values
+void Environment::pop_frame(){
+    if (this->bases.size() == 1)
+        throw std::runtime_error("cannot pop the global frame");
+    this->slots.resize(this->bases.back());
+    this->bases.pop_back();
+}
@@ -0,0 +1,268 @@
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "../inc/flatast.h"
+#include "../inc/nodes.hpp"
+#include "../inc/block.h"
+
+void FlatTree::clear(){
+    this->nodes.clear();
+    this->lists.clear();
+    this->constants.clear();
+    this->statements.clear();
+}
+// the number of bytes the tree's arrays have reserved
+size_t FlatTree::memory_used(){
+    return this->nodes.capacity() * sizeof(FlatNode) + this->lists.capacity() * sizeof(uint32_t)
+         + this->constants.capacity() * sizeof(Value) + this->statements.capacity() * sizeof(uint32_t);
+}
+
+// flattens a top-level statement onto the end of the tree
+void Flattener::add_statement(Node* statement){
+    uint32_t index = this->flatten(statement);
+    this->tree.statements.push_back(index);
+}
+
+uint32_t Flattener::add(const FlatNode& node){
+    this->tree.nodes.push_back(node);
+    return this->tree.nodes.size() - 1;
+}
+
+// flattens a node after all of its children, and returns its index
+uint32_t Flattener::flatten(Node* node){
+    FlatNode flat {FlatNull};
+    flat.checked = node->is_checked();
+    switch (node->get_node_type()){
+        case Literal_N:
+            flat.kind = FlatLiteral;
+            flat.a = this->tree.constants.size();
+            this->tree.constants.push_back(static_cast<LiteralNode*>(node)->get_value());
+            break;
+        case Var_N: {
+            VarNode* var = static_cast<VarNode*>(node);
+            // a declaration is only ever evaluated on its own before it has been assigned to
+            flat.kind = var->is_initialized() ? FlatVar : FlatDecl;
+            flat.a = var->get_slot();
+            flat.b = var->get_depth();
+            break;
+        }
+        case Ptr_N:
+            throw std::runtime_error("pointers are not supported by the flat tree walker");
+        case Asgn_N: {
+            AsgnNode* asgn = static_cast<AsgnNode*>(node);
+            if (asgn->get_lhs()->get_node_type() != Var_N)
+                throw std::runtime_error("pointers are not supported by the flat tree walker");
+            VarNode* var = static_cast<VarNode*>(asgn->get_lhs());
+            flat.kind = FlatAsgn;
+            flat.type = var->get_type();
+            flat.a = var->get_slot();
+            flat.b = var->get_depth();
+            flat.c = this->flatten(asgn->get_rhs());
+            break;
+        }
+        case Comp_N: {
+            CompNode* comp = static_cast<CompNode*>(node);
+            flat.kind = FlatComp;
+            flat.op = comp->op;
+            flat.a = this->flatten(comp->get_lhs());
+            flat.b = this->flatten(comp->get_rhs());
+            break;
+        }
+        case BoolLogic_N: {
+            BoolLogicNode* logic = static_cast<BoolLogicNode*>(node);
+            flat.kind = FlatLogic;
+            flat.op = logic->get_op();
+            flat.a = this->flatten(logic->get_lhs());
+            flat.b = this->flatten(logic->get_rhs());
+            break;
+        }
+        case Arith_N: {
+            ArithNode* arith = static_cast<ArithNode*>(node);
+            flat.kind = FlatArith;
+            flat.op = arith->get_op();
+            flat.a = this->flatten(arith->get_lhs());
+            flat.b = this->flatten(arith->get_rhs());
+            break;
+        }
+        case Print_N: {
+            PrintNode* print = static_cast<PrintNode*>(node);
+            flat.kind = FlatPrint;
+            flat.op = print->has_newline();
+            // the parser stores arguments last to first
+            flat.a = this->flatten_list(print->get_args(), true);
+            flat.b = print->get_args().size();
+            break;
+        }
+        case Block_N:
+            return this->flatten_block(static_cast<BlockNode*>(node));
+        default:
+            break;
+    }
+    return this->add(flat);
+}
+
+/*
+    flattens every node in a list, then copies their indices into the tree's lists so they're contiguous, and returns where they
+    start. The indices can't be written as the nodes are flattened since a node's children may have lists of their own
+*/
+uint32_t Flattener::flatten_list(const std::pmr::vector<Node*>& nodes, bool reversed){
+    std::vector<uint32_t> indices;
+    indices.reserve(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++)
+        indices.push_back(this->flatten(nodes[reversed ? nodes.size() - 1 - i : i]));
+    uint32_t start = this->tree.lists.size();
+    this->tree.lists.insert(this->tree.lists.end(), indices.begin(), indices.end());
+    return start;
+}
+
+uint32_t Flattener::flatten_block(BlockNode* block){
+    FlatNode flat {FlatBlock};
+    flat.checked = block->is_checked();
+    switch (block->block_type()){
+        // an eval block is just its body
+        case Eval:
+            return this->flatten(static_cast<EvalBlockNode*>(block)->get_body());
+        case Conditional: {
+            CondBlockNode* cond = static_cast<CondBlockNode*>(block);
+            flat.kind = FlatCond;
+            flat.a = this->flatten(cond->get_condition());
+            FlatNode body {FlatBlock};
+            body.a = this->flatten_list(cond->get_statements());
+            body.b = cond->get_statements().size();
+            flat.b = this->add(body);
+            flat.c = cond->get_else() ? this->flatten(cond->get_else()) : FlatTree::NONE;
+            break;
+        }
+        case Loop: {
+            LoopBlockNode* loop = static_cast<LoopBlockNode*>(block);
+            flat.kind = FlatLoop;
+            flat.a = this->flatten(loop->get_condition());
+            flat.b = this->flatten_list(loop->get_statements());
+            flat.c = loop->get_statements().size();
+            break;
+        }
+        default:
+            flat.a = this->flatten_list(block->get_statements());
+            flat.b = block->get_statements().size();
+            break;
+    }
+    return this->add(flat);
+}
+
+// evaluates every top-level statement of a tree, and returns the value of the last one
+Value FlatWalker::run(const FlatTree& tree, Environment& env){
+    this->nodes = tree.nodes.data();
+    this->lists = tree.lists.data();
+    this->constants = tree.constants.data();
+    this->env = &env;
+    Value last(NULL_TYPE);
+    for (uint32_t statement : tree.statements)
+        last = this->eval(statement);
+    return last;
+}
+
+// evaluates the nodes in a run of the tree's lists, returning the value of the last one, or null if there are none
+Value FlatWalker::eval_list(uint32_t start, uint32_t count){
+    Value last(NULL_TYPE);
+    for (uint32_t i = start; i < start + count; i++)
+        last = this->eval(this->lists[i]);
+    return last;
+}
+
+// variables and literals are the most common operands, so they're read here rather than through another call to eval
+inline Value FlatWalker::operand(uint32_t index){
+    const FlatNode& node = this->nodes[index];
+    if (node.kind == FlatVar)
+        return this->env->at(node.b, node.a);
+    if (node.kind == FlatLiteral)
+        return this->constants[node.a];
+    return this->eval(index);
+}
+
+Value FlatWalker::eval(uint32_t index){
+    const FlatNode& node = this->nodes[index];
+    switch (node.kind){
+        case FlatLiteral:
+            return this->constants[node.a];
+        case FlatVar:
+            return this->env->at(node.b, node.a);
+        case FlatDecl:
+            throw std::runtime_error("cannot evaluate an unitialized variable");
+        case FlatAsgn: {
+            Value rhs_val = this->operand(node.c);
+            if (!node.checked && rhs_val.get_type() != node.type)
+                throw std::runtime_error("cannot assign a variable to a value of a different type");
+            this->env->at(node.b, node.a) = rhs_val;
+            return rhs_val;
+        }
+        case FlatComp: {
+            Value lhs_val = this->operand(node.a);
+            Value rhs_val = this->operand(node.b);
+            if (lhs_val.get_type() == INT && rhs_val.get_type() == INT)
+                return Value::create(BOOL, CompNode::compare(static_cast<Operator>(node.op), lhs_val.as<int>(), rhs_val.as<int>(), true));
+            if (node.checked)
+                return CompNode::compute(static_cast<Operator>(node.op), lhs_val, rhs_val);
+            return CompNode::apply(static_cast<Operator>(node.op), lhs_val, rhs_val);
+        }
+        case FlatLogic: {
+            Value lhs_val = this->operand(node.a);
+            Value rhs_val = this->operand(node.b);
+            if (node.checked)
+                return BoolLogicNode::compute(static_cast<Operator>(node.op), lhs_val, rhs_val);
+            return BoolLogicNode::apply(static_cast<Operator>(node.op), lhs_val, rhs_val);
+        }
+        case FlatArith: {
+            Value lhs_val = this->operand(node.a);
+            Value rhs_val = this->operand(node.b);
+            // integer operands are the common case, so they skip the round trip through double that calculate makes
+            if (lhs_val.get_type() == INT && rhs_val.get_type() == INT){
+                int lhs_int = lhs_val.as<int>(), rhs_int = rhs_val.as<int>();
+                if ((node.op == ArithDiv || node.op == ArithMod) && lhs_int == 0)
+                    throw std::runtime_error("cannot divide by zero");
+                switch (node.op){
+                    case ArithAdd: return Value::create(INT, rhs_int + lhs_int);
+                    case ArithSub: return Value::create(INT, rhs_int - lhs_int);
+                    case ArithMul: return Value::create(INT, rhs_int * lhs_int);
+                    case ArithDiv: return Value::create(INT, rhs_int / lhs_int);
+                    case ArithMod: return Value::create(INT, rhs_int % lhs_int);
+                }
+            }
+            if (node.checked)
+                return ArithNode::compute(static_cast<Operator>(node.op), lhs_val, rhs_val);
+            return ArithNode::apply(static_cast<Operator>(node.op), lhs_val, rhs_val);
+        }
+        case FlatPrint:
+            for (uint32_t i = node.a; i < node.a + node.b; i++)
+                this->output->write(this->eval(this->lists[i]));
+            this->output->end_print(node.op);
+            return Value(NULL_TYPE);
+        case FlatBlock:
+            return this->eval_list(node.a, node.b);
+        case FlatCond: {
+            Value cond_val = this->eval(node.a);
+            if (!node.checked && cond_val.get_type() != BOOL)
+                throw std::runtime_error("invalid conditional");
+            if (cond_val.as<bool>())
+                return this->eval(node.b);
+            if (node.c != FlatTree::NONE)
+                return this->eval(node.c);
+            // the conditional evaluates to null when neither branch runs
+            return Value(NULL_TYPE);
+        }
+        case FlatLoop: {
+            Value last(NULL_TYPE);
+            while (true){
+                Value cond_val = this->operand(node.a);
+                if (!node.checked && cond_val.get_type() != BOOL)
+                    throw std::runtime_error("invalid conditional");
+                if (!cond_val.as<bool>())
+                    break;
+                last = this->eval_list(node.b, node.c);
+            }
+            return last;
+        }
+        default:
+            return Value(NULL_TYPE);
+    }
+}
@@ -1,22 +1,42 @@
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
-#include <fstream>
 
 #include "../inc/interpreter.h"
+#include "../inc/cache.h"
+#include "../inc/cemitter.h"
+#include "../inc/flatast.h"
+#include "../inc/compiler.h"
+#include "../inc/vm.h"
+#include "../inc/regcompiler.h"
+#include "../inc/regvm.h"
 #include "../inc/lexer.h"
+#include "../inc/source.h"
+#include "../inc/typechecker.h"
+#include "../inc/optimizer.h"
 #include "../inc/parser.h"
 #include "../inc/nodes.hpp"
 #include "../inc/block.h"
 
+// every backend prints through the interpreter's output buffer
+Interpreter::Interpreter(){
+    this->parser.set_output(&this->output);
+    this->vm.set_output(&this->output);
+    this->reg_vm.set_output(&this->output);
+    this->flat_walker.set_output(&this->output);
+}
 // this displays the last thrown erro message
 void Interpreter::display_err(){
-    std::cerr << "\033[31mnebula error: \033[0m"  << this->err_msg << std::endl;
+    display_err(this->err_msg);
+}
+void Interpreter::display_err(const std::string& err_msg){
+    std::cerr << "\033[31mnebula error: \033[0m"  << err_msg << std::endl;
 }
 // tokenizes a string and updates the interpreter's tokens, returns 0 on success and 1 on failure
-int Interpreter::set_tokens(const std::string& expr){
+int Interpreter::set_tokens(std::string_view expr){
     this->tokens.clear();
     try{
-        tokenize(expr, this->tokens);
+        tokenize_parallel(expr, this->tokens);
         return 0;
     }
     catch (std::runtime_error e){
@@ -24,36 +44,109 @@ int Interpreter::set_tokens(const std::string& expr){
         return 1;
     }
 }
-// returns the top value on the eval stack, or an empty value if nothing's on the stack
+// returns the value of the last statement that was evaluated, or an empty value if nothing was
 Value Interpreter::result(){
-    if (this->eval_stack.empty())
-        return Value(NULL_TYPE);
-    return this->eval_stack.top();
+    return this->last_result;
 }
-// reads source code from a provided file and evaluates it, returns 0 for succss and 1 for failure
+/*
+    reads source code from a provided file and evaluates it, returns 0 for succss and 1 for failure. On the register VM with the
+    cache turned on, the compiled program is cached beside the file, and is loaded instead of parsing the file again for as long
+    as it is unchanged
+*/
 int Interpreter::run_file(const std::string& file_path){
-    std::ifstream in(file_path);
-    if (!in.good()){
+    SourceFile source;
+    if (!source.open(file_path)){
         this->err_msg = "failed to read source file: \""+file_path +"\"";
         return 1;
     }
-    std::string tmp, src_code;
-    while (std::getline(in, tmp))
-        src_code += tmp + '\n';
-    in.close();
-    return this->run(src_code);
+    // a cached program assumes its globals start at the first slot, so it can only run on an interpreter that has none yet
+    if (!this->use_cache || this->backend != RegisterVM || this->parser.global_frame_size() != 0)
+        return this->run(source.view());
+    this->last_result = Value(NULL_TYPE);
+    std::string cache_file = cache_path(file_path);
+    uint64_t key = cache_key(source.view(), this->opt_level);
+    if (load_program(cache_file, key, this->reg_program))
+        this->reserve_globals();
+    else{
+        if (this->prepare(source.view()) || this->compile_registers())
+            return 1;
+        // failing to write the cache only means the next run has to parse the file again
+        save_program(cache_file, key, this->reg_program);
+    }
+    int status = this->exec_registers();
+    this->output.flush();
+    return status;
+}
+// runs the given expression/source code, returns 1 on error. Tokens refer to the source, so it must outlive the run
+int Interpreter::run(std::string_view statements){
+    // forget the result of the last run
+    this->last_result = Value(NULL_TYPE);
+    // only the tree walker can run blocks that haven't been parsed, the compilers need every block up front
+    bool tree = this->backend == TreeWalker || this->backend == Tiered;
+    if (this->prepare(statements, this->lazy && tree))
+        return 1;
+    int status;
+    if (tree)
+        status = this->eval_tree();
+    else if (this->backend == StackVM)
+        status = this->eval_bytecode();
+    else if (this->backend == FlatTreeWalker)
+        status = this->eval_flat();
+    else
+        status = this->eval_registers();
+    // whatever the program printed is written out before returning, so it comes before any error message
+    this->output.flush();
+    return status;
+}
+/*
+    compiles source code for the register VM without running it, so the program can be run many times by run_program. The
+    program's globals are declared on this interpreter, so it can't run compiled programs itself afterwards. Returns 1 on error
+*/
+int Interpreter::compile(std::string_view statements, RegProgram& program){
+    if (this->prepare(statements) || this->compile_registers())
+        return 1;
+    program = this->reg_program;
+    return 0;
+}
+// runs a program from compile on the register VM, whatever backend is selected. Returns 1 on error
+int Interpreter::run_program(const RegProgram& program){
+    this->last_result = Value(NULL_TYPE);
+    // just like a cached program, it assumes its globals start at the first slot
+    if (this->parser.global_frame_size() != 0){
+        this->err_msg = "a compiled program can only be run by an interpreter without any globals";
+        return 1;
+    }
+    this->reg_program = program;
+    this->reserve_globals();
+    int status = this->exec_registers();
+    this->output.flush();
+    return status;
+}
+// translates source code to a standalone C program written to out, rather than running it. Returns 1 on error
+int Interpreter::emit_c(std::string_view statements, std::ostream& out){
+    if (this->prepare(statements))
+        return 1;
+    try{
+        CEmitter().emit(this->parser.get_statements(), out);
+    }
+    catch (std::runtime_error e){
+        this->err_msg = e.what();
+        return 1;
+    }
+    return 0;
 }
-// runs the given expression/source code, returns 1 on error
-int Interpreter::run(const std::string& statements){
-    // empty the eval stack, if it isn't already
-    while (!this->eval_stack.empty())
-        this->eval_stack.pop();
+/*
+    tokenizes, parses, type checks and optimizes source code, leaving its statements in the parser. If lazy is set, the bodies
+    of blocks are left to be parsed when they're first evaluated. Returns 1 on error
+*/
+int Interpreter::prepare(std::string_view statements, bool lazy){
     // toenize the expression
     int res = this->set_tokens(statements);
     if (res == 1)
         return 1;
     // parse the tokens into expression
-    this->parser.reset(this->tokens);
+    this->parser.reset(std::move(this->tokens));
+    this->parser.set_lazy(lazy);
     try{
         this->parser.parse();
     }
@@ -64,16 +157,91 @@ int Interpreter::run(const std::string& statements){
     // ensure the expression was parsed correctly
     if (!this->parser.validate(this->err_msg))
         return 1;
-    // evaluate each expression
+    if (this->check_types())
+        return 1;
+    if (this->opt_level > 0){
+        Optimizer optimizer(this->parser.get_arena());
+        for (Node*& statement : this->parser.get_statements())
+            statement = optimizer.optimize(statement);
+    }
+    return 0;
+}
+/*
+    runs source code read from a stream, evaluating each top-level statement as soon as it has been parsed and then freeing
+    it, so memory is bounded by the largest statement rather than the size of the source. Returns 1 on error
+*/
+int Interpreter::run_stream(std::istream& in){
+    this->last_result = Value(NULL_TYPE);
+    TokenStream stream(in);
+    this->parser.reset(&stream);
+    this->parser.set_lazy(this->lazy && (this->backend == TreeWalker || this->backend == Tiered));
+    int status = 0;
+    try{
+        while (Node* expr = this->parser.parse_next()){
+            this->checker.check(expr);
+            if (this->opt_level > 0)
+                expr = Optimizer(this->parser.get_arena()).optimize(expr);
+            this->last_result = this->eval_statement(expr);
+            this->parser.release();
+            // a streamed program may be interactive, so its output is written as each statement finishes
+            if (this->output.get_policy() != FlushExit)
+                this->output.flush();
+        }
+        if (!this->parser.validate(this->err_msg))
+            status = 1;
+    }
+    catch (std::runtime_error e){
+        this->err_msg = e.what();
+        status = 1;
+    }
+    this->output.flush();
+    // the stream doesn't outlive this call, so the parser must not keep referring to it
+    this->parser.reset(std::vector<Token>());
+    return status;
+}
+// evaluates a single statement with the current backend
+Value Interpreter::eval_statement(Node* statement){
+    if (this->backend == TreeWalker || this->backend == Tiered){
+        ProfilerScope scope(this->profiler);
+        return Node::eval_child(statement);
+    }
+    if (this->backend == RegisterVM){
+        RegCompiler compiler(this->reg_program);
+        compiler.add_statement(statement);
+        compiler.finish();
+        return this->reg_vm.run(this->reg_program, this->parser.get_environment());
+    }
+    if (this->backend == FlatTreeWalker){
+        Flattener(this->flat_tree).add_statement(statement);
+        return this->flat_walker.run(this->flat_tree, this->parser.get_environment());
+    }
+    Compiler compiler(this->chunk);
+    compiler.compile_statement(statement);
+    compiler.finish();
+    return this->vm.run(this->chunk, this->parser.get_environment());
+}
+// type checks every parsed statement before any of them are evaluated, returns 1 on error
+int Interpreter::check_types(){
+    try{
+        for (Node* statement : this->parser.get_statements())
+            this->checker.check(statement);
+    }
+    catch (std::runtime_error e){
+        this->err_msg = e.what();
+        return 1;
+    }
+    return 0;
+}
+// evaluates each parsed expression by walking its AST, returns 1 on error
+int Interpreter::eval_tree(){
     Node* expr;
-    BlockNode* block;
-    Value val;
+    ProfilerScope scope(this->profiler);
     try{
         while (true){
             expr = this->parser.next_expr();
             if (!expr)
                 break;
-            this->eval_stack.push(expr->eval());
+            this->last_result = Node::eval_child(expr);
         }
     } 
     catch (std::runtime_error e){
@@ -82,3 +250,85 @@ int Interpreter::run(const std::string& statements){
     }
     return 0;
 }
+// compiles every parsed expression to bytecode and runs it on the VM, returns 1 on error
+int Interpreter::eval_bytecode(){
+    Node* expr;
+    try{
+        Compiler compiler(this->chunk);
+        while (true){
+            expr = this->parser.next_expr();
+            if (!expr)
+                break;
+            compiler.compile_statement(expr);
+        }
+        compiler.finish();
+        this->last_result = this->vm.run(this->chunk, this->parser.get_environment());
+    }
+    catch (std::runtime_error e){
+        this->err_msg = e.what();
+        return 1;
+    }
+    return 0;
+}
+// compiles every parsed expression for the register VM and runs it, returns 1 on error
+int Interpreter::eval_registers(){
+    if (this->compile_registers())
+        return 1;
+    return this->exec_registers();
+}
+// compiles every parsed expression into the register program, returns 1 on error
+int Interpreter::compile_registers(){
+    Node* expr;
+    try{
+        RegCompiler compiler(this->reg_program);
+        while (true){
+            expr = this->parser.next_expr();
+            if (!expr)
+                break;
+            compiler.add_statement(expr);
+        }
+        compiler.finish();
+    }
+    catch (std::runtime_error e){
+        this->err_msg = e.what();
+        return 1;
+    }
+    return 0;
+}
+// makes room in the environment for the globals of a register program that wasn't compiled by this interpreter
+void Interpreter::reserve_globals(){
+    size_t frame_size = 0;
+    for (const VarRef& var : this->reg_program.vars)
+        frame_size = std::max<size_t>(frame_size, var.slot + 1);
+    this->parser.get_environment().reserve(frame_size);
+}
+// runs the register program, returns 1 on error
+int Interpreter::exec_registers(){
+    try{
+        this->last_result = this->reg_vm.run(this->reg_program, this->parser.get_environment());
+    }
+    catch (std::runtime_error e){
+        this->err_msg = e.what();
+        return 1;
+    }
+    return 0;
+}
+// flattens every parsed expression into a single array of nodes and evaluates that, returns 1 on error
+int Interpreter::eval_flat(){
+    Node* expr;
+    try{
+        Flattener flattener(this->flat_tree);
+        while (true){
+            expr = this->parser.next_expr();
+            if (!expr)
+                break;
+            flattener.add_statement(expr);
+        }
+        this->last_result = this->flat_walker.run(this->flat_tree, this->parser.get_environment());
+    }
+    catch (std::runtime_error e){
+        this->err_msg = e.what();
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,454 @@
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+#include <optional>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "../inc/jit.h"
+#include "../inc/nodes.hpp"
+#include "../inc/block.h"
+#include "../inc/regcompiler.h"
+
+/*
+    the instructions the compiler emits. Every cell is addressed relative to rdi, which holds the cells pointer for the whole
+    loop, while eax, ecx, edx and xmm0 are used as scratch registers. Nothing else is touched, so the code needs no prologue
+*/
+namespace x64{
+    enum Reg: uint8_t {EAX = 0, ECX = 1, EDX = 2};
+    enum XReg: uint8_t {XMM0 = 0};
+    enum Cond: uint8_t {CondEqual = 0x4, CondNotEqual = 0x5, CondAbove = 0x7, CondParity = 0xA, CondNoParity = 0xB, CondLess = 0xC, CondGreater = 0xF};
+
+    void emit32(std::vector<uint8_t>& code, uint32_t val){
+        for (int i = 0; i < 4; i++)
+            code.push_back((val >> (i * 8)) & 0xFF);
+    }
+    // emits the opcode followed by a [rdi + cell * 8] operand
+    void mem_op(std::vector<uint8_t>& code, std::initializer_list<uint8_t> opcode, uint8_t reg, uint32_t cell){
+        code.insert(code.end(), opcode);
+        code.push_back(0x80 | (reg << 3) | 7);
+        emit32(code, cell * 8);
+    }
+    void load(std::vector<uint8_t>& code, Reg reg, uint32_t cell) {mem_op(code, {0x8B}, reg, cell);}
+    void store(std::vector<uint8_t>& code, Reg reg, uint32_t cell) {mem_op(code, {0x89}, reg, cell);}
+    // copies a whole cell, regardless of the type it holds
+    void move(std::vector<uint8_t>& code, uint32_t dst, uint32_t src){
+        mem_op(code, {0x48, 0x8B}, EAX, src);
+        mem_op(code, {0x48, 0x89}, EAX, dst);
+    }
+    void store_imm(std::vector<uint8_t>& code, uint32_t cell, uint32_t val){
+        mem_op(code, {0xC7}, 0, cell);
+        emit32(code, val);
+    }
+    void load_sd(std::vector<uint8_t>& code, XReg reg, uint32_t cell) {mem_op(code, {0xF2, 0x0F, 0x10}, reg, cell);}
+    void store_sd(std::vector<uint8_t>& code, XReg reg, uint32_t cell) {mem_op(code, {0xF2, 0x0F, 0x11}, reg, cell);}
+    // sets the low byte of a register to a condition, then zero extends it if the register is eax
+    void set(std::vector<uint8_t>& code, Cond cond, Reg reg){
+        code.insert(code.end(), {0x0F, static_cast<uint8_t>(0x90 | cond), static_cast<uint8_t>(0xC0 | reg)});
+    }
+    void zero_extend(std::vector<uint8_t>& code) {code.insert(code.end(), {0x0F, 0xB6, 0xC0});}
+    void test(std::vector<uint8_t>& code) {code.insert(code.end(), {0x85, 0xC0});}
+    // jumps are emitted with an empty offset, which is filled in by patch once the target is known
+    size_t jump(std::vector<uint8_t>& code){
+        code.push_back(0xE9);
+        emit32(code, 0);
+        return code.size();
+    }
+    size_t jump_if(std::vector<uint8_t>& code, Cond cond){
+        code.insert(code.end(), {0x0F, static_cast<uint8_t>(0x80 | cond)});
+        emit32(code, 0);
+        return code.size();
+    }
+    void patch(std::vector<uint8_t>& code, size_t jump_end, size_t target){
+        uint32_t offset = static_cast<uint32_t>(target - jump_end);
+        std::memcpy(&code[jump_end - 4], &offset, sizeof(offset));
+    }
+    void ret(std::vector<uint8_t>& code) {code.push_back(0xC3);}
+}
+
+/* Native loop methods */
+/*
+    runs the compiled loop, updating last to the value of its final iteration if it ran at all. Returns false without running
+    anything if a variable the loop uses doesn't hold the type it was compiled for, in which case the loop must be interpreted
+*/
+bool NativeLoop::run(Value& last){
+    for (const JitVar& var : this->vars){
+        Value& val = this->env->at(var.ref.depth, var.ref.slot);
+        if (val.is_array() || val.get_type() != var.ref.type)
+            return false;
+    }
+    for (const JitVar& var : this->vars){
+        Value& val = this->env->at(var.ref.depth, var.ref.slot);
+        uint64_t& cell = this->cells[var.cell];
+        cell = 0;
+        if (var.ref.type == FLOAT){
+            double float_val = val.as<double>();
+            std::memcpy(&cell, &float_val, sizeof(float_val));
+        }
+        else if (var.ref.type == INT)
+            cell = static_cast<uint32_t>(val.as<int>());
+        else
+            cell = val.as<bool>();
+    }
+    this->cells[this->ran_cell] = 0;
+    this->entry(this->cells.data());
+    auto read_cell = [this](uint32_t index, ValueType type){
+        uint64_t cell = this->cells[index];
+        Value val(type);
+        if (type == FLOAT){
+            double float_val;
+            std::memcpy(&float_val, &cell, sizeof(float_val));
+            val.update(float_val);
+        }
+        else if (type == INT)
+            val.update(static_cast<int>(static_cast<uint32_t>(cell)));
+        else
+            val.update(static_cast<uint32_t>(cell) != 0);
+        return val;
+    };
+    for (const JitVar& var : this->vars){
+        if (var.written)
+            this->env->at(var.ref.depth, var.ref.slot) = read_cell(var.cell, var.ref.type);
+    }
+    if (this->cells[this->ran_cell])
+        last = read_cell(this->result_cell, this->result_type);
+    return true;
+}
+
+/* Code heap methods */
+CodeHeap::~CodeHeap(){
+    this->reset();
+}
+NativeLoop* CodeHeap::create_loop(){
+    this->loops.push_back(std::make_unique<NativeLoop>());
+    return this->loops.back().get();
+}
+// copies code into its own executable pages, which are never writable at the same time. Returns nullptr if they can't be mapped
+NativeLoop::Entry CodeHeap::install(const std::vector<uint8_t>& code){
+#ifdef NEBULA_JIT
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t size = (code.size() + page - 1) / page * page;
+    void* region = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED)
+        return nullptr;
+    std::memcpy(region, code.data(), code.size());
+    if (mprotect(region, size, PROT_READ | PROT_EXEC)){
+        munmap(region, size);
+        return nullptr;
+    }
+    this->regions.push_back({region, size});
+    return reinterpret_cast<NativeLoop::Entry>(region);
+#else
+    return nullptr;
+#endif
+}
+// releases every compiled loop, the nodes that refer to them must have been released already
+void CodeHeap::reset(){
+#ifdef NEBULA_JIT
+    for (auto& [region, size] : this->regions)
+        munmap(region, size);
+#endif
+    this->regions.clear();
+    this->loops.clear();
+}
+
+/* JIT compiler methods */
+/*
+    compiles a loop to native code, returning nullptr if it uses anything the compiler doesn't support. The condition is placed
+    after the body, just as the register compiler does, so each iteration only takes a single branch
+*/
+NativeLoop* JitCompiler::compile(LoopBlockNode* loop){
+#ifdef NEBULA_JIT
+    const std::pmr::vector<Node*>& statements = loop->get_statements();
+    if (statements.empty() || this->check(loop->get_condition()) != BOOL)
+        return nullptr;
+    std::optional<ValueType> result_type;
+    for (Node* statement : statements){
+        result_type = this->check(statement);
+        if (!result_type)
+            return nullptr;
+    }
+    this->loop.result_type = *result_type;
+    this->loop.ran_cell = this->next_temp++;
+    uint32_t result_cell = this->next_temp++;
+    uint32_t base = this->next_temp;
+    this->loop.cells.resize(base);
+    // constants never change, so they are written to their cells once, here
+    for (auto& [node, cell] : this->const_cells){
+        const Value& val = static_cast<LiteralNode*>(node)->get_value();
+        if (val.get_type() == FLOAT){
+            double float_val = val.as<double>();
+            std::memcpy(&this->loop.cells[cell], &float_val, sizeof(float_val));
+        }
+        else if (val.get_type() == INT)
+            this->loop.cells[cell] = static_cast<uint32_t>(val.as<int>());
+        else
+            this->loop.cells[cell] = val.as<bool>();
+    }
+    size_t cond_jump = x64::jump(this->code);
+    size_t body_start = this->code.size();
+    for (size_t i = 0; i < statements.size(); i++){
+        this->next_temp = base;
+        Node* statement = statements[i];
+        NodeType node_type = statement->get_node_type();
+        // the value of the last statement must outlive the condition's temporaries, so it's kept in its own cell unless it's a variable
+        if (i == statements.size() - 1 && node_type != Asgn_N && node_type != Var_N && node_type != Literal_N){
+            this->emit_into(statement, result_cell);
+            this->loop.result_cell = result_cell;
+        }
+        else
+            this->loop.result_cell = this->emit(statement);
+    }
+    x64::store_imm(this->code, this->loop.ran_cell, 1);
+    x64::patch(this->code, cond_jump, this->code.size());
+    this->next_temp = base;
+    x64::load(this->code, x64::EAX, this->emit(loop->get_condition()));
+    x64::test(this->code);
+    x64::patch(this->code, x64::jump_if(this->code, x64::CondNotEqual), body_start);
+    x64::ret(this->code);
+    this->loop.cells.resize(std::max<size_t>(this->loop.cells.size(), this->next_temp));
+    this->loop.entry = this->heap.install(this->code);
+    if (!this->loop.entry)
+        return nullptr;
+    NativeLoop* native = this->heap.create_loop();
+    *native = std::move(this->loop);
+    return native;
+#else
+    return nullptr;
+#endif
+}
+
+// whether idiv can divide by a node without trapping, which needs a constant other than 0, or -1 that overflows INT_MIN
+static bool is_safe_divisor(Node* node){
+    if (node->get_node_type() != Literal_N)
+        return false;
+    const Value& val = static_cast<LiteralNode*>(node)->get_value();
+    return val.get_type() == INT && val.as<int>() != 0 && val.as<int>() != -1;
+}
+
+/*
+    finds the type a node evaluates to, allocating cells for its variables and constants along the way. Returns nullopt if the
+    node can't be compiled
+*/
+std::optional<ValueType> JitCompiler::check(Node* node){
+    std::optional<ValueType> type, lhs_type, rhs_type;
+    switch (node->get_node_type()){
+        case Literal_N:
+            type = static_cast<LiteralNode*>(node)->get_value().get_type();
+            if (type != INT && type != FLOAT && type != BOOL)
+                return std::nullopt;
+            this->const_cells[node] = this->next_temp++;
+            break;
+        case Var_N: {
+            VarNode* var = static_cast<VarNode*>(node);
+            type = var->get_type();
+            if (!var->is_initialized() || (type != INT && type != FLOAT && type != BOOL))
+                return std::nullopt;
+            this->var_cell(var, false);
+            break;
+        }
+        case Asgn_N: {
+            AsgnNode* asgn = static_cast<AsgnNode*>(node);
+            if (asgn->get_lhs()->get_node_type() != Var_N)
+                return std::nullopt;
+            type = asgn->get_lhs()->get_type();
+            if ((type != INT && type != FLOAT && type != BOOL) || this->check(asgn->get_rhs()) != type)
+                return std::nullopt;
+            this->var_cell(asgn->get_lhs(), true);
+            break;
+        }
+        case Arith_N: {
+            ArithNode* arith = static_cast<ArithNode*>(node);
+            lhs_type = this->check(arith->get_lhs());
+            rhs_type = this->check(arith->get_rhs());
+            if (!lhs_type || lhs_type != rhs_type)
+                return std::nullopt;
+            type = lhs_type;
+            // integer powers are evaluated as a loop, which isn't worth compiling, and the modulo of floats is an error
+            Operator op = arith->get_op();
+            if (op == ArithPow || (type == FLOAT && op == ArithMod) || type == BOOL)
+                return std::nullopt;
+            // idiv traps on a zero divisor, so integer division is only compiled when the divisor is a constant that can't be zero
+            if (type == INT && (op == ArithDiv || op == ArithMod) && !is_safe_divisor(arith->get_lhs()))
+                return std::nullopt;
+            break;
+        }
+        case Comp_N: {
+            CompNode* comp = static_cast<CompNode*>(node);
+            lhs_type = this->check(comp->get_lhs());
+            rhs_type = this->check(comp->get_rhs());
+            if (!lhs_type || lhs_type != rhs_type || lhs_type == BOOL)
+                return std::nullopt;
+            type = BOOL;
+            break;
+        }
+        case BoolLogic_N: {
+            BoolLogicNode* logic = static_cast<BoolLogicNode*>(node);
+            if (this->check(logic->get_lhs()) != BOOL || this->check(logic->get_rhs()) != BOOL)
+                return std::nullopt;
+            type = BOOL;
+            break;
+        }
+        case Block_N:
+            if (static_cast<BlockNode*>(node)->block_type() != Eval)
+                return std::nullopt;
+            type = this->check(static_cast<EvalBlockNode*>(node)->get_body());
+            if (!type)
+                return std::nullopt;
+            break;
+        default:
+            return std::nullopt;
+    }
+    this->types[node] = *type;
+    return type;
+}
+
+/*
+    emits the code for a node that has been checked, and returns the cell holding its value. Variables and constants are used in
+    place, anything else is written to the target cell if one is given, or a new temporary otherwise
+*/
+uint32_t JitCompiler::emit(Node* node, uint32_t target){
+    using namespace x64;
+    std::vector<uint8_t>& code = this->code;
+    switch (node->get_node_type()){
+        case Literal_N:
+            return this->const_cells[node];
+        case Var_N:
+            return this->var_cell(node, false);
+        case Asgn_N: {
+            AsgnNode* asgn = static_cast<AsgnNode*>(node);
+            uint32_t dst = this->var_cell(asgn->get_lhs(), true);
+            this->emit_into(asgn->get_rhs(), dst);
+            return dst;
+        }
+        case Block_N:
+            return this->emit(static_cast<EvalBlockNode*>(node)->get_body(), target);
+        default:
+            break;
+    }
+    Node* lhs, *rhs;
+    Operator op;
+    if (node->get_node_type() == Arith_N){
+        lhs = static_cast<ArithNode*>(node)->get_lhs();
+        rhs = static_cast<ArithNode*>(node)->get_rhs();
+        op = static_cast<ArithNode*>(node)->get_op();
+    }
+    else if (node->get_node_type() == Comp_N){
+        lhs = static_cast<CompNode*>(node)->get_lhs();
+        rhs = static_cast<CompNode*>(node)->get_rhs();
+        op = static_cast<CompNode*>(node)->op;
+    }
+    else{
+        lhs = static_cast<BoolLogicNode*>(node)->get_lhs();
+        rhs = static_cast<BoolLogicNode*>(node)->get_rhs();
+        op = static_cast<BoolLogicNode*>(node)->get_op();
+    }
+    ValueType type = this->types[lhs];
+    uint32_t base = this->next_temp;
+    uint32_t l = this->emit(lhs);
+    // the left operand is read after the right one is evaluated, so a variable has to be copied if the right one may change it
+    if (l < this->loop.ran_cell && has_side_effects(rhs)){
+        uint32_t copy = this->alloc_temp();
+        x64::move(code, copy, l);
+        l = copy;
+    }
+    uint32_t r = this->emit(rhs);
+    // both operands are loaded before the result is stored, so the result can reuse their cells
+    this->next_temp = base;
+    uint32_t dst = (target != NO_CELL) ? target : this->alloc_temp();
+    // subtraction, division and modulo take their operands in the reverse order, to match ArithNode::apply
+    if (node->get_node_type() == Arith_N && type == INT){
+        switch (op){
+            case ArithAdd: load(code, EAX, l); mem_op(code, {0x03}, EAX, r); break;
+            case ArithSub: load(code, EAX, r); mem_op(code, {0x2B}, EAX, l); break;
+            case ArithMul: load(code, EAX, l); mem_op(code, {0x0F, 0xAF}, EAX, r); break;
+            default:
+                // cdq, then idiv leaves the quotient in eax and the remainder in edx
+                load(code, EAX, r);
+                code.push_back(0x99);
+                mem_op(code, {0xF7}, 7, l);
+                store(code, op == ArithMod ? EDX : EAX, dst);
+                return dst;
+        }
+        store(code, EAX, dst);
+    }
+    else if (node->get_node_type() == Arith_N){
+        switch (op){
+            case ArithAdd: load_sd(code, XMM0, l); mem_op(code, {0xF2, 0x0F, 0x58}, XMM0, r); break;
+            case ArithSub: load_sd(code, XMM0, r); mem_op(code, {0xF2, 0x0F, 0x5C}, XMM0, l); break;
+            case ArithMul: load_sd(code, XMM0, l); mem_op(code, {0xF2, 0x0F, 0x59}, XMM0, r); break;
+            default: load_sd(code, XMM0, r); mem_op(code, {0xF2, 0x0F, 0x5E}, XMM0, l); break;
+        }
+        store_sd(code, XMM0, dst);
+    }
+    else if (node->get_node_type() == Comp_N && type == INT){
+        load(code, EAX, l);
+        mem_op(code, {0x3B}, EAX, r);
+        Cond cond = (op == LessThan) ? CondLess : (op == GreatherThan) ? CondGreater : (op == Equal) ? CondEqual : CondNotEqual;
+        set(code, cond, EAX);
+        zero_extend(code);
+        store(code, EAX, dst);
+    }
+    else if (node->get_node_type() == Comp_N){
+        // ucomisd sets the parity flag for NaN, which every comparison but '!=' must treat as false
+        load_sd(code, XMM0, op == LessThan ? r : l);
+        mem_op(code, {0x66, 0x0F, 0x2E}, XMM0, op == LessThan ? l : r);
+        if (op == LessThan || op == GreatherThan)
+            set(code, CondAbove, EAX);
+        else if (op == Equal){
+            set(code, CondEqual, EAX);
+            set(code, CondNoParity, ECX);
+            code.insert(code.end(), {0x20, 0xC8});
+        }
+        else{
+            set(code, CondNotEqual, EAX);
+            set(code, CondParity, ECX);
+            code.insert(code.end(), {0x08, 0xC8});
+        }
+        zero_extend(code);
+        store(code, EAX, dst);
+    }
+    else{
+        load(code, EAX, l);
+        mem_op(code, {static_cast<uint8_t>(op == LogicAnd ? 0x23 : 0x0B)}, EAX, r);
+        store(code, EAX, dst);
+    }
+    return dst;
+}
+
+// emits the code for a node so that its value ends up in the given cell
+void JitCompiler::emit_into(Node* node, uint32_t dst){
+    uint32_t src = this->emit(node, dst);
+    if (src != dst)
+        x64::move(this->code, dst, src);
+}
+
+// returns the cell of a variable, every reference to the same slot shares a cell
+uint32_t JitCompiler::var_cell(Node* node, bool write){
+    VarNode* var = static_cast<VarNode*>(node);
+    uint64_t key = (static_cast<uint64_t>(var->get_depth()) << 32) | var->get_slot();
+    auto cell_itt = this->var_cells.find(key);
+    size_t index;
+    if (cell_itt != this->var_cells.end())
+        index = cell_itt->second;
+    else{
+        this->loop.vars.push_back({{var->get_depth(), var->get_slot(), var->get_type()}, this->next_temp++});
+        this->loop.env = var->get_env();
+        index = this->loop.vars.size() - 1;
+        this->var_cells[key] = index;
+    }
+    if (write)
+        this->loop.vars[index].written = true;
+    return this->loop.vars[index].cell;
+}
+
+uint32_t JitCompiler::alloc_temp(){
+    uint32_t cell = this->next_temp++;
+    if (this->next_temp > this->loop.cells.size())
+        this->loop.cells.resize(this->next_temp);
+    return cell;
+}
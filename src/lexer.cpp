@@ -1,144 +1,365 @@
-#include <iostream>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
-#include <unordered_map>
 
 #include "../inc/lexer.h"
 
-Token parse_token(const std::string& expr, size_t& str_pos, const std::unordered_map<char, TokenType>& char_tokens, const std::unordered_map<std::string, TokenType>& word_tokens){
-    // read to the end of the current token
-    std::string token_str;
-    token_str.push_back(expr[str_pos - 1]);
-    while (str_pos < expr.size() && !char_tokens.count(expr[str_pos])){
-        token_str.push_back(expr[str_pos]);
-        ++str_pos;
+// the lexical class of a single character, this determines how the lexer handles a token starting with that character
+enum CharClass: uint8_t{
+    CharWord,   // part of a keyword or user-defined symbol
+    CharDigit,  // starts a numeric literal
+    CharSingle, // a complete token on its own
+    CharSpace,  // separates tokens, but isn't one
+    CharStar,   // either '*' or '**'
+    CharBang,   // either '!' or '!='
+    CharEq,     // either '=' or '=='
+    CharQuote   // starts a character literal
+};
+
+struct CharInfo{
+    CharClass char_class;
+    TokenType type; // the token produced by CharSingle characters
+};
+
+// builds the table that maps every possible byte to its class at compile time
+constexpr std::array<CharInfo, 256> make_char_table(){
+    std::array<CharInfo, 256> table{};
+    for (CharInfo& info : table)
+        info = {CharWord, Sym};
+    for (int chr = '0'; chr <= '9'; chr++)
+        table[chr] = {CharDigit, IntLiteral};
+    table['+'] = {CharSingle, Add};
+    table['-'] = {CharSingle, Sub};
+    table['/'] = {CharSingle, Div};
+    table['%'] = {CharSingle, Mod};
+    table['>'] = {CharSingle, Greater};
+    table['<'] = {CharSingle, Less};
+    table['('] = {CharSingle, EvalBlock};
+    table[')'] = {CharSingle, EvalBlockEnd};
+    table['['] = {CharSingle, ParamOpen};
+    table[']'] = {CharSingle, ParamClose};
+    table[';'] = {CharSingle, Break};
+    table['\n'] = {CharSingle, Break};
+    table[' '] = {CharSpace, Other};
+    table['\t'] = {CharSpace, Other};
+    table['*'] = {CharStar, Other};
+    table['!'] = {CharBang, Other};
+    table['='] = {CharEq, Other};
+    table['\''] = {CharQuote, Other};
+    return table;
+}
+constexpr std::array<CharInfo, 256> CHAR_TABLE = make_char_table();
+
+// returns whether a character ends the word before it, digits and word characters are the only ones that don't
+inline bool is_boundary(char chr){
+    CharClass char_class = CHAR_TABLE[static_cast<unsigned char>(chr)].char_class;
+    return char_class != CharWord && char_class != CharDigit;
+}
+
+// matches a word against the language's keywords, dispatching on length first so each word needs at most a few comparisons
+TokenType match_keyword(std::string_view word){
+    switch (word.size()){
+        case 2:
+            if (word == "if") return CondBlock;
+            if (word == "||") return Or;
+            if (word == "&&") return And;
+            break;
+        case 3:
+            if (word == "int") return TypeInt;
+            if (word == "let") return Defn;
+            if (word == "end") return BlockEnd;
+            if (word == "arr") return Arr;
+            break;
+        case 4:
+            if (word == "else") return ElseBlock;
+            if (word == "char") return TypeChar;
+            if (word == "bool") return TypeBool;
+            if (word == "true") return BoolLiteral;
+            break;
+        case 5:
+            if (word == "while") return LoopBlock;
+            if (word == "begin") return Block;
+            if (word == "block") return Block;
+            if (word == "float") return TypeFloat;
+            if (word == "false") return BoolLiteral;
+            if (word == "print") return Print;
+            break;
+        case 7:
+            if (word == "println") return Println;
+            break;
     }
-    // determine the token type
-    auto type = word_tokens.find(token_str);
-    if (type != word_tokens.end()) 
-        return Token(type->second, token_str);
-    // we assume any unrecognized character is a user-defined symbol
-    return Token(Sym, token_str);
+    // we assume any unrecognized word is a user-defined symbol
+    return Sym;
 }
 
-Token parse_num(const std::string& expr, size_t& str_pos){
-    std::string token_str;
-    token_str.push_back(expr[str_pos-1]);
-    bool radix_found {false};
-        while (str_pos < expr.size() && (('0' <= expr[str_pos] && expr[str_pos] <= '9') || expr[str_pos] == '.')){
-            if (expr[str_pos] == '.'){
-                if (radix_found)
-                    throw std::runtime_error("invalid floating point literal");
-                radix_found = true;
-            }
-            token_str.push_back(expr[str_pos]);
-            str_pos++;
+// returns a description of a position in the source, to be appended to error messages
+std::string describe_location(uint32_t line, uint32_t col){
+    return " (line " + std::to_string(line) + ", col " + std::to_string(col) + ")";
+}
+
+/*
+    returns the position of the last statement break in the source that is safe to split at, or npos if there isn't one.
+    A break preceded by a quote might be the body of a character literal, so those are skipped
+*/
+size_t find_break(std::string_view src){
+    for (size_t pos = src.size(); pos-- > 0;){
+        if ((src[pos] == '\n' || src[pos] == ';') && (pos == 0 || src[pos - 1] != '\''))
+            return pos;
+    }
+    return std::string_view::npos;
+}
+
+// reads a numeric literal starting at str_pos, advancing str_pos to the first character after it
+std::string_view parse_num(std::string_view expr, size_t& str_pos, bool& radix_found){
+    size_t start = str_pos;
+    radix_found = false;
+    str_pos++;
+    while (str_pos < expr.size() && (('0' <= expr[str_pos] && expr[str_pos] <= '9') || expr[str_pos] == '.')){
+        if (expr[str_pos] == '.'){
+            if (radix_found)
+                return {};
+            radix_found = true;
         }
-        if (radix_found)
-            return Token(FloatLiteral, token_str);
-        return Token(IntLiteral, token_str);
+        str_pos++;
+    }
+    return expr.substr(start, str_pos - start);
 }
 
-void tokenize(const std::string& expr, std::vector<Token>& tokens){
+void tokenize(std::string_view expr, std::vector<Token>& tokens, uint32_t first_line, uint32_t first_col){
     size_t str_pos = 0;
     size_t expr_len = expr.length();
-    std::unordered_map<char, TokenType> char_tokens = {
-        {'+', Add},
-        {'-', Sub},
-        {'*', Other},
-        {'/', Div},
-        {'%', Mod},
-        {'>', Greater},
-        {'<', Less},
-        {'(', EvalBlock},
-        {')', EvalBlockEnd},
-        {'[', ParamOpen},
-        {']', ParamClose},
-        {';', Break},
-        {'\n', Break},
-        {'=', Other},
-        {'\'', Other},
-        {'!', Other},
-        {' ', Other},
-        {'\t', Other}
-    };
-    std::unordered_map<std::string, TokenType> word_tokens= {
-        {"if", CondBlock},
-        {"else", ElseBlock},
-        {"while", LoopBlock},
-        {"block", Block},
-        {"int", TypeInt},
-        {"float", TypeFloat},
-        {"char", TypeChar},
-        {"bool", TypeBool},
-        {"true", BoolLiteral},
-        {"false", BoolLiteral},
-        {"arr", Arr},
-        {"let", Defn},
-        {"begin", Block},
-        {"end", BlockEnd},
-        {"||", Or},
-        {"&&", And},
-        {"print", Print},
-        {"println", Println}
-
-    };
-    std::string token_str;
+    size_t line_start = 0;
+    uint32_t line = first_line;
+    uint32_t col_base = first_col; // the column of line_start, which is only offset on the first line
+    bool radix_found;
     while (str_pos < expr_len){
-        token_str.clear();
         char chr = expr[str_pos];
-        str_pos += 1;
-        auto type_itt = char_tokens.find(chr);
-        if (type_itt != char_tokens.end()){
-            token_str.push_back(chr);
-            TokenType token = type_itt->second;
-            if (token != Other){
-                tokens.push_back({token, token_str});
-                continue;
-            }
-            std::string chr_str;
-            switch (chr){
-            case '*':
-                if (str_pos < expr_len && expr[str_pos] == '*'){
-                    tokens.push_back({Pow, "**"});
-                    str_pos++;
-                } else { 
-                    tokens.push_back({Mul, "*"});
+        const CharInfo& info = CHAR_TABLE[static_cast<unsigned char>(chr)];
+        size_t start = str_pos;
+        uint32_t col = start - line_start + col_base;
+        std::string_view num;
+        switch (info.char_class){
+            case CharSingle:
+                tokens.emplace_back(info.type, expr.substr(start, 1), line, col);
+                str_pos++;
+                if (chr == '\n'){
+                    line++;
+                    line_start = str_pos;
+                    col_base = 1;
                 }
                 break;
-            case '!':
-                if (str_pos < expr_len && expr[str_pos] == '='){
-                    tokens.push_back({Neq, "!="});
-                    str_pos++;
+            case CharSpace:
+                str_pos++;
+                break;
+            case CharStar:
+                if (str_pos + 1 < expr_len && expr[str_pos + 1] == '*'){
+                    tokens.emplace_back(Pow, expr.substr(start, 2), line, col);
+                    str_pos += 2;
                 } else {
-                    tokens.push_back(Not);
+                    tokens.emplace_back(Mul, expr.substr(start, 1), line, col);
+                    str_pos++;
                 }
-            break;
-            case '=':
-                if (str_pos < expr_len && expr[str_pos] == '='){
-                    tokens.push_back({Eq, "=="});
+                break;
+            case CharBang:
+                if (str_pos + 1 < expr_len && expr[str_pos + 1] == '='){
+                    tokens.emplace_back(Neq, expr.substr(start, 2), line, col);
+                    str_pos += 2;
+                } else {
+                    tokens.emplace_back(Not, std::string_view(), line, col);
                     str_pos++;
+                }
+                break;
+            case CharEq:
+                if (str_pos + 1 < expr_len && expr[str_pos + 1] == '='){
+                    tokens.emplace_back(Eq, expr.substr(start, 2), line, col);
+                    str_pos += 2;
                 } else {
-                    tokens.push_back({Asgn, "="});
+                    tokens.emplace_back(Asgn, expr.substr(start, 1), line, col);
+                    str_pos++;
                 }
+                break;
+            case CharQuote:
+                // ensure the quote proceeds a valid character literal
+                if (str_pos + 2 >= expr_len || expr[str_pos + 2] != '\'')
+                    throw std::runtime_error("invalid character literal" + describe_location(line, col));
+                tokens.emplace_back(CharLiteral, expr.substr(start + 1, 1), line, col);
+                str_pos += 3;
+                break;
+            case CharDigit:
+                num = parse_num(expr, str_pos, radix_found);
+                if (num.empty())
+                    throw std::runtime_error("invalid floating point literal" + describe_location(line, col));
+                tokens.emplace_back(radix_found ? FloatLiteral : IntLiteral, num, line, col);
+                break;
+            case CharWord:
+                // read to the end of the word, then determine whether it's a keyword or a symbol
+                str_pos++;
+                while (str_pos < expr_len && !is_boundary(expr[str_pos]))
+                    str_pos++;
+                std::string_view word = expr.substr(start, str_pos - start);
+                tokens.emplace_back(match_keyword(word), word, line, col);
+                break;
+        }
+    }
+}
+
+// sources smaller than this are lexed on the calling thread, since starting threads would cost more than it saves
+static const size_t PARALLEL_MIN_CHUNK = 1024 * 1024;
+
+/*
+    lexes a source on several threads, producing exactly the tokens and errors tokenize would. The source is split into chunks
+    at the statement breaks find_break considers safe, which always start a new token. Each chunk is lexed as if it started the
+    source, then its tokens are moved to their place in the output, offset by the line and column the chunk really starts at.
+    If threads is 0, one is used for every core
+*/
+void tokenize_parallel(std::string_view src, std::vector<Token>& tokens, unsigned threads){
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    // several chunks per thread even out the work when some chunks are slower to lex than others
+    size_t chunk_size = std::max(PARALLEL_MIN_CHUNK, src.size() / (threads * 4) + 1);
+    if (threads == 1 || src.size() < 2 * chunk_size){
+        tokenize(src, tokens);
+        return;
+    }
+    std::vector<std::string_view> chunks;
+    size_t start = 0;
+    while (start < src.size()){
+        size_t end = std::min(src.size(), start + chunk_size);
+        // a chunk that has no safe break is merged with the next one
+        while (end < src.size()){
+            size_t cut = find_break(src.substr(start, end - start));
+            if (cut != std::string_view::npos){
+                end = start + cut + 1;
+                break;
+            }
+            end = std::min(src.size(), end + chunk_size);
+        }
+        chunks.push_back(src.substr(start, end - start));
+        start = end;
+    }
+    struct ChunkResult{
+        std::vector<Token> tokens;
+        bool failed {false};
+        uint32_t lines {0}; // the number of lines the chunk ends
+        uint32_t last_col {0}; // the column of the chunk's end, relative to the start of its last line
+    };
+    std::vector<ChunkResult> results(chunks.size());
+    std::atomic<size_t> next_chunk {0};
+    auto run_workers = [&](auto&& work){
+        next_chunk = 0;
+        std::vector<std::thread> workers;
+        auto worker = [&](){
+            for (size_t i = next_chunk++; i < chunks.size(); i = next_chunk++)
+                work(i);
+        };
+        for (unsigned i = 1; i < std::min<size_t>(threads, chunks.size()); i++)
+            workers.emplace_back(worker);
+        worker();
+        for (std::thread& thread : workers)
+            thread.join();
+    };
+    run_workers([&](size_t i){
+        ChunkResult& result = results[i];
+        try{
+            // sources average a few bytes per token, so this saves most of the vector's regrowth
+            result.tokens.reserve(chunks[i].size() / 4);
+            tokenize(chunks[i], result.tokens);
+        }
+        catch (std::runtime_error&){
+            result.failed = true;
+        }
+        // only newlines that were lexed as breaks start lines, a newline can also be the body of a character literal
+        const char* last_line = nullptr;
+        for (const Token& token : result.tokens){
+            if (token.type == Break && token.txt[0] == '\n'){
+                result.lines++;
+                last_line = token.txt.data();
+            }
+        }
+        result.last_col = last_line ? chunks[i].data() + chunks[i].size() - last_line - 1 : chunks[i].size();
+    });
+    // work out where every chunk starts, only the chunks before the first error are kept
+    std::vector<size_t> offsets(chunks.size() + 1, tokens.size());
+    std::vector<uint32_t> first_lines(chunks.size(), 1), first_cols(chunks.size(), 1);
+    size_t used = 0;
+    for (; used < chunks.size() && !results[used].failed; used++){
+        offsets[used + 1] = offsets[used] + results[used].tokens.size();
+        if (used + 1 < chunks.size()){
+            first_lines[used + 1] = first_lines[used] + results[used].lines;
+            first_cols[used + 1] = results[used].lines ? results[used].last_col + 1 : first_cols[used] + results[used].last_col;
+        }
+    }
+    tokens.resize(offsets[used]);
+    run_workers([&](size_t i){
+        if (i >= used)
+            return;
+        Token* out = tokens.data() + offsets[i];
+        for (Token& token : results[i].tokens){
+            // only the chunk's first line is offset by the column it starts at
+            if (token.line == 1)
+                token.col += first_cols[i] - 1;
+            token.line += first_lines[i] - 1;
+            *out++ = token;
+        }
+        results[i].tokens = std::vector<Token>();
+    });
+    // the error was located as if its chunk started the source, so the chunk is lexed again where it belongs to throw it
+    if (used < chunks.size())
+        tokenize(chunks[used], tokens, first_lines[used], first_cols[used]);
+}
+
+/* TokenStream methods */
+// lexes the next chunk of the source and appends its tokens, returns false once the whole source has been lexed
+bool TokenStream::next(std::vector<Token>& tokens){
+    if (this->done)
+        return false;
+    std::string chunk = std::move(this->pending);
+    this->pending.clear();
+    // keep reading until the chunk contains a complete statement, or the source runs out
+    while (true){
+        size_t old_size = chunk.size();
+        chunk.resize(old_size + this->chunk_size);
+        this->in.read(&chunk[old_size], this->chunk_size);
+        chunk.resize(old_size + this->in.gcount());
+        if (this->in.gcount() == 0){
+            this->done = true;
             break;
-            case '\'':
-                // ensure the quore proceeds a valid character literal 
-                if (str_pos >= expr_len || expr[str_pos+1] != '\'')
-                    throw std::runtime_error("invalid character literal");
-                chr_str.push_back(expr[str_pos]);
-                // push the literal to the token vector
-                tokens.push_back({CharLiteral, chr_str});
-                str_pos += 2;
+        }
+        // whether a break is inside a character literal depends on the byte before it, which may have been read earlier
+        size_t from = old_size ? old_size - 1 : 0;
+        size_t cut = find_break(std::string_view(chunk).substr(from));
+        if (cut != std::string_view::npos && cut + from >= old_size){
+            cut += from + 1;
+            this->pending = chunk.substr(cut);
+            chunk.resize(cut);
             break;
-            default: break;
-            }
         }
-        // parse the token if it's a literal number
-        else if ('0' <= chr && chr <= '9')
-            tokens.push_back(parse_num(expr, str_pos));
-        else
-            tokens.push_back(parse_token(expr, str_pos, char_tokens, word_tokens));
     }
-}
\ No newline at end of file
+    if (chunk.empty())
+        return !this->done;
+    this->chunks.push_back(std::move(chunk));
+    size_t init_count = tokens.size();
+    const std::string& text = this->chunks.back();
+    tokenize(text, tokens, this->line, this->col);
+    // chunks can end in the middle of a line, so track where the next one starts
+    size_t last_line = text.rfind('\n');
+    this->line += std::count(text.begin(), text.end(), '\n');
+    this->col = (last_line == std::string::npos) ? this->col + text.size() : text.size() - last_line;
+    this->produced += tokens.size() - init_count;
+    this->chunk_ends.push_back(this->produced);
+    return true;
+}
+
+// frees every chunk whose tokens are all among the first consumed tokens produced by the stream
+void TokenStream::release(size_t consumed){
+    while (!this->chunk_ends.empty() && this->chunk_ends.front() <= consumed){
+        this->chunks.pop_front();
+        this->chunk_ends.pop_front();
+    }
+}
@@ -1,19 +1,155 @@
+#include <fstream>
 #include <iostream>
 #include <string>
 
+#include "../inc/daemon.h"
 #include "../inc/interpreter.h"
+#include "../inc/profiler.h"
+#include "../inc/source.h"
 
 int main(int argc, char** argv){
-    if (argc != 2){
-        std::cerr << "error: this program acepts exactly one argument" << std::endl;
+    std::string file_path;
+    bool stream = false;
+    bool emit_c = false;
+    bool stop = false;
+    bool show_result = false;
+    std::string serve_path, client_path;
+    bool profile = false;
+    std::string folded_path;
+    Interpreter interpreter;
+    for (int i = 1; i < argc; i++){
+        std::string arg = argv[i];
+        if (arg == "--tree-walk")
+            interpreter.set_backend(TreeWalker);
+        else if (arg == "--stack-vm")
+            interpreter.set_backend(StackVM);
+        else if (arg == "--flat")
+            interpreter.set_backend(FlatTreeWalker);
+        else if (arg == "--jit")
+            interpreter.set_backend(Tiered);
+        else if (arg == "--stream")
+            stream = true;
+        else if (arg == "--emit-c")
+            emit_c = true;
+        else if (arg == "--cache")
+            interpreter.set_cache(true);
+        else if (arg == "--lazy")
+            interpreter.set_lazy(true);
+        else if (arg == "--flush=line")
+            interpreter.set_flush_policy(FlushLine);
+        else if (arg == "--flush=size")
+            interpreter.set_flush_policy(FlushSize);
+        else if (arg == "--flush=exit")
+            interpreter.set_flush_policy(FlushExit);
+        // the daemon options take the path of the daemon's socket as their next argument
+        else if (arg == "--serve" || arg == "--client"){
+            if (i + 1 == argc){
+                std::cerr << "error: \"" << arg << "\" expects a socket path" << std::endl;
+                return 1;
+            }
+            (arg == "--serve" ? serve_path : client_path) = argv[++i];
+        }
+        else if (arg == "--stop")
+            stop = true;
+        // the value of the program's last statement is printed once it finishes, whether it ran locally or on a daemon
+        else if (arg == "--result")
+            show_result = true;
+        // the hottest lines are written to stderr once the program finishes, and --folded also writes every stack to a file
+        else if (arg == "--profile")
+            profile = true;
+        else if (arg.starts_with("--folded=")){
+            profile = true;
+            folded_path = arg.substr(9);
+        }
+        else if (arg == "-O0" || arg == "-O1")
+            interpreter.set_opt_level(arg[2] - '0');
+        else if (arg.size() > 1 && arg[0] == '-'){
+            std::cerr << "error: unrecognized option \"" << arg << "\"" << std::endl;
+            return 1;
+        }
+        else if (file_path.empty())
+            file_path = arg;
+        else {
+            std::cerr << "error: this program acepts exactly one source file" << std::endl;
+            return 1;
+        }
+    }
+    if (!serve_path.empty()){
+        Daemon daemon(serve_path);
+        if (!daemon.serve()){
+            std::cerr << "error: " << daemon.get_err() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+    // --stop asks a running daemon to shut down instead of running a file on it
+    if (!client_path.empty() && stop){
+        DaemonReply reply;
+        if (!send_request(client_path, Shutdown, "", reply)){
+            std::cerr << "error: failed to reach the daemon at \"" << client_path << "\"" << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+    if (file_path.empty()){
+        std::cerr << "usage: nebula [--tree-walk|--flat|--stack-vm|--jit] [--stream|--emit-c] [--cache] [--lazy] [--flush=line|size|exit] [-O0|-O1]\n"
+                  << "              [--profile] [--folded=<path>] [--result] <file>\n"
+                  << "       nebula --serve <socket>\n"
+                  << "       nebula --client <socket> [--result] <file>|--stop" << std::endl;
         return 1;
     }
-    std::string file_path = argv[1];
-    Interpreter interpreter;
-    int res = interpreter.run_file(file_path);
+    if (!client_path.empty())
+        return run_client(client_path, file_path, show_result);
+    Profiler profiler;
+    if (profile)
+        interpreter.set_profiler(&profiler);
+    int res;
+    // the C translation of the program is written to stdout instead of running it
+    if (emit_c){
+        SourceFile source;
+        if (!source.open(file_path)){
+            std::cerr << "error: failed to read source file: \"" << file_path << "\"" << std::endl;
+            return 1;
+        }
+        res = interpreter.emit_c(source.view(), std::cout);
+    }
+    // when streaming, statements are run as they are read, and a path of "-" reads from stdin
+    else if (stream && file_path == "-")
+        res = interpreter.run_stream(std::cin);
+    else if (stream){
+        std::ifstream in(file_path, std::ios::binary);
+        if (!in){
+            std::cerr << "error: failed to read source file: \"" << file_path << "\"" << std::endl;
+            return 1;
+        }
+        res = interpreter.run_stream(in);
+    }
+    else
+        res = interpreter.run_file(file_path);
+    // a program that fails part way through is still profiled up to the error
+    if (profile){
+        SourceFile source;
+        std::string_view text;
+        if (file_path != "-" && source.open(file_path))
+            text = source.view();
+        profiler.report(std::cerr, text);
+        if (!folded_path.empty()){
+            std::ofstream folded(folded_path);
+            if (!folded){
+                std::cerr << "error: failed to write folded stacks to \"" << folded_path << "\"" << std::endl;
+                return 1;
+            }
+            profiler.write_folded(folded, text);
+        }
+    }
     if (res){
         interpreter.display_err();
         return 1;
     }
+    Value result = interpreter.result();
+    if (show_result && !result.is_null()){
+        char buffer[Value::MAX_FORMATTED];
+        std::cout.write(buffer, result.format(buffer)) << std::endl;
+    }
     return 0;
-}
\ No newline at end of file
+}
@@ -1,9 +1,11 @@
 #include <iostream>
 #include <memory>
+#include <new>
 #include <stdio.h>
 
 #include "../inc/values.hpp"
 #include "../inc/nodes.hpp"
+#include "../inc/arrayops.h"
 
 /* PtrNode Functions */
 PtrNode::PtrNode(Value* val_ptr){
@@ -21,9 +23,11 @@ Value PtrNode::eval(){
 }
 
 /* VarNode Functions */
-VarNode::VarNode(const std::shared_ptr<Value>& val, bool initialize){
-    this->val_ptr = val;
-    this->val_type = val->get_type();
+VarNode::VarNode(Environment* env, const Symbol& symbol, bool initialize){
+    this->env = env;
+    this->depth = symbol.depth;
+    this->slot = symbol.slot;
+    this->val_type = symbol.type;
     this->initialized = initialize;
     this->node_type = NodeType::Var_N;
 }
@@ -31,8 +35,7 @@ VarNode::VarNode(const std::shared_ptr<Value>& val, bool initialize){
 Value VarNode::eval(){
     if (!this->initialized)
         throw std::runtime_error("cannot evaluate an unitialized variable");
-    auto tmp = *this->val_ptr;
-    return *this->val_ptr;
+    return this->env->at(this->depth, this->slot);
 }
 // compares both the content and type of this variable to another
 bool VarNode::operator==(VarNode& rhs){
@@ -42,109 +45,255 @@ bool VarNode::operator==(VarNode& rhs){
 void VarNode::assign(const Value& new_val){
     if (!this->initialized)
         this->initialized = true;
-    *this->val_ptr = new_val;
+    this->env->at(this->depth, this->slot) = new_val;
 }
 
 /* AsgnNode Functions */
-AsgnNode::AsgnNode(ValNode* lhs, Node* rhs){
+AsgnNode::AsgnNode(ValNode* lhs, Node* rhs, std::pmr::memory_resource* resource){
     this->rhs = rhs;
     this->lhs = lhs;
+    this->resource = resource;
     this->node_type = NodeType::Asgn_N;
 }
 // assigns lhs to rhs and returns the new value of lhs. This throws an exception if rhs evaluates to a different type than rhs
 Value AsgnNode::eval(){
-    Value rhs_val = this->rhs->eval();
-    if (rhs_val.get_type() != this->lhs->get_type())
+    Value rhs_val = eval_child(this->rhs);
+    if (!this->checked && rhs_val.get_type() != this->lhs->get_type())
         throw std::runtime_error("cannot assign a variable to a value of a different type");
     this->lhs->assign(rhs_val);
+    // assignments to variables can skip the virtual calls from now on
+    if (this->resource && this->lhs->get_node_type() == Var_N){
+        this->replacement = new (this->resource->allocate(sizeof(VarAsgnNode), alignof(VarAsgnNode))) VarAsgnNode(*this);
+        this->resource = nullptr;
+    }
     return this->lhs->eval();
 }
+// the variable's type never changes, so there's nothing to guard beyond the assignment's own type check
+Value VarAsgnNode::eval(){
+    Value rhs_val = eval_child(this->rhs);
+    VarNode* var = static_cast<VarNode*>(this->lhs);
+    if (!this->checked && rhs_val.get_type() != var->get_type())
+        throw std::runtime_error("cannot assign a variable to a value of a different type");
+    var->assign(rhs_val);
+    return rhs_val;
+}
+
+// allocates a specialised node from a resource, which is normally the parser's arena, so it's never destroyed
+template <typename T, typename Generic>
+T* make_quick(std::pmr::memory_resource* resource, Generic* generic){
+    return new (resource->allocate(sizeof(T), alignof(T))) T(generic);
+}
 
 /* CompNode functions */
-CompNode::CompNode(Node* lhs, Node* rhs, Operator op){
+CompNode::CompNode(Node* lhs, Node* rhs, Operator op, std::pmr::memory_resource* resource){
     this->lhs = lhs;
     this->rhs = rhs;
     this->op = op;
+    this->resource = resource;
     this->node_type = NodeType::Comp_N;
 }
 Value CompNode::eval(){
-    Value lhs_val = this->lhs->eval();
-    Value rhs_val = this->rhs->eval();
+    Value lhs_val = eval_child(this->lhs);
+    Value rhs_val = eval_child(this->rhs);
+    if (this->resource && lhs_val.get_type() == rhs_val.get_type())
+        this->quicken(lhs_val.get_type());
+    if (this->checked)
+        return CompNode::compute(this->op, lhs_val, rhs_val);
+    return CompNode::apply(this->op, lhs_val, rhs_val);
+}
+// replaces this node with one specialised for numeric operands of the given type
+void CompNode::quicken(ValueType type){
+    Node* quick = nullptr;
+    switch (type){
+        case INT:
+            switch (this->op){
+                case LessThan: quick = make_quick<IntCompNode<LessThan>>(this->resource, this); break;
+                case GreatherThan: quick = make_quick<IntCompNode<GreatherThan>>(this->resource, this); break;
+                case Equal: quick = make_quick<IntCompNode<Equal>>(this->resource, this); break;
+                case NEqual: quick = make_quick<IntCompNode<NEqual>>(this->resource, this); break;
+            }
+            break;
+        case FLOAT:
+            switch (this->op){
+                case LessThan: quick = make_quick<FloatCompNode<LessThan>>(this->resource, this); break;
+                case GreatherThan: quick = make_quick<FloatCompNode<GreatherThan>>(this->resource, this); break;
+                case Equal: quick = make_quick<FloatCompNode<Equal>>(this->resource, this); break;
+                case NEqual: quick = make_quick<FloatCompNode<NEqual>>(this->resource, this); break;
+            }
+            break;
+    }
+    // a node is only ever specialised once, even if there's no specialisation for its operands
+    this->replacement = quick;
+    this->resource = nullptr;
+}
+// reverts a specialised node to the generic one it was created from, which then stays generic
+Value CompNode::deoptimise(const Value& lhs_val, const Value& rhs_val){
+    this->generic->lhs = this->lhs;
+    this->generic->rhs = this->rhs;
+    this->generic->resource = nullptr;
+    this->replacement = this->generic;
+    return CompNode::apply(this->op, lhs_val, rhs_val);
+}
+// compares two evaluated operands, this is shared by every backend so that they agree on semantics
+Value CompNode::apply(Operator op, const Value& lhs_val, const Value& rhs_val){
     if (lhs_val.get_type() != rhs_val.get_type())
         throw std::runtime_error("cannot compare two values of differing types");
+    if ((op == LessThan || op == GreatherThan) && lhs_val.get_type() != INT && lhs_val.get_type() != FLOAT)
+        throw std::runtime_error("cannot use the '>' operator on non-numeric values");
+    return CompNode::compute(op, lhs_val, rhs_val);
+}
+// compares two operands that are known to have the same type, which must be numeric for ordering comparisons
+Value CompNode::compute(Operator op, const Value& lhs_val, const Value& rhs_val){
     bool result;
     switch (lhs_val.get_type()){
         case INT:
-            result = this->compare(lhs_val.as<int>(), rhs_val.as<int>(), true);
+            result = CompNode::compare(op, lhs_val.as<int>(), rhs_val.as<int>(), true);
             break;
         case FLOAT:
-            result = this->compare(lhs_val.as<double>(), rhs_val.as<double>(), true);
+            result = CompNode::compare(op, lhs_val.as<double>(), rhs_val.as<double>(), true);
             break;
         case CHAR:
-            result = this->compare(lhs_val.as<char>(), rhs_val.as<char>(), false);
+            result = CompNode::compare(op, lhs_val.as<char>(), rhs_val.as<char>(), true);
             break;
         case BOOL:
-            result = this->compare(lhs_val.as<bool>(), rhs_val.as<bool>(), false);
+            result = CompNode::compare(op, lhs_val.as<bool>(), rhs_val.as<bool>(), true);
             break;
+        default:
+            throw std::runtime_error("cannot compare void values");
     }
     return std::move(Value::create(ValueType::BOOL, result));
 }
 
 /* BoolLogicNode Functions*/
-BoolLogicNode::BoolLogicNode(Node* lhs, Node* rhs, Operator op){
+BoolLogicNode::BoolLogicNode(Node* lhs, Node* rhs, Operator op, std::pmr::memory_resource* resource){
     this->lhs = lhs;
     this->rhs = rhs;
     this->op = op;
+    this->resource = resource;
     this->node_type = NodeType::BoolLogic_N;
 }
 Value BoolLogicNode::eval(){
-    Value lhs_val = lhs->eval();
-    Value rhs_val = rhs->eval();
+    Value lhs_val = eval_child(this->lhs);
+    Value rhs_val = eval_child(this->rhs);
+    if (this->resource && lhs_val.get_type() == BOOL && rhs_val.get_type() == BOOL){
+        if (this->op == LogicOr)
+            this->replacement = make_quick<QuickLogicNode<LogicOr>>(this->resource, this);
+        else
+            this->replacement = make_quick<QuickLogicNode<LogicAnd>>(this->resource, this);
+        this->resource = nullptr;
+    }
+    if (this->checked)
+        return BoolLogicNode::compute(this->op, lhs_val, rhs_val);
+    return BoolLogicNode::apply(this->op, lhs_val, rhs_val);
+}
+// reverts a specialised node to the generic one it was created from, which then stays generic
+Value BoolLogicNode::deoptimise(const Value& lhs_val, const Value& rhs_val){
+    this->generic->lhs = this->lhs;
+    this->generic->rhs = this->rhs;
+    this->generic->resource = nullptr;
+    this->replacement = this->generic;
+    return BoolLogicNode::apply(this->op, lhs_val, rhs_val);
+}
+// performs a logical operation on two evaluated operands
+Value BoolLogicNode::apply(Operator op, const Value& lhs_val, const Value& rhs_val){
     if (lhs_val.get_type() != BOOL || rhs_val.get_type() != BOOL)
         throw std::runtime_error("invalid opperand types for logical operation");
+    return BoolLogicNode::compute(op, lhs_val, rhs_val);
+}
+// performs a logical operation on two operands that are known to be booleans
+Value BoolLogicNode::compute(Operator op, const Value& lhs_val, const Value& rhs_val){
     bool result;
-    switch (this->op){
+    switch (op){
         case LogicOr:
             result = lhs_val.as<bool>() || rhs_val.as<bool>();
             break;
         case LogicAnd:
             result = lhs_val.as<bool>() && rhs_val.as<bool>();
             break;
+        default:
+            throw std::runtime_error("invalid logical operator");
     }
     return Value::create(BOOL, result);
 }
 
 /* ArithNode functions  */
-ArithNode::ArithNode(Node* lhs, Node* rhs, Operator op){
+ArithNode::ArithNode(Node* lhs, Node* rhs, Operator op, std::pmr::memory_resource* resource){
     this->lhs = lhs;
     this->rhs = rhs;
     this->op = op;
+    this->resource = resource;
     this->node_type = NodeType::Arith_N;
 }
 Value ArithNode::eval(){
-    Value lhs_val = this->lhs->eval();
-    Value rhs_val = this->rhs->eval();
+    Value lhs_val = eval_child(this->lhs);
+    Value rhs_val = eval_child(this->rhs);
+    if (this->resource && lhs_val.get_type() == rhs_val.get_type())
+        this->quicken(lhs_val.get_type());
+    if (this->checked)
+        return ArithNode::compute(this->op, lhs_val, rhs_val);
+    return ArithNode::apply(this->op, lhs_val, rhs_val);
+}
+// replaces this node with one specialised for operands of the given type
+void ArithNode::quicken(ValueType type){
+    Node* quick = nullptr;
+    switch (type){
+        case INT:
+            switch (this->op){
+                case ArithAdd: quick = make_quick<IntArithNode<ArithAdd>>(this->resource, this); break;
+                case ArithSub: quick = make_quick<IntArithNode<ArithSub>>(this->resource, this); break;
+                case ArithMul: quick = make_quick<IntArithNode<ArithMul>>(this->resource, this); break;
+                case ArithDiv: quick = make_quick<IntArithNode<ArithDiv>>(this->resource, this); break;
+                case ArithMod: quick = make_quick<IntArithNode<ArithMod>>(this->resource, this); break;
+                case ArithPow: quick = make_quick<IntArithNode<ArithPow>>(this->resource, this); break;
+            }
+            break;
+        case FLOAT:
+            switch (this->op){
+                case ArithAdd: quick = make_quick<FloatArithNode<ArithAdd>>(this->resource, this); break;
+                case ArithSub: quick = make_quick<FloatArithNode<ArithSub>>(this->resource, this); break;
+                case ArithMul: quick = make_quick<FloatArithNode<ArithMul>>(this->resource, this); break;
+                case ArithDiv: quick = make_quick<FloatArithNode<ArithDiv>>(this->resource, this); break;
+                case ArithPow: quick = make_quick<FloatArithNode<ArithPow>>(this->resource, this); break;
+                // the modulo of floats is an error, so there's nothing to specialise
+                default: break;
+            }
+            break;
+    }
+    // a node is only ever specialised once, even if there's no specialisation for its operands
+    this->replacement = quick;
+    this->resource = nullptr;
+}
+// reverts a specialised node to the generic one it was created from, which then stays generic
+Value ArithNode::deoptimise(const Value& lhs_val, const Value& rhs_val){
+    this->generic->lhs = this->lhs;
+    this->generic->rhs = this->rhs;
+    this->generic->resource = nullptr;
+    this->replacement = this->generic;
+    return ArithNode::apply(this->op, lhs_val, rhs_val);
+}
+// performs arithmetic on two evaluated operands
+Value ArithNode::apply(Operator op, const Value& lhs_val, const Value& rhs_val){
+    // arrays are computed element-wise, with the operands swapped just like scalars
+    if (lhs_val.is_array() || rhs_val.is_array())
+        return array_arith(op, rhs_val, lhs_val);
     if (lhs_val.get_type() != rhs_val.get_type())
         throw std::runtime_error("cannot perform arithmetic on differing types");
-    if (lhs_val.get_type() != INT || lhs_val.get_type() != INT)
+    if (lhs_val.get_type() != INT && lhs_val.get_type() != FLOAT)
         throw std::runtime_error("invalid operation for non-numeric types");
-    switch (lhs_val.get_type()){
-    case INT:
-        return this->calculate(rhs_val.as<int>(), lhs_val.as<int>(), true);
-    case FLOAT:
-        return this->calculate(rhs_val.as<double>(), lhs_val.as<double>(), false);
-    }
-    return Value(NULL_TYPE);
+    return ArithNode::compute(op, lhs_val, rhs_val);
+}
+// performs arithmetic on two operands that are known to be numbers of the same type
+Value ArithNode::compute(Operator op, const Value& lhs_val, const Value& rhs_val){
+    if (lhs_val.get_type() == INT)
+        return ArithNode::calculate(op, rhs_val.as<int>(), lhs_val.as<int>(), true);
+    return ArithNode::calculate(op, rhs_val.as<double>(), lhs_val.as<double>(), false);
 }
 
 /* PrintNode functions */
 Value PrintNode::eval(){
     for (int i = this->args.size()-1; i >= 0; i--)
-        std::cout << args[i]->eval();
-    if (this->newline)
-        std::cout << std::endl;
-    else
-        std::cout << std::flush;
+        this->output->write(eval_child(args[i]));
+    this->output->end_print(this->newline);
     return Value(NULL_TYPE);
 }
 
@@ -0,0 +1,157 @@
+#include <climits>
+#include <stdexcept>
+
+#include "../inc/optimizer.h"
+#include "../inc/arena.h"
+#include "../inc/nodes.hpp"
+#include "../inc/block.h"
+
+// returns whether a node is a literal, and if it is, sets val to its value
+inline bool get_literal(Node* node, Value& val){
+    if (node->get_node_type() != Literal_N)
+        return false;
+    val = static_cast<LiteralNode*>(node)->get_value();
+    return true;
+}
+
+// folding must never trap while optimizing, so divisions by zero and very large powers are left to the evaluator
+bool is_safe_to_fold(Operator op, const Value& lhs_val, const Value& rhs_val){
+    if ((lhs_val.get_type() != INT && lhs_val.get_type() != FLOAT) || lhs_val.get_type() != rhs_val.get_type())
+        return true;
+    auto as_int = [](const Value& val) {return val.get_type() == INT ? val.as<int>() : static_cast<int>(val.as<double>());};
+    switch (op){
+        case ArithDiv:
+            return as_int(lhs_val) != 0 && as_int(rhs_val) != 0;
+        // the modulo of floats is an error, which is left to the evaluator to report
+        case ArithMod:
+            return lhs_val.get_type() == INT && lhs_val.as<int>() != 0 && rhs_val.as<int>() != 0;
+        /*
+            the evaluator multiplies the right operand by itself as many times as the left one says, which is only folded for small
+            exponents. An int power is computed as a double, and one that doesn't fit back in an int is left to the evaluator too
+        */
+        case ArithPow: {
+            int exponent = as_int(lhs_val);
+            if (exponent > 64)
+                return false;
+            if (lhs_val.get_type() == FLOAT)
+                return true;
+            double power = 1;
+            for (int i = 0; i < exponent; i++)
+                power *= rhs_val.as<int>();
+            return power >= INT_MIN && power <= INT_MAX;
+        }
+        default:
+            return true;
+    }
+}
+
+// returns the optimized form of a node, which may be the node itself, the caller must replace the node with the result
+Node* Optimizer::optimize(Node* node){
+    switch (node->get_node_type()){
+        case Asgn_N: {
+            AsgnNode* asgn = static_cast<AsgnNode*>(node);
+            asgn->set_rhs(this->optimize(asgn->get_rhs()));
+            return node;
+        }
+        case Comp_N: {
+            CompNode* comp = static_cast<CompNode*>(node);
+            comp->set_lhs(this->optimize(comp->get_lhs()));
+            comp->set_rhs(this->optimize(comp->get_rhs()));
+            return this->fold(node, CompNode::apply, comp->op, comp->get_lhs(), comp->get_rhs());
+        }
+        case BoolLogic_N: {
+            BoolLogicNode* logic = static_cast<BoolLogicNode*>(node);
+            logic->set_lhs(this->optimize(logic->get_lhs()));
+            logic->set_rhs(this->optimize(logic->get_rhs()));
+            return this->fold(node, BoolLogicNode::apply, logic->get_op(), logic->get_lhs(), logic->get_rhs());
+        }
+        case Arith_N: {
+            ArithNode* arith = static_cast<ArithNode*>(node);
+            arith->set_lhs(this->optimize(arith->get_lhs()));
+            arith->set_rhs(this->optimize(arith->get_rhs()));
+            return this->fold(node, ArithNode::apply, arith->get_op(), arith->get_lhs(), arith->get_rhs());
+        }
+        case Print_N: {
+            PrintNode* print_node = static_cast<PrintNode*>(node);
+            for (size_t i = 0; i < print_node->get_args().size(); i++)
+                print_node->set_arg(i, this->optimize(print_node->get_args()[i]));
+            return node;
+        }
+        case Block_N:
+            return this->optimize_block(static_cast<BlockNode*>(node));
+        default:
+            return node;
+    }
+}
+
+// eval blocks are replaced by their body, and if and while blocks with constant conditions are replaced by the code that runs
+Node* Optimizer::optimize_block(BlockNode* block){
+    Value cond_val;
+    switch (block->block_type()){
+        case Eval:
+            return this->optimize(static_cast<EvalBlockNode*>(block)->get_body());
+        case Conditional: {
+            CondBlockNode* cond = static_cast<CondBlockNode*>(block);
+            cond->set_condition(this->optimize(cond->get_condition()));
+            // which branches a deferred conditional has isn't known until it's parsed
+            if (cond->is_deferred())
+                return block;
+            this->optimize_statements(block);
+            if (cond->get_else())
+                this->optimize_statements(cond->get_else());
+            if (!get_literal(cond->get_condition(), cond_val) || cond_val.get_type() != BOOL)
+                return block;
+            if (cond_val.as<bool>()){
+                // the body shares the if block's scope, so it can be evaluated as a plain block
+                BlockNode* body = this->arena.make<BlockNode>(block->get_scope(), &this->arena);
+                body->set_location(block->get_line(), block->get_col());
+                for (Node* statement : block->get_statements())
+                    body->push_statement(statement);
+                return body;
+            }
+            if (cond->get_else())
+                return cond->get_else();
+            return this->make_literal(block, Value(NULL_TYPE));
+        }
+        case Loop: {
+            LoopBlockNode* loop = static_cast<LoopBlockNode*>(block);
+            loop->set_condition(this->optimize(loop->get_condition()));
+            this->optimize_statements(block);
+            // a loop that never runs evaluates to null
+            if (get_literal(loop->get_condition(), cond_val) && cond_val.get_type() == BOOL && !cond_val.as<bool>())
+                return this->make_literal(block, Value(NULL_TYPE));
+            return block;
+        }
+        default:
+            this->optimize_statements(block);
+            return block;
+    }
+}
+
+void Optimizer::optimize_statements(BlockNode* block){
+    if (block->is_deferred())
+        return;
+    for (size_t i = 0; i < block->get_statements().size(); i++)
+        block->set_statement(i, this->optimize(block->get_statements()[i]));
+}
+
+// replaces a binary expression of two literals with its value, expressions that would fail are left to fail at runtime
+Node* Optimizer::fold(Node* node, Value (*apply)(Operator, const Value&, const Value&), Operator op, Node* lhs, Node* rhs){
+    Value lhs_val, rhs_val;
+    if (!get_literal(lhs, lhs_val) || !get_literal(rhs, rhs_val))
+        return node;
+    if (lhs_val.get_type() == NULL_TYPE || rhs_val.get_type() == NULL_TYPE || !is_safe_to_fold(op, lhs_val, rhs_val))
+        return node;
+    try{
+        return this->make_literal(node, apply(op, lhs_val, rhs_val));
+    }
+    catch (std::runtime_error&){
+        return node;
+    }
+}
+
+Node* Optimizer::make_literal(Node* original, const Value& val){
+    LiteralNode* literal = this->arena.make<LiteralNode>(val);
+    literal->set_location(original->get_line(), original->get_col());
+    return literal;
+}
@@ -0,0 +1,60 @@
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#include "../inc/output.h"
+
+OutputBuffer::OutputBuffer(std::ostream& out, FlushPolicy policy): buffer(new char[CAPACITY]){
+    this->out = &out;
+    this->policy = policy;
+}
+
+// the buffer that printing falls back to when no interpreter owns the output, it writes every print to stdout straight away
+OutputBuffer& OutputBuffer::standard(){
+    static OutputBuffer standard_output(std::cout, FlushLine);
+    return standard_output;
+}
+
+// returns room for the given number of bytes at the end of the buffer, writing out or growing the buffer if it's full
+char* OutputBuffer::reserve(size_t bytes){
+    if (this->used + bytes > this->capacity){
+        if (this->policy != FlushExit)
+            this->flush();
+        if (this->used + bytes > this->capacity){
+            size_t new_capacity = std::max(this->capacity * 2, this->used + bytes);
+            std::unique_ptr<char[]> new_buffer(new char[new_capacity]);
+            std::memcpy(new_buffer.get(), this->buffer.get(), this->used);
+            this->buffer = std::move(new_buffer);
+            this->capacity = new_capacity;
+        }
+    }
+    return this->buffer.get() + this->used;
+}
+
+void OutputBuffer::write(const Value& val){
+    this->used += val.format(this->reserve(Value::MAX_FORMATTED));
+}
+
+void OutputBuffer::write(std::string_view str){
+    std::memcpy(this->reserve(str.size()), str.data(), str.size());
+    this->used += str.size();
+}
+
+// finishes a print statement, with a newline for println
+void OutputBuffer::end_print(bool newline){
+    if (newline){
+        *this->reserve(1) = '\n';
+        this->used++;
+    }
+    if (this->policy == FlushLine)
+        this->flush();
+}
+
+// writes everything in the buffer to the output stream
+void OutputBuffer::flush(){
+    if (this->used){
+        this->out->write(this->buffer.get(), this->used);
+        this->used = 0;
+    }
+    this->out->flush();
+}
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <charconv>
 #include <iostream>
 #include <stdexcept>
 #include <stack>
@@ -11,7 +13,8 @@
 #include "../inc/block.h"
 #include "../inc/parser.h"
 
-std::unordered_map<TokenType, Operator> OPERATOR_MAP{
+// the tables below are shared by every parser, so they're never modified after initialization and only read with at
+static const std::unordered_map<TokenType, Operator> OPERATOR_MAP{
         {TokenType::And, Operator::LogicAnd},
         {TokenType::Or, Operator::LogicOr},
         {TokenType::Eq, Operator::Equal},
@@ -27,25 +30,39 @@ std::unordered_map<TokenType, Operator> OPERATOR_MAP{
         {TokenType::Asgn, Operator::Assignment}
     };
 
-std::unordered_map<TokenType, ValueType> TYPE_MAP{
+static const std::unordered_map<TokenType, ValueType> TYPE_MAP{
     {TypeInt, ValueType::INT},
     {TypeFloat, ValueType::FLOAT},
     {TypeBool, ValueType::BOOL},
     {TypeChar, ValueType::CHAR},
 };
 
-std::unordered_map<std::string, ValueType> TYPE_STR_MAP{
-    {"int", ValueType::INT},
-    {"float", ValueType::FLOAT},
-    {"bool", ValueType::BOOL},
-    {"char", ValueType::CHAR},
-};
+// converts the text of a numeric literal token to its value
+int parse_int(const Token& token){
+    int val;
+    auto [end, err] = std::from_chars(token.txt.data(), token.txt.data() + token.txt.size(), val);
+    if (err != std::errc() || end != token.txt.data() + token.txt.size())
+        throw std::runtime_error("invalid integer literal");
+    return val;
+}
+double parse_float(const Token& token){
+    double val;
+    auto [end, err] = std::from_chars(token.txt.data(), token.txt.data() + token.txt.size(), val);
+    if (err != std::errc() || end != token.txt.data() + token.txt.size())
+        throw std::runtime_error("invalid floating point literal");
+    return val;
+}
 
 Parser::Parser(const std::vector<Token>& tokens){
     this->tokens = tokens;
     this->token_count = tokens.size();
     this->curr_scope = &this->global_scope;
 }
+Parser::Parser(std::vector<Token>&& tokens){
+    this->tokens = std::move(tokens);
+    this->token_count = this->tokens.size();
+    this->curr_scope = &this->global_scope;
+}
 Parser::~Parser(){
     this->clear();
 }
@@ -57,26 +74,19 @@ size_t Parser::stack_size(){
     return this->node_stack.size();
 }
 
-// clears all internal member variables of the parser and performs the appropriate cleanup
+// clears all internal member variables of the parser, every node and scope from the last parse is released with the arena
 void Parser::clear(){
-    while (!this->block_stack.empty()){
-        this->nodes.push_back(this->block_stack.top());
+    while (!this->block_stack.empty())
         this->block_stack.pop();
-    }
-    while (!this->node_stack.empty()){
-        Node* tmp = this->pop_node();
-        if (tmp->get_node_type() != Block_N)
-            this->nodes.push_back(tmp);
-    }
-    // this map keeps track of all pointers that have been deleted. A map is used for O(1) lookup times
-    std::unordered_map<Node*, bool> freed_ptrs;
-    for (int i = 0; i < this->nodes.size(); i++){
-        if (freed_ptrs.count(this->nodes[i]) == 0){
-            delete this->nodes[i];
-            freed_ptrs[this->nodes[i]] = true;
-        }
-        this->nodes[i] = nullptr;
-    }
+    while (!this->scope_stack.empty())
+        this->scope_stack.pop();
+    this->node_stack.clear();
+    this->curr_block = nullptr;
+    this->curr_scope = &this->global_scope;
+    this->eval_count = 0;
+    this->return_next = false;
+    this->arena.reset();
+    this->code_heap.reset();
 }
 
 bool Parser::validate(std::string& err_msg ){
@@ -87,11 +97,40 @@ bool Parser::validate(std::string& err_msg ){
     return true;
 }
 
-void Parser::reset(const std::vector<Token>& new_tokens){
+// resets the parser to parse a new set of tokens, which are moved rather than copied into the parser
+void Parser::reset(std::vector<Token>&& new_tokens){
     this->clear();
-    this->tokens = new_tokens;
-    this->token_count = new_tokens.size();
+    this->tokens = std::move(new_tokens);
+    this->token_count = this->tokens.size();
     this->curr_pos = 0;
+    this->stream = nullptr;
+}
+// resets the parser to pull its tokens from a stream, statements are then parsed one at a time with parse_next
+void Parser::reset(TokenStream* new_stream){
+    this->clear();
+    this->tokens.clear();
+    this->token_count = 0;
+    this->curr_pos = 0;
+    this->consumed = 0;
+    this->stream = new_stream;
+}
+
+// returns whether at least count more tokens are available, pulling them from the stream if there is one
+bool Parser::has_tokens(size_t count){
+    while (this->curr_pos + count > this->token_count){
+        if (!this->stream || !this->stream->next(this->tokens))
+            return false;
+        this->token_count = this->tokens.size();
+    }
+    return true;
+}
+
+// rethrows a parsing error, pointing it at the token the parser stopped on
+void Parser::throw_located(const std::runtime_error& err){
+    if (!this->token_count)
+        throw err;
+    const Token& token = this->tokens[std::min(this->curr_pos, this->token_count - 1)];
+    throw std::runtime_error(err.what() + describe_location(token.line, token.col));
 }
 
 // appends a new node to the node stack, and if we're currently in a block, to the current block
@@ -110,8 +149,6 @@ Node* Parser::pop_node(){
         ret_val = this->node_stack.back();
         this->node_stack.pop_back();
     }
-    // store this node to be deleted later
-    this->nodes.push_back(ret_val);
     return ret_val;
 }
 
@@ -123,7 +160,6 @@ Node* Parser::next_expr(){
     if (!this->node_stack.empty()){
         Node* expr = this->node_stack.front();
         this->node_stack.pop_front();
-        this->nodes.push_back(expr);
         return expr;
     }
     return nullptr;
@@ -131,13 +167,55 @@ Node* Parser::next_expr(){
 
 // parses all tokens into statements
 void Parser::parse(){
-    while (this->curr_pos < this->token_count)
-        parse_expr();
+    try{
+        while (this->has_tokens())
+            parse_expr();
+    }
+    catch (std::runtime_error& e){
+        this->throw_located(e);
+    }
+    // make room for every variable that was declared
+    this->env.reserve(this->global_scope.frame_size());
+}
+
+/*
+    parses the stream until the next top-level statement is complete and returns it, or nullptr once the source runs out.
+    A statement is complete when a break is reached outside of any block, so unlike parse, an operator at the start of a
+    line can't continue the statement on the line before it
+*/
+Node* Parser::parse_next(){
+    if (this->node_stack.empty()){
+        try{
+            while (this->has_tokens()){
+                this->parse_expr();
+                if (this->block_stack.empty() && !this->node_stack.empty() && this->tokens[this->curr_pos - 1].type == Break)
+                    break;
+            }
+        }
+        catch (std::runtime_error& e){
+            this->throw_located(e);
+        }
+        this->env.reserve(this->global_scope.frame_size());
+    }
+    return this->next_expr();
+}
+
+// frees the nodes and tokens of every streamed statement once all of them have been returned by parse_next
+void Parser::release(){
+    if (!this->stream || !this->node_stack.empty() || !this->block_stack.empty())
+        return;
+    this->arena.reset();
+    this->code_heap.reset();
+    this->tokens.erase(this->tokens.begin(), this->tokens.begin() + this->curr_pos);
+    this->consumed += this->curr_pos;
+    this->curr_pos = 0;
+    this->token_count = this->tokens.size();
+    this->stream->release(this->consumed);
 }
 
 // parses tokens until a complete statement is formed
 void Parser::parse_expr(){
-    while (this->curr_pos < this->token_count){
+    while (this->has_tokens()){
         Token curr_token = this->tokens[this->curr_pos];
         int int_lit, init_count;
         double float_lit;
@@ -151,9 +229,10 @@ void Parser::parse_expr(){
         EvalBlockNode* eval_block;
         VarNode* var_node;
         SymbolTable* sym_table;
+        const Symbol* symbol;
         PrintNode* print_node;
         TokenType op;
-        std::string sym;
+        std::string_view sym;
         Token interior;
         switch (curr_token.type){
             // data types
@@ -161,13 +240,13 @@ void Parser::parse_expr(){
             case TypeFloat:
             case TypeChar:
             case TypeBool:
-                this->push_node(new TypeNode(TYPE_MAP[curr_token.type]));
+                this->push_node(this->make_node<TypeNode>(curr_token, TYPE_MAP.at(curr_token.type)));
                 this->curr_pos++;
                 continue;
             // literals
             case IntLiteral:
-                int_lit = std::stoi(curr_token.txt);
-                this->push_node(new LiteralNode(Value::create(INT, int_lit)));
+                int_lit = parse_int(curr_token);
+                this->push_node(this->make_node<LiteralNode>(curr_token, Value::create(INT, int_lit)));
                 this->curr_pos++;
                 if (this->return_next){
                     this->return_next = false;
@@ -175,8 +254,8 @@ void Parser::parse_expr(){
                 }
                 break;
             case FloatLiteral:
-                float_lit = std::stod(curr_token.txt);
-                this->push_node(new LiteralNode(Value::create(FLOAT, float_lit)));
+                float_lit = parse_float(curr_token);
+                this->push_node(this->make_node<LiteralNode>(curr_token, Value::create(FLOAT, float_lit)));
                 this->curr_pos++;
                 if (this->return_next){
                     this->return_next = false;
@@ -185,7 +264,7 @@ void Parser::parse_expr(){
                 break;
             case CharLiteral:
                 char_lit = curr_token.txt[0];
-                this->push_node(new LiteralNode(Value::create(CHAR, char_lit)));
+                this->push_node(this->make_node<LiteralNode>(curr_token, Value::create(CHAR, char_lit)));
                 this->curr_pos++;
                 if (this->return_next){
                     this->return_next = false;
@@ -194,7 +273,7 @@ void Parser::parse_expr(){
                 break;
             case BoolLiteral:
                 bool_lit = (curr_token.txt == "true") ? true : false;
-                this->push_node(new LiteralNode(Value::create(BOOL, bool_lit)));
+                this->push_node(this->make_node<LiteralNode>(curr_token, Value::create(BOOL, bool_lit)));
                 this->curr_pos++;
                 if (this->return_next){
                     this->return_next = false;
@@ -204,10 +283,12 @@ void Parser::parse_expr(){
             // Block Nodes
             case Block:
                 // create a new block and push it onto the stack
-                sym_table = new SymbolTable(this->curr_scope);
-                new_block = new BlockNode(sym_table);
-                this->push_block(new_block);
+                sym_table = this->arena.make<SymbolTable>(this->curr_scope, &this->arena);
+                new_block = this->make_node<BlockNode>(curr_token, sym_table, &this->arena);
                 this->curr_pos++;
+                if (this->defer_block(new_block))
+                    return;
+                this->push_block(new_block);
                 continue;
             case CondBlock:
             case LoopBlock:
@@ -218,12 +299,14 @@ void Parser::parse_expr(){
                     throw std::runtime_error("syntax error: expected expression (1)");
                 condition = this->pop_node();
                 // create the block
-                sym_table = new SymbolTable(this->curr_scope);
+                sym_table = this->arena.make<SymbolTable>(this->curr_scope, &this->arena);
                 if (curr_token.type == CondBlock) {
-                    new_block = new CondBlockNode(sym_table, condition);
+                    new_block = this->make_node<CondBlockNode>(curr_token, sym_table, condition, &this->arena);
                 } else {
-                    new_block = new LoopBlockNode(sym_table, condition);
+                    new_block = this->make_node<LoopBlockNode>(curr_token, sym_table, condition, &this->arena, this->jit ? &this->code_heap : nullptr);
                 }
+                if (this->defer_block(new_block))
+                    return;
                 this->push_block(new_block);
                 break;
             case ElseBlock:
@@ -231,12 +314,12 @@ void Parser::parse_expr(){
                 if (this->curr_block->block_type() != Conditional)
                     throw std::runtime_error("syntax error: unexpected token \"else\"");
                 conditional = static_cast<CondBlockNode*>(this->curr_block);
-                conditional->set_else(new BlockNode(this->curr_scope->get_parent())); // this doesn't leak because the conditional block free's the else clause's memeory
+                conditional->set_else(this->make_node<BlockNode>(curr_token, this->curr_scope->get_parent(), &this->arena));
                 break;
             case EvalBlock:
                 init_count = this->eval_count;
                 this->eval_count++;
-                eval_block = new EvalBlockNode;
+                eval_block = this->make_node<EvalBlockNode>(curr_token, &this->arena);
                 // read the next singular expression, and assume the next is a closing paren.
                 this->curr_pos++;
                 while (this->eval_count != init_count){
@@ -258,7 +341,6 @@ void Parser::parse_expr(){
                 this->curr_pos++;
                 // pop the current block off the stack and append it to the node stack
                 this->block_stack.pop();
-                this->scopes.push_back(this->scope_stack.top());
                 this->scope_stack.pop();
                 to_copy = this->curr_block;
                 if (this->block_stack.empty()){
@@ -279,13 +361,13 @@ void Parser::parse_expr(){
             // Binary Expressions
             case And:
             case Or:
-                parse_bin_expr(BoolLogic_N, OPERATOR_MAP[curr_token.type]);
+                parse_bin_expr(BoolLogic_N, OPERATOR_MAP.at(curr_token.type));
                 break;
             case Eq:
             case Neq:
             case Greater:
             case Less:
-                parse_bin_expr(Comp_N, OPERATOR_MAP[curr_token.type]);
+                parse_bin_expr(Comp_N, OPERATOR_MAP.at(curr_token.type));
                 break;
             case Add:
             case Sub:
@@ -293,7 +375,7 @@ void Parser::parse_expr(){
             case Div:
             case Mod:
             case Pow:
-                parse_bin_expr(Arith_N, OPERATOR_MAP[curr_token.type]);
+                parse_bin_expr(Arith_N, OPERATOR_MAP.at(curr_token.type));
                 break;
             // Variable-related nodes
             case Defn:
@@ -313,9 +395,8 @@ void Parser::parse_expr(){
                 var_type = static_cast<TypeNode*>(lhs);
                 var_name = static_cast<SymNode*>(rhs);
                 sym = var_name->get_sym();
-                this->curr_scope->create(sym, var_type->get_type());
                 // push the newly created variable onto the node stack
-                new_node = new VarNode(curr_scope->get(sym), false);
+                new_node = this->make_node<VarNode>(curr_token, &this->env, this->curr_scope->create(sym, var_type->get_type()), false);
                 this->push_node(new_node);
                 continue;
             case Asgn:
@@ -324,7 +405,7 @@ void Parser::parse_expr(){
             case Print:
             case Println:
                 curr_pos++;
-                print_node = new PrintNode(curr_token.type == Println);
+                print_node = this->make_node<PrintNode>(curr_token, curr_token.type == Println, &this->arena, this->output);
                 init_count = this->stack_size();
                 // read every node to the end of the statement as an argument
                 this->return_next = false;
@@ -334,18 +415,18 @@ void Parser::parse_expr(){
                 this->push_node(print_node);
                 break;
             case ParamOpen:
-                if ((curr_pos + 3) > this->token_count ||  this->tokens[curr_pos + 2].type !=  ParamClose)
+                if (!this->has_tokens(3) || this->tokens[curr_pos + 2].type != ParamClose)
                     throw std::runtime_error("syntax error: expected token ']");
                 interior = this->tokens[curr_pos + 1];
                 switch (interior.type){
                     case IntLiteral:
-                        new_node = new ParamNode(ParamType::Index, std::stoi(interior.txt));
+                        new_node = this->make_node<ParamNode>(curr_token, ParamType::Index, parse_int(interior));
                         break;
                     case TypeInt:
                     case TypeFloat:
                     case TypeBool:
                     case TypeChar:
-                        new_node = new ParamNode(ParamType::Type, TYPE_STR_MAP[curr_token.txt]);
+                        new_node = this->make_node<ParamNode>(curr_token, ParamType::Type, TYPE_MAP.at(interior.type));
                         break;
                     default:
                         throw std::runtime_error("syntax error: invalid parameter");
@@ -360,13 +441,14 @@ void Parser::parse_expr(){
                 break;
             case Sym:
                 curr_pos++;
-                if (curr_scope->exists(curr_token.txt)){
-                    var_node = new VarNode(this->curr_scope->get(curr_token.txt), true);
+                symbol = this->curr_scope->lookup(curr_token.txt);
+                if (symbol){
+                    var_node = this->make_node<VarNode>(curr_token, &this->env, *symbol, true);
                     this->push_node(var_node);
                     if (this->return_next)
                         return;
                 } else {
-                    new_node = new SymNode(curr_token.txt);
+                    new_node = this->make_node<SymNode>(curr_token, this->arena.copy_str(curr_token.txt));
                     this->push_node(new_node);
                     return;
                 }
@@ -376,11 +458,15 @@ void Parser::parse_expr(){
                 return;
 
         }
+        // when streaming, stop as soon as a top-level statement is complete so it can be evaluated and freed
+        if (this->stream && this->block_stack.empty() && !this->eval_count && this->tokens[this->curr_pos - 1].type == Break)
+            return;
     }
 }
 
 // this function parses a binary expression (such as comparison or arithmetic) and pushes it to the top of the node stack
 void Parser::parse_bin_expr(NodeType type, Operator op){
+    Token curr_token = this->tokens[this->curr_pos];
     curr_pos++;
     this->return_next = (type != Asgn_N); // this should always read the next singular expresssion, unless we're assigning to a variable
     this->parse_expr();
@@ -390,22 +476,87 @@ void Parser::parse_bin_expr(NodeType type, Operator op){
     Node* lhs = this->pop_node();
     switch (type){
     case Arith_N:
-        this->push_node(new ArithNode(lhs, rhs, op));
+        this->push_node(this->make_node<ArithNode>(curr_token, lhs, rhs, op, &this->arena));
         break;
     case Comp_N:
-        this->push_node(new CompNode(lhs, rhs, op));
+        this->push_node(this->make_node<CompNode>(curr_token, lhs, rhs, op, &this->arena));
         break;
     case BoolLogic_N:
-        this->push_node(new BoolLogicNode(lhs, rhs, op));
+        this->push_node(this->make_node<BoolLogicNode>(curr_token, lhs, rhs, op, &this->arena));
         break;
     case Asgn_N:
         if (lhs->get_node_type() != Var_N && lhs->get_node_type() != Ptr_N)
             throw std::runtime_error("syntax error: cannot assign to expression");
-        this->push_node(new AsgnNode(static_cast<ValNode*>(lhs), rhs));
+        this->push_node(this->make_node<AsgnNode>(curr_token, static_cast<ValNode*>(lhs), rhs, &this->arena));
         break;
     }
 }
 
+/*
+    in lazy mode, skips the body of a block that has just been opened, leaving it to be parsed the first time the block is needed.
+    The body's extent is found by only matching the openers and ends of the blocks nested in it, so syntax errors within it aren't
+    reported until it's parsed. Returns false if the block must be parsed now, such as when it has no end
+*/
+bool Parser::defer_block(BlockNode* block){
+    if (!this->lazy || this->eval_count || this->return_next)
+        return false;
+    int depth = 0;
+    bool has_else = false;
+    for (size_t pos = this->curr_pos; this->has_tokens(pos - this->curr_pos + 1); pos++){
+        switch (this->tokens[pos].type){
+            case Block:
+            case CondBlock:
+            case LoopBlock:
+                depth++;
+                break;
+            case ElseBlock:
+                has_else |= depth == 0;
+                break;
+            case BlockEnd:
+                if (depth-- > 0)
+                    break;
+                block->defer(this, this->curr_pos);
+                if (has_else && block->block_type() == Conditional)
+                    static_cast<CondBlockNode*>(block)->set_deferred_else();
+                this->curr_pos = pos + 1;
+                this->push_node(block);
+                return true;
+            default:
+                break;
+        }
+    }
+    return false;
+}
+
+/*
+    parses the body of a deferred block, along with the end that closes it, exactly as it would have been parsed where it appears.
+    This can only happen between statements, and blocks nested in the body are deferred in turn
+*/
+void Parser::parse_deferred(BlockNode* block, size_t pos){
+    size_t saved_pos = this->curr_pos;
+    this->curr_pos = pos;
+    this->push_block(block);
+    try{
+        while (!this->block_stack.empty() && this->has_tokens())
+            this->parse_expr();
+        if (!this->block_stack.empty())
+            throw std::runtime_error("syntax error: expected \"end\"");
+    }
+    catch (std::runtime_error& e){
+        this->curr_block = nullptr;
+        this->curr_scope = &this->global_scope;
+        this->block_stack = {};
+        this->scope_stack = {};
+        this->eval_count = 0;
+        this->return_next = false;
+        this->throw_located(e);
+    }
+    // the closed block was pushed to the top level, but it's already where it belongs
+    this->node_stack.pop_back();
+    this->curr_pos = saved_pos;
+    this->env.reserve(this->global_scope.frame_size());
+}
+
 // this function creates a new block, and sets it to the current scope 
 void Parser::push_block(BlockNode* block){
     this->curr_block = block;
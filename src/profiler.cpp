@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <string>
+
+#include "../inc/profiler.h"
+
+thread_local constinit Profiler* active_profiler = nullptr;
+
+// the current time in nanoseconds
+static uint64_t now(){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+// splits a source into its lines, without their leading indentation
+static std::vector<std::string_view> source_lines(std::string_view source){
+    std::vector<std::string_view> lines;
+    size_t start = 0;
+    while (start <= source.size()){
+        size_t end = std::min(source.find('\n', start), source.size());
+        std::string_view line = source.substr(start, end - start);
+        size_t first = line.find_first_not_of(" \t\r");
+        lines.push_back(first == std::string_view::npos ? std::string_view() : line.substr(first));
+        start = end + 1;
+    }
+    return lines;
+}
+
+// evaluates a child node for Node::eval_child while a profiler is active on this thread
+Value profile_eval(Node*& child){
+    Profiler* profiler = active_profiler;
+    bool entered = profiler->enter(child->get_line());
+    Value val = child->eval();
+    if (child->replacement){
+        Node* next = child->replacement;
+        child->replacement = nullptr;
+        child = next;
+    }
+    // if evaluation threw instead, the frame is closed by the ProfilerScope
+    if (entered)
+        profiler->leave();
+    return val;
+}
+
+/* PROFILER */
+Profiler::Profiler(){
+    this->clear();
+}
+// forgets everything that's been recorded
+void Profiler::clear(){
+    this->lines.clear();
+    this->open.clear();
+    this->frames.clear();
+    this->stacks.assign(1, Stack{0, 0});
+    this->stack_ids.clear();
+}
+LineProfile& Profiler::line_profile(uint32_t line){
+    if (line >= this->lines.size()){
+        size_t old_size = this->lines.size();
+        this->lines.resize(line + 1);
+        this->open.resize(line + 1);
+        for (size_t i = old_size; i < this->lines.size(); i++)
+            this->lines[i].line = i;
+    }
+    return this->lines[line];
+}
+/*
+    counts an evaluation of a node on a line, and opens a frame for it if evaluation has moved there from another line. Nodes
+    the parser didn't create have no line, and are counted as part of the line that evaluated them. Returns whether a frame was
+    opened, which must then be closed by leave
+*/
+bool Profiler::enter(uint32_t line){
+    if (!line)
+        return false;
+    this->line_profile(line).evals++;
+    if (!this->frames.empty() && this->frames.back().line == line)
+        return false;
+    uint32_t parent = this->frames.empty() ? 0 : this->frames.back().stack;
+    auto [stack, inserted] = this->stack_ids.try_emplace(static_cast<uint64_t>(parent) << 32 | line, this->stacks.size());
+    if (inserted)
+        this->stacks.push_back(Stack{line, parent});
+    this->open[line]++;
+    this->frames.push_back(Frame{line, stack->second, now()});
+    return true;
+}
+// closes the innermost frame, adding its time to its line, its stack and the frame that evaluated it
+void Profiler::leave(){
+    Frame frame = this->frames.back();
+    this->frames.pop_back();
+    uint64_t elapsed = now() - frame.start;
+    uint64_t exclusive = elapsed - std::min(frame.children, elapsed);
+    LineProfile& profile = this->lines[frame.line];
+    profile.exclusive += exclusive;
+    this->stacks[frame.stack].exclusive += exclusive;
+    if (--this->open[frame.line] == 0)
+        profile.inclusive += elapsed;
+    if (!this->frames.empty())
+        this->frames.back().children += elapsed;
+}
+// closes frames until only the given number are open, which is how frames left open by an error are closed
+void Profiler::unwind(size_t depth){
+    while (this->frames.size() > depth)
+        this->leave();
+}
+
+// returns every line that was evaluated, the lines that took the most time themselves first
+std::vector<LineProfile> Profiler::hot_lines(){
+    std::vector<LineProfile> hot;
+    for (const LineProfile& profile : this->lines){
+        if (profile.evals)
+            hot.push_back(profile);
+    }
+    std::sort(hot.begin(), hot.end(), [](const LineProfile& lhs, const LineProfile& rhs){
+        return lhs.exclusive != rhs.exclusive ? lhs.exclusive > rhs.exclusive : lhs.line < rhs.line;
+    });
+    return hot;
+}
+// writes a table of the hottest lines of a source, with the share of the total time each took itself
+void Profiler::report(std::ostream& out, std::string_view source, size_t count){
+    std::vector<LineProfile> hot = this->hot_lines();
+    std::vector<std::string_view> text = source_lines(source);
+    uint64_t total = 0;
+    for (const LineProfile& profile : hot)
+        total += profile.exclusive;
+    out << "  line        evals    incl ms    excl ms  excl %  source\n";
+    std::ios_base::fmtflags flags = out.flags();
+    out << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < std::min(count, hot.size()); i++){
+        const LineProfile& profile = hot[i];
+        out << std::setw(6) << profile.line << std::setw(13) << profile.evals << std::setw(11) << profile.inclusive / 1e6
+            << std::setw(11) << profile.exclusive / 1e6 << std::setw(7) << std::setprecision(1)
+            << (total ? 100.0 * profile.exclusive / total : 0) << "%  " << std::setprecision(3)
+            << (profile.line <= text.size() ? text[profile.line - 1] : std::string_view()) << '\n';
+    }
+    out.flags(flags);
+}
+/*
+    writes every stack of lines with the time spent in its innermost line, in the folded format flame graph tools read: one
+    stack per line, its frames separated by semicolons, followed by a space and the time in nanoseconds
+*/
+void Profiler::write_folded(std::ostream& out, std::string_view source){
+    std::vector<std::string_view> text = source_lines(source);
+    std::vector<std::string> labels(this->stacks.size());
+    for (size_t i = 1; i < this->stacks.size(); i++){
+        const Stack& stack = this->stacks[i];
+        std::string label = std::to_string(stack.line) + ": ";
+        label += stack.line <= text.size() ? text[stack.line - 1] : std::string_view();
+        // semicolons would split the frame
+        std::replace(label.begin(), label.end(), ';', ',');
+        // a stack's parent always comes before it, so its label is already complete
+        labels[i] = stack.parent ? labels[stack.parent] + ";" + label : label;
+        if (stack.exclusive)
+            out << labels[i] << ' ' << stack.exclusive << '\n';
+    }
+}
+
+/* PROFILER SCOPE */
+ProfilerScope::ProfilerScope(Profiler* profiler){
+    this->profiler = profiler;
+    this->previous = active_profiler;
+    if (profiler){
+        this->depth = profiler->frames.size();
+        active_profiler = profiler;
+    }
+}
+ProfilerScope::~ProfilerScope(){
+    if (this->profiler){
+        this->profiler->unwind(this->depth);
+        active_profiler = this->previous;
+    }
+}
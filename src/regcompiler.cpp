@@ -0,0 +1,384 @@
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../inc/regcompiler.h"
+#include "../inc/regvm.h"
+#include "../inc/nodes.hpp"
+#include "../inc/block.h"
+
+// returns whether evaluating a node can change the value of a variable
+bool has_side_effects(Node* node){
+    switch (node->get_node_type()){
+        case Asgn_N:
+            return true;
+        case Comp_N:
+            return has_side_effects(static_cast<CompNode*>(node)->get_lhs()) || has_side_effects(static_cast<CompNode*>(node)->get_rhs());
+        case BoolLogic_N:
+            return has_side_effects(static_cast<BoolLogicNode*>(node)->get_lhs()) || has_side_effects(static_cast<BoolLogicNode*>(node)->get_rhs());
+        case Arith_N:
+            return has_side_effects(static_cast<ArithNode*>(node)->get_lhs()) || has_side_effects(static_cast<ArithNode*>(node)->get_rhs());
+        case Print_N:
+            return false;
+        // blocks are assumed to change variables, rather than searching them
+        case Block_N:
+            return true;
+        default:
+            return false;
+    }
+}
+
+RegCompiler::RegCompiler(RegProgram& program): program(program){
+    this->program.clear();
+}
+
+// queues a top-level statement, statements are compiled together once finish is called
+void RegCompiler::add_statement(Node* statement){
+    this->statements.push_back(statement);
+}
+
+// compiles every queued statement, the program evaluates to the value of the last one
+void RegCompiler::finish(){
+    // every variable and constant needs a register before any temporaries can be allocated
+    for (Node* statement : this->statements)
+        this->collect(statement);
+    this->const_base = this->program.vars.size();
+    this->next_temp = this->const_base + this->program.constants.size();
+    this->program.register_count = this->next_temp;
+    uint32_t base = this->next_temp;
+    uint32_t result = NO_REGISTER;
+    for (Node* statement : this->statements){
+        this->next_temp = base;
+        result = this->compile(statement);
+    }
+    if (result == NO_REGISTER){
+        result = this->alloc_temp();
+        this->emit(RegNull, result);
+    }
+    this->emit(RegHalt, result);
+}
+
+// assigns registers to every variable and literal in a node
+void RegCompiler::collect(Node* node){
+    switch (node->get_node_type()){
+        case Literal_N:
+            this->const_regs[node] = this->program.constants.size();
+            this->program.constants.push_back(static_cast<LiteralNode*>(node)->get_value());
+            break;
+        case Var_N:
+            this->var_register(static_cast<VarNode*>(node));
+            break;
+        case Asgn_N:
+            this->collect(static_cast<AsgnNode*>(node)->get_lhs());
+            this->collect(static_cast<AsgnNode*>(node)->get_rhs());
+            break;
+        case Comp_N:
+            this->collect(static_cast<CompNode*>(node)->get_lhs());
+            this->collect(static_cast<CompNode*>(node)->get_rhs());
+            break;
+        case BoolLogic_N:
+            this->collect(static_cast<BoolLogicNode*>(node)->get_lhs());
+            this->collect(static_cast<BoolLogicNode*>(node)->get_rhs());
+            break;
+        case Arith_N:
+            this->collect(static_cast<ArithNode*>(node)->get_lhs());
+            this->collect(static_cast<ArithNode*>(node)->get_rhs());
+            break;
+        case Print_N:
+            for (Node* arg : static_cast<PrintNode*>(node)->get_args())
+                this->collect(arg);
+            break;
+        case Block_N: {
+            BlockNode* block = static_cast<BlockNode*>(node);
+            switch (block->block_type()){
+                case Eval:
+                    this->collect(static_cast<EvalBlockNode*>(block)->get_body());
+                    return;
+                case Conditional:
+                    this->collect(static_cast<CondBlockNode*>(block)->get_condition());
+                    if (static_cast<CondBlockNode*>(block)->get_else())
+                        this->collect(static_cast<CondBlockNode*>(block)->get_else());
+                    break;
+                case Loop:
+                    this->collect(static_cast<LoopBlockNode*>(block)->get_condition());
+                    break;
+                default:
+                    break;
+            }
+            for (Node* statement : block->get_statements())
+                this->collect(statement);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+/*
+    compiles a node and returns the register holding its value. Variables and literals are used in place, anything else is
+    written to the target register if one is given, or a new temporary otherwise
+*/
+uint32_t RegCompiler::compile(Node* node, uint32_t target){
+    uint32_t dst;
+    switch (node->get_node_type()){
+        case Literal_N:
+            return this->const_base + this->const_regs[node];
+        case Var_N: {
+            VarNode* var = static_cast<VarNode*>(node);
+            if (var->is_initialized())
+                return this->var_register(var);
+            // a declaration is only ever evaluated on its own before it has been assigned to
+            dst = this->alloc_temp();
+            this->emit(RegTrap, this->add_message("cannot evaluate an unitialized variable"));
+            return dst;
+        }
+        case Asgn_N: {
+            AsgnNode* asgn = static_cast<AsgnNode*>(node);
+            if (asgn->get_lhs()->get_node_type() != Var_N){
+                dst = this->compile(asgn->get_rhs());
+                this->emit(RegTrap, this->add_message("pointers are not supported by the bytecode backend"));
+                return dst;
+            }
+            VarNode* var = static_cast<VarNode*>(asgn->get_lhs());
+            dst = this->var_register(var);
+            // proven assignments can write straight into the variable's register
+            if (asgn->is_checked())
+                this->compile_into(asgn->get_rhs(), dst);
+            else
+                this->emit(RegStore, dst, this->compile(asgn->get_rhs()), var->get_type());
+            return dst;
+        }
+        case Comp_N: {
+            CompNode* comp = static_cast<CompNode*>(node);
+            std::optional<ValueType> type = comp->is_checked() ? this->static_type(comp->get_lhs()) : std::nullopt;
+            RegOp op = RegComp;
+            if (type == INT){
+                switch (comp->op){
+                    case LessThan: op = RegLtI; break;
+                    case GreatherThan: op = RegGtI; break;
+                    case Equal: op = RegEqI; break;
+                    case NEqual: op = RegNeI; break;
+                    default: break;
+                }
+            }
+            else if (type == FLOAT && (comp->op == LessThan || comp->op == GreatherThan))
+                op = (comp->op == LessThan) ? RegLtF : RegGtF;
+            return this->compile_binary(comp->get_lhs(), comp->get_rhs(), op, comp->op, target);
+        }
+        case BoolLogic_N: {
+            BoolLogicNode* logic = static_cast<BoolLogicNode*>(node);
+            RegOp op = RegLogic;
+            if (logic->is_checked())
+                op = (logic->get_op() == LogicAnd) ? RegAnd : RegOr;
+            return this->compile_binary(logic->get_lhs(), logic->get_rhs(), op, logic->get_op(), target);
+        }
+        case Arith_N: {
+            ArithNode* arith = static_cast<ArithNode*>(node);
+            std::optional<ValueType> type = arith->is_checked() ? this->static_type(arith->get_lhs()) : std::nullopt;
+            RegOp op = RegArith;
+            if (type == INT){
+                switch (arith->get_op()){
+                    case ArithAdd: op = RegAddI; break;
+                    case ArithSub: op = RegSubI; break;
+                    case ArithMul: op = RegMulI; break;
+                    case ArithDiv: op = RegDivI; break;
+                    case ArithMod: op = RegModI; break;
+                    default: break;
+                }
+            }
+            else if (type == FLOAT){
+                switch (arith->get_op()){
+                    case ArithAdd: op = RegAddF; break;
+                    case ArithSub: op = RegSubF; break;
+                    case ArithMul: op = RegMulF; break;
+                    case ArithDiv: op = RegDivF; break;
+                    default: break;
+                }
+            }
+            return this->compile_binary(arith->get_lhs(), arith->get_rhs(), op, arith->get_op(), target);
+        }
+        case Print_N:
+            return this->compile_print(static_cast<PrintNode*>(node), target);
+        case Block_N: {
+            BlockNode* block = static_cast<BlockNode*>(node);
+            switch (block->block_type()){
+                case Eval:
+                    return this->compile(static_cast<EvalBlockNode*>(block)->get_body(), target);
+                case Conditional:
+                    return this->compile_cond(static_cast<CondBlockNode*>(block), target);
+                case Loop:
+                    return this->compile_loop(static_cast<LoopBlockNode*>(block));
+                default:
+                    dst = (target != NO_REGISTER) ? target : this->alloc_temp();
+                    this->compile_statements(block, dst);
+                    return dst;
+            }
+        }
+        // pointers don't live in the environment, so they can't be addressed by the VM yet
+        case Ptr_N:
+            dst = this->alloc_temp();
+            this->emit(RegTrap, this->add_message("pointers are not supported by the bytecode backend"));
+            return dst;
+        // type names, symbols and parameters all evaluate to null
+        default:
+            dst = (target != NO_REGISTER) ? target : this->alloc_temp();
+            this->emit(RegNull, dst);
+            return dst;
+    }
+}
+
+// compiles a node so that its value ends up in the given register
+void RegCompiler::compile_into(Node* node, uint32_t dst){
+    uint32_t src = this->compile(node, dst);
+    if (src != dst)
+        this->emit(RegMove, dst, src);
+}
+
+// compiles both operands of a binary expression, then the operation itself
+uint32_t RegCompiler::compile_binary(Node* lhs, Node* rhs, RegOp op, Operator generic_op, uint32_t target){
+    uint32_t base = this->next_temp;
+    uint32_t lhs_reg = this->compile(lhs);
+    // the left operand is read after the right one is evaluated, so a variable has to be copied if the right one may change it
+    if (lhs_reg < this->const_base && has_side_effects(rhs)){
+        uint32_t copy = this->alloc_temp();
+        this->emit(RegMove, copy, lhs_reg);
+        lhs_reg = copy;
+    }
+    uint32_t rhs_reg = this->compile(rhs);
+    // the operands are read before the result is written, so the result can reuse their registers
+    this->next_temp = base;
+    uint32_t dst = (target != NO_REGISTER) ? target : this->alloc_temp();
+    this->emit(op, dst, lhs_reg, rhs_reg, generic_op);
+    return dst;
+}
+
+// compiles the statements of a block, leaving the value of the last one in dst, or null if it has none
+void RegCompiler::compile_statements(BlockNode* block, uint32_t dst){
+    const std::pmr::vector<Node*>& statements = block->get_statements();
+    if (statements.empty()){
+        this->emit(RegNull, dst);
+        return;
+    }
+    uint32_t base = this->next_temp;
+    for (size_t i = 0; i < statements.size(); i++){
+        if (i == statements.size() - 1)
+            this->compile_into(statements[i], dst);
+        else
+            this->compile(statements[i]);
+        this->next_temp = base;
+    }
+}
+
+// compiles an if block, which evaluates to null if the condition is false and there is no else clause
+uint32_t RegCompiler::compile_cond(CondBlockNode* block, uint32_t target){
+    uint32_t dst = (target != NO_REGISTER) ? target : this->alloc_temp();
+    uint32_t base = this->next_temp;
+    size_t else_jump = this->emit(RegJumpFalse, this->compile_condition(block, block->get_condition()));
+    this->next_temp = base;
+    this->compile_statements(block, dst);
+    size_t end_jump = this->emit(RegJump);
+    this->program.code[else_jump].b = this->program.code.size();
+    if (block->get_else())
+        this->compile_statements(block->get_else(), dst);
+    else
+        this->emit(RegNull, dst);
+    this->program.code[end_jump].a = this->program.code.size();
+    return dst;
+}
+
+/*
+    compiles a while loop, which evaluates to the value of the last iteration, or null if it never ran. The condition is placed
+    after the body, so each iteration only needs a single jump
+*/
+uint32_t RegCompiler::compile_loop(LoopBlockNode* block){
+    // the result is written before the loop finishes, so it can't go straight to a target the body may read, compile_into moves it
+    uint32_t dst = this->alloc_temp();
+    this->emit(RegNull, dst);
+    size_t cond_jump = this->emit(RegJump);
+    uint32_t body_start = this->program.code.size();
+    this->compile_statements(block, dst);
+    this->program.code[cond_jump].a = this->program.code.size();
+    uint32_t base = this->next_temp;
+    this->emit(RegJumpTrue, this->compile_condition(block, block->get_condition()), body_start);
+    this->next_temp = base;
+    return dst;
+}
+
+// compiles the condition of an if or while block, checking it's a boolean unless the type checker has proven that
+uint32_t RegCompiler::compile_condition(BlockNode* block, Node* condition){
+    uint32_t cond_reg = this->compile(condition);
+    if (!block->is_checked())
+        this->emit(RegCheckBool, cond_reg);
+    return cond_reg;
+}
+
+// arguments are stored in reverse order by the parser, each one is printed as soon as it's evaluated
+uint32_t RegCompiler::compile_print(PrintNode* print_node, uint32_t target){
+    const std::pmr::vector<Node*>& args = print_node->get_args();
+    uint32_t base = this->next_temp;
+    for (int i = args.size() - 1; i >= 0; i--){
+        this->emit(RegPrint, this->compile(args[i]));
+        this->next_temp = base;
+    }
+    uint32_t dst = (target != NO_REGISTER) ? target : this->alloc_temp();
+    this->emit(RegPrintEnd, dst, print_node->has_newline());
+    return dst;
+}
+
+// returns the type an expression is known to evaluate to, or nullopt if it can't be determined without the type checker
+std::optional<ValueType> RegCompiler::static_type(Node* node){
+    switch (node->get_node_type()){
+        case Literal_N:
+            return static_cast<LiteralNode*>(node)->get_value().get_type();
+        case Var_N:
+            return static_cast<VarNode*>(node)->get_type();
+        case Asgn_N:
+            return static_cast<AsgnNode*>(node)->get_lhs()->get_type();
+        case Comp_N:
+        case BoolLogic_N:
+            return BOOL;
+        case Arith_N:
+            if (!node->is_checked())
+                return std::nullopt;
+            if (static_cast<ArithNode*>(node)->get_op() == ArithMod)
+                return INT;
+            return this->static_type(static_cast<ArithNode*>(node)->get_lhs());
+        case Block_N:
+            if (static_cast<BlockNode*>(node)->block_type() == Eval)
+                return this->static_type(static_cast<EvalBlockNode*>(node)->get_body());
+            return std::nullopt;
+        default:
+            return std::nullopt;
+    }
+}
+
+// returns the register of a variable, every reference to the same slot shares a register, just as it shares a slot
+uint32_t RegCompiler::var_register(VarNode* var){
+    uint64_t key = (static_cast<uint64_t>(var->get_depth()) << 32) | var->get_slot();
+    auto reg_itt = this->var_regs.find(key);
+    if (reg_itt != this->var_regs.end())
+        return reg_itt->second;
+    this->program.vars.push_back({var->get_depth(), var->get_slot(), var->get_type()});
+    uint32_t reg = this->program.vars.size() - 1;
+    this->var_regs[key] = reg;
+    return reg;
+}
+
+uint32_t RegCompiler::alloc_temp(){
+    uint32_t reg = this->next_temp++;
+    if (this->next_temp > this->program.register_count)
+        this->program.register_count = this->next_temp;
+    return reg;
+}
+
+// appends an instruction and returns its position, so jumps can be patched later
+size_t RegCompiler::emit(RegOp op, uint32_t a, uint32_t b, uint32_t c, uint32_t d){
+    this->program.code.push_back({op, a, b, c, d});
+    return this->program.code.size() - 1;
+}
+
+uint32_t RegCompiler::add_message(const std::string& msg){
+    this->program.messages.push_back(msg);
+    return this->program.messages.size() - 1;
+}
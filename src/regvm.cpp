@@ -0,0 +1,191 @@
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "../inc/regvm.h"
+#include "../inc/nodes.hpp"
+
+// empties the program, so it can be reused by the compiler
+void RegProgram::clear(){
+    this->code.clear();
+    this->vars.clear();
+    this->constants.clear();
+    this->messages.clear();
+    this->register_count = 0;
+    this->threaded = false;
+}
+
+// runs a program until it halts and returns its result, the program's variables are written back to the environment even on error
+Value RegVM::run(RegProgram& program, Environment& env){
+    this->regs.assign(program.register_count, Value(NULL_TYPE));
+    for (size_t i = 0; i < program.vars.size(); i++)
+        this->regs[i] = env.at(program.vars[i].depth, program.vars[i].slot);
+    for (size_t i = 0; i < program.constants.size(); i++)
+        this->regs[program.vars.size() + i] = program.constants[i];
+    Value result;
+    try{
+#ifdef NEBULA_COMPUTED_GOTO
+        if (this->dispatch == ThreadedDispatch)
+            result = this->execute<true>(program);
+        else
+            result = this->execute<false>(program);
+#else
+        result = this->execute<false>(program);
+#endif
+    }
+    catch (std::runtime_error&){
+        for (size_t i = 0; i < program.vars.size(); i++)
+            env.at(program.vars[i].depth, program.vars[i].slot) = std::move(this->regs[i]);
+        throw;
+    }
+    for (size_t i = 0; i < program.vars.size(); i++)
+        env.at(program.vars[i].depth, program.vars[i].slot) = std::move(this->regs[i]);
+    return result;
+}
+
+/*
+    the interpreter loop. Every handler is both a case of the switch and a label, when threaded, each handler jumps directly
+    to the handler of the next instruction rather than going back through the switch
+*/
+template <bool Threaded>
+Value RegVM::execute(RegProgram& program){
+    RegInstruction* code = program.code.data();
+    RegInstruction* ip = code;
+    Value* regs = this->regs.data();
+#ifdef NEBULA_COMPUTED_GOTO
+    // the handlers in the same order as RegOp
+    static const void* const HANDLERS[] = {
+        &&L_RegMove, &&L_RegNull, &&L_RegStore, &&L_RegArith, &&L_RegComp, &&L_RegLogic,
+        &&L_RegAddI, &&L_RegSubI, &&L_RegMulI, &&L_RegDivI, &&L_RegModI, &&L_RegLtI, &&L_RegGtI, &&L_RegEqI, &&L_RegNeI,
+        &&L_RegAddF, &&L_RegSubF, &&L_RegMulF, &&L_RegDivF, &&L_RegLtF, &&L_RegGtF, &&L_RegAnd, &&L_RegOr,
+        &&L_RegCheckBool, &&L_RegJump, &&L_RegJumpFalse, &&L_RegJumpTrue, &&L_RegPrint, &&L_RegPrintEnd, &&L_RegTrap, &&L_RegHalt
+    };
+    static_assert(sizeof(HANDLERS) / sizeof(HANDLERS[0]) == RegHalt + 1, "every op needs a handler");
+    if (Threaded && !program.threaded){
+        for (RegInstruction& instr : program.code)
+            instr.handler = HANDLERS[instr.op];
+        program.threaded = true;
+    }
+    #define VM_CASE(op) case op: L_##op
+    #define VM_NEXT() do {if constexpr (Threaded) goto *ip->handler; else goto dispatch;} while (0)
+#else
+    #define VM_CASE(op) case op
+    #define VM_NEXT() goto dispatch
+#endif
+    #define INT_OP(expr) regs[ip->a].set(INT, static_cast<int>(expr)); ip++; VM_NEXT()
+    #define FLOAT_OP(expr) regs[ip->a].set(FLOAT, static_cast<double>(expr)); ip++; VM_NEXT()
+    #define BOOL_OP(expr) regs[ip->a].set(BOOL, static_cast<bool>(expr)); ip++; VM_NEXT()
+    #define INT_B regs[ip->b].as<int>()
+    #define INT_C regs[ip->c].as<int>()
+    #define FLOAT_B regs[ip->b].as<double>()
+    #define FLOAT_C regs[ip->c].as<double>()
+#ifdef NEBULA_COMPUTED_GOTO
+// threaded code jumps straight between handlers, so only the switch based loop comes back here
+dispatch: __attribute__((unused));
+#else
+dispatch:
+#endif
+    switch (ip->op){
+        VM_CASE(RegMove):
+            regs[ip->a] = regs[ip->b];
+            ip++;
+            VM_NEXT();
+        VM_CASE(RegNull):
+            regs[ip->a] = Value(NULL_TYPE);
+            ip++;
+            VM_NEXT();
+        VM_CASE(RegStore):
+            if (regs[ip->b].get_type() != static_cast<ValueType>(ip->c))
+                throw std::runtime_error("cannot assign a variable to a value of a different type");
+            regs[ip->a] = regs[ip->b];
+            ip++;
+            VM_NEXT();
+        VM_CASE(RegArith):
+            regs[ip->a] = ArithNode::apply(static_cast<Operator>(ip->d), regs[ip->b], regs[ip->c]);
+            ip++;
+            VM_NEXT();
+        VM_CASE(RegComp):
+            regs[ip->a] = CompNode::apply(static_cast<Operator>(ip->d), regs[ip->b], regs[ip->c]);
+            ip++;
+            VM_NEXT();
+        VM_CASE(RegLogic):
+            regs[ip->a] = BoolLogicNode::apply(static_cast<Operator>(ip->d), regs[ip->b], regs[ip->c]);
+            ip++;
+            VM_NEXT();
+        VM_CASE(RegAddI):
+            INT_OP(INT_B + INT_C);
+        VM_CASE(RegSubI):
+            INT_OP(INT_C - INT_B);
+        VM_CASE(RegMulI):
+            INT_OP(INT_B * INT_C);
+        VM_CASE(RegDivI):
+            if (INT_B == 0)
+                throw std::runtime_error("cannot divide by zero");
+            INT_OP(INT_C / INT_B);
+        VM_CASE(RegModI):
+            if (INT_B == 0)
+                throw std::runtime_error("cannot divide by zero");
+            INT_OP(INT_C % INT_B);
+        VM_CASE(RegLtI):
+            BOOL_OP(INT_B < INT_C);
+        VM_CASE(RegGtI):
+            BOOL_OP(INT_B > INT_C);
+        VM_CASE(RegEqI):
+            BOOL_OP(INT_B == INT_C);
+        VM_CASE(RegNeI):
+            BOOL_OP(INT_B != INT_C);
+        VM_CASE(RegAddF):
+            FLOAT_OP(FLOAT_B + FLOAT_C);
+        VM_CASE(RegSubF):
+            FLOAT_OP(FLOAT_C - FLOAT_B);
+        VM_CASE(RegMulF):
+            FLOAT_OP(FLOAT_B * FLOAT_C);
+        VM_CASE(RegDivF):
+            FLOAT_OP(FLOAT_C / FLOAT_B);
+        VM_CASE(RegLtF):
+            BOOL_OP(FLOAT_B < FLOAT_C);
+        VM_CASE(RegGtF):
+            BOOL_OP(FLOAT_B > FLOAT_C);
+        VM_CASE(RegAnd):
+            BOOL_OP(regs[ip->b].as<bool>() && regs[ip->c].as<bool>());
+        VM_CASE(RegOr):
+            BOOL_OP(regs[ip->b].as<bool>() || regs[ip->c].as<bool>());
+        VM_CASE(RegCheckBool):
+            if (regs[ip->a].get_type() != BOOL)
+                throw std::runtime_error("invalid conditional");
+            ip++;
+            VM_NEXT();
+        VM_CASE(RegJump):
+            ip = code + ip->a;
+            VM_NEXT();
+        VM_CASE(RegJumpFalse):
+            ip = regs[ip->a].as<bool>() ? ip + 1 : code + ip->b;
+            VM_NEXT();
+        VM_CASE(RegJumpTrue):
+            ip = regs[ip->a].as<bool>() ? code + ip->b : ip + 1;
+            VM_NEXT();
+        VM_CASE(RegPrint):
+            this->output->write(regs[ip->a]);
+            ip++;
+            VM_NEXT();
+        VM_CASE(RegPrintEnd):
+            this->output->end_print(ip->b);
+            regs[ip->a] = Value(NULL_TYPE);
+            ip++;
+            VM_NEXT();
+        VM_CASE(RegTrap):
+            throw std::runtime_error(program.messages[ip->a]);
+        VM_CASE(RegHalt):
+            return regs[ip->a];
+    }
+    #undef VM_CASE
+    #undef VM_NEXT
+    #undef INT_OP
+    #undef FLOAT_OP
+    #undef BOOL_OP
+    #undef INT_B
+    #undef INT_C
+    #undef FLOAT_B
+    #undef FLOAT_C
+    return Value(NULL_TYPE);
+}
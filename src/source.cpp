@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../inc/source.h"
+
+SourceFile::~SourceFile(){
+    this->close();
+}
+
+// opens and maps the given file, returns false if it can't be read
+bool SourceFile::open(const std::string& file_path){
+    this->close();
+    int fd = ::open(file_path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || S_ISDIR(info.st_mode)){
+        ::close(fd);
+        return false;
+    }
+    if (S_ISREG(info.st_mode) && info.st_size > 0){
+        void* addr = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED){
+            // the lexer reads the file front to back exactly once
+            madvise(addr, info.st_size, MADV_SEQUENTIAL);
+            this->data = static_cast<const char*>(addr);
+            this->size = info.st_size;
+            this->mapped = true;
+            ::close(fd);
+            return true;
+        }
+        this->buffer.reserve(info.st_size);
+    }
+    bool res = this->read_stream(fd);
+    ::close(fd);
+    return res;
+}
+
+// reads everything left in a file descriptor into the buffer, growing it geometrically
+bool SourceFile::read_stream(int fd){
+    size_t len = 0;
+    this->buffer.resize(std::max<size_t>(this->buffer.capacity(), 4096));
+    while (true){
+        if (len == this->buffer.size())
+            this->buffer.resize(this->buffer.size() * 2);
+        ssize_t count = ::read(fd, &this->buffer[len], this->buffer.size() - len);
+        if (count < 0)
+            return false;
+        if (count == 0)
+            break;
+        len += count;
+    }
+    this->buffer.resize(len);
+    this->data = this->buffer.data();
+    this->size = len;
+    return true;
+}
+
+// unmaps or frees the file's contents, any views of the source are invalidated
+void SourceFile::close(){
+    if (this->mapped)
+        munmap(const_cast<char*>(this->data), this->size);
+    this->buffer.clear();
+    this->buffer.shrink_to_fit();
+    this->data = nullptr;
+    this->size = 0;
+    this->mapped = false;
+}
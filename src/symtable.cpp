@@ -1,46 +1,67 @@
-#include <memory>
+#include <algorithm>
+#include <climits>
+#include <memory_resource>
+#include <string_view>
 #include <unordered_map>
 
 #include "../inc/values.hpp"
 #include "../inc/symtable.h"
 
-SymbolTable::SymbolTable(SymbolTable* parent){
+SymbolTable::SymbolTable(SymbolTable* parent, std::pmr::memory_resource* resource): table(resource){
     this->parent = parent;
+    this->root = parent->root;
+    this->base = parent->next_slot;
+    this->next_slot = this->base;
+    this->visible = this->root->declarations;
 }
 
-// creates a new value on the symbol table and associates it with a pointer. 
+// creates a new symbol in the table and assigns it the next free slot in the frame. 
 // This function assumes that the symbol has already been determined not to exist
-void SymbolTable::create(const std::string& symbol, ValueType type){
-    this->table[symbol] = std::shared_ptr<Value> (Value::create_dyn(type));
+const Symbol& SymbolTable::create(std::string_view symbol, ValueType type){
+    Entry& entry = this->table[std::pmr::string(symbol)];
+    entry = {{0, this->next_slot++, type}, this->root->declarations++};
+    this->root->max_slots = std::max(this->root->max_slots, this->next_slot);
+    return entry.symbol;
 }
 
-// clears all values on the symtable
+// clears all symbols on the symtable, their slots will be reused
 void SymbolTable::clear(){
     this->table.clear();
+    this->next_slot = this->base;
 }
 
-// returns a pointer to a symbol on the table, or a null pointer if the symbol does not exist
-std::shared_ptr<Value> SymbolTable::get(const std::string& symbol){
-    auto val_itt = this->table.find(symbol);
-    if (val_itt != table.end())
-        return val_itt->second;
-    // search through all parent tables for a matching symbol
-    SymbolTable* curr = this->parent;
+// returns the symbol with the given name, or a null pointer if the symbol does not exist
+const Symbol* SymbolTable::get(std::string_view symbol){
+    // search through this table, then all parent tables for a matching symbol
+    SymbolTable* curr = this;
     while (curr){
-        val_itt = curr->table.find(symbol);
-        if (val_itt != curr->table.end())
-            return val_itt->second;
-        else
-            curr = curr->parent;
+        auto sym_itt = curr->table.find(symbol);
+        if (sym_itt != curr->table.end())
+            return &sym_itt->second.symbol;
+        curr = curr->parent;
     }
     // no match was found, return nullptr
-    return std::shared_ptr<Value>(nullptr);
+    return nullptr;
 }
 
-// returns whether or not a given value exists in the +
-bool SymbolTable::exists(const std::string& symbol){
-    std::shared_ptr<Value> ptr = this->get(symbol);
-    if (ptr.get() == nullptr)
-        return false;
-    return true;
-}
\ No newline at end of file
+/*
+    returns the symbol a name refers to within this scope, which is the same as get, except that symbols a parent declared after
+    the scope was created are ignored. This only matters when a block's body is parsed after the code that follows it
+*/
+const Symbol* SymbolTable::lookup(std::string_view symbol){
+    SymbolTable* curr = this;
+    unsigned limit = UINT_MAX;
+    while (curr){
+        auto sym_itt = curr->table.find(symbol);
+        if (sym_itt != curr->table.end() && sym_itt->second.order < limit)
+            return &sym_itt->second.symbol;
+        limit = curr->visible;
+        curr = curr->parent;
+    }
+    return nullptr;
+}
+
+// returns whether or not a given symbol exists in the table or its parents
+bool SymbolTable::exists(std::string_view symbol){
+    return this->get(symbol) != nullptr;
+}
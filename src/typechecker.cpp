@@ -0,0 +1,141 @@
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+#include "../inc/typechecker.h"
+#include "../inc/lexer.h"
+#include "../inc/nodes.hpp"
+#include "../inc/block.h"
+
+inline bool is_numeric(ValueType type){
+    return type == INT || type == FLOAT;
+}
+
+// checks a single top-level statement, throwing the first type error found in it
+void TypeChecker::check(Node* statement){
+    this->infer(statement);
+}
+
+void TypeChecker::error(Node* node, const std::string& msg){
+    throw std::runtime_error("type error: " + msg + describe_location(node->get_line(), node->get_col()));
+}
+
+// returns the type a node evaluates to, nodes are only marked as checked if the types of all their operands are known
+TypeChecker::StaticType TypeChecker::infer(Node* node){
+    switch (node->get_node_type()){
+        case Literal_N:
+            return static_cast<LiteralNode*>(node)->get_value().get_type();
+        case Var_N:
+            return static_cast<VarNode*>(node)->get_type();
+        // pointers can refer to any value
+        case Ptr_N:
+            return std::nullopt;
+        case Asgn_N: {
+            AsgnNode* asgn = static_cast<AsgnNode*>(node);
+            StaticType rhs_type = this->infer(asgn->get_rhs());
+            ValueType lhs_type = asgn->get_lhs()->get_type();
+            if (!rhs_type || asgn->get_lhs()->get_node_type() != Var_N)
+                return lhs_type;
+            if (*rhs_type != lhs_type)
+                this->error(node, "cannot assign a variable to a value of a different type");
+            node->set_checked();
+            return lhs_type;
+        }
+        case Comp_N: {
+            CompNode* comp = static_cast<CompNode*>(node);
+            StaticType lhs_type = this->infer(comp->get_lhs());
+            StaticType rhs_type = this->infer(comp->get_rhs());
+            if (!lhs_type || !rhs_type || *lhs_type == NULL_TYPE || *rhs_type == NULL_TYPE)
+                return BOOL;
+            if (*lhs_type != *rhs_type)
+                this->error(node, "cannot compare two values of differing types");
+            if ((comp->op == LessThan || comp->op == GreatherThan) && !is_numeric(*lhs_type))
+                this->error(node, "cannot use the '>' operator on non-numeric values");
+            node->set_checked();
+            return BOOL;
+        }
+        case BoolLogic_N: {
+            BoolLogicNode* logic = static_cast<BoolLogicNode*>(node);
+            StaticType lhs_type = this->infer(logic->get_lhs());
+            StaticType rhs_type = this->infer(logic->get_rhs());
+            if (!lhs_type || !rhs_type)
+                return BOOL;
+            if (*lhs_type != BOOL || *rhs_type != BOOL)
+                this->error(node, "invalid opperand types for logical operation");
+            node->set_checked();
+            return BOOL;
+        }
+        case Arith_N: {
+            ArithNode* arith = static_cast<ArithNode*>(node);
+            StaticType lhs_type = this->infer(arith->get_lhs());
+            StaticType rhs_type = this->infer(arith->get_rhs());
+            // the modulo operator only accepts integers, so it always evaluates to one
+            bool is_mod = arith->get_op() == ArithMod;
+            if (!lhs_type || !rhs_type)
+                return is_mod ? StaticType(INT) : std::nullopt;
+            if (*lhs_type != *rhs_type)
+                this->error(node, "cannot perform arithmetic on differing types");
+            if (!is_numeric(*lhs_type))
+                this->error(node, "invalid operation for non-numeric types");
+            if (is_mod && *lhs_type == FLOAT)
+                this->error(node, "cannot use the '%' operator on floats");
+            node->set_checked();
+            return *lhs_type;
+        }
+        case Print_N:
+            for (Node* arg : static_cast<PrintNode*>(node)->get_args())
+                this->infer(arg);
+            return NULL_TYPE;
+        case Block_N:
+            return this->infer_block(static_cast<BlockNode*>(node));
+        // type names, symbols and parameters all evaluate to null
+        default:
+            return NULL_TYPE;
+    }
+}
+
+// returns the type of a block, which is only known statically if every path through it evaluates to the same type
+TypeChecker::StaticType TypeChecker::infer_block(BlockNode* block){
+    switch (block->block_type()){
+        case Eval:
+            return this->infer(static_cast<EvalBlockNode*>(block)->get_body());
+        case Conditional: {
+            CondBlockNode* cond = static_cast<CondBlockNode*>(block);
+            this->check_condition(block, cond->get_condition());
+            if (cond->is_deferred())
+                return std::nullopt;
+            StaticType body_type = this->infer_statements(block);
+            StaticType else_type = cond->get_else() ? this->infer_statements(cond->get_else()) : StaticType(NULL_TYPE);
+            return (body_type == else_type) ? body_type : std::nullopt;
+        }
+        case Loop: {
+            this->check_condition(block, static_cast<LoopBlockNode*>(block)->get_condition());
+            // the loop evaluates to null if it never runs
+            StaticType body_type = this->infer_statements(block);
+            return (body_type == NULL_TYPE) ? body_type : std::nullopt;
+        }
+        default:
+            return this->infer_statements(block);
+    }
+}
+
+// checks every statement of a block, which evaluates to its last statement, or null if it has none
+TypeChecker::StaticType TypeChecker::infer_statements(BlockNode* block){
+    // the body of a deferred block isn't parsed yet, so it's checked at runtime instead
+    if (block->is_deferred())
+        return std::nullopt;
+    StaticType last = NULL_TYPE;
+    for (Node* statement : block->get_statements())
+        last = this->infer(statement);
+    return last;
+}
+
+// ensures the condition of an if or while block is a boolean, marking the block as checked if that is known statically
+void TypeChecker::check_condition(BlockNode* block, Node* condition){
+    StaticType cond_type = this->infer(condition);
+    if (!cond_type)
+        return;
+    if (*cond_type != BOOL)
+        this->error(condition, "invalid conditional");
+    block->set_checked();
+}
@@ -1,25 +1,15 @@
-#include "../inc/values.hpp"
+#include <charconv>
+#include <cstdlib>
+#include <new>
+#include <utility>
 
-Value::Value(ValueType type, const std::vector<std::byte>& val, bool is_arr){
-    this->type = type;
-    this->val = val;
-    if (is_arr){
-        this->is_arr = true;
-        this->arr = new NebulaArray(type);
-    }
-}
+#include "../inc/values.hpp"
 
 // creates a dynamically allocated pointer to an unitialized value
 Value* Value::create_dyn(ValueType type, bool is_arr){
     return new Value(type, is_arr);
 }
 
-// deletes the memory associated with the value if it's an array
-Value::~Value(){
-    if (this->is_arr)
-        delete arr;
-
-}
 // compares two Values, will only return true if they are of the same type and value
 bool Value::operator==(const Value& rhs) const{
     if (this->type != rhs.type)
@@ -32,7 +22,7 @@ bool Value::operator==(const Value& rhs) const{
             return this->as<double>() == rhs.as<double>();
             break;
         case CHAR:
-            return this->val[0] == rhs.val[0];
+            return this->val.char_val == rhs.val.char_val;
             break;
         case BOOL:
             return this->as<bool>() == rhs.as<bool>();
@@ -41,67 +31,168 @@ bool Value::operator==(const Value& rhs) const{
      return false;
 }
 
-// displays the value's unwrapped form
-std::ostream& operator<<(std::ostream& out, const Value& val){
-    switch (val.type){
+/*
+    writes the value's printed form to dst, which must have room for MAX_FORMATTED characters, and returns the number written. Floats
+    are written like printf's %g, so the C backend can print them identically
+*/
+size_t Value::format(char* dst) const{
+    char* end = dst + MAX_FORMATTED;
+    switch (this->type){
         case INT:
-            out << val.as<int>();
-            break;
+            return std::to_chars(dst, end, this->val.int_val).ptr - dst;
         case FLOAT:
-            out << val.as<int>();
-            break;
+            return std::to_chars(dst, end, this->val.float_val, std::chars_format::general, 6).ptr - dst;
         case CHAR:
-            out << val.as<char>();
-            break;
+            *dst = this->val.char_val;
+            return 1;
         case BOOL:
-            out << (val.as<bool>()) ? "true" : "false";
-            break;
-        case NULL_TYPE:
-            out << "null";
-            break;
+            if (this->val.bool_val){
+                std::memcpy(dst, "true", 4);
+                return 4;
+            }
+            std::memcpy(dst, "false", 5);
+            return 5;
+        default:
+            std::memcpy(dst, "null", 4);
+            return 4;
     }
-    return out;
+}
+
+// displays the value's unwrapped form
+std::ostream& operator<<(std::ostream& out, const Value& val){
+    char buffer[Value::MAX_FORMATTED];
+    return out.write(buffer, val.format(buffer));
 }
 
 // Nebula Array functions
 // returns the refference to the array from the value, raises an error if the value is not an array
 NebulaArray& Value::as_arr(){
-    if (this->arr)
+    if (!this->arr)
         throw std::runtime_error("cannot access array methods for a non-array value");
     return *this->arr;
 }
 
-// constructs a new array for 32 values
+// the number of bytes an element of the given type takes in an array
+size_t NebulaArray::element_size(ValueType type){
+    switch (type){
+        case INT:
+            return sizeof(int);
+        case FLOAT:
+            return sizeof(double);
+        case CHAR:
+            return sizeof(char);
+        case BOOL:
+            return sizeof(bool);
+        default:
+            return 0;
+    }
+}
+
+// allocates an element buffer, which is plain bytes so it can be grown with realloc
+std::byte* NebulaArray::allocate(std::byte* old_ptr, size_t bytes){
+    std::byte* ptr = static_cast<std::byte*>(std::realloc(old_ptr, bytes ? bytes : 1));
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+// constructs a new array with room for 32 elements
 NebulaArray::NebulaArray(ValueType val_type){
-    this->arr_ptr = new Value[32];
     this->val_type = val_type;
+    this->arr_ptr = allocate(nullptr, this->bytes_used());
+}
+
+// copies every element of another array
+NebulaArray::NebulaArray(const NebulaArray& other){
+    this->size = other.size;
+    this->capacity = other.capacity;
+    this->val_type = other.val_type;
+    this->arr_ptr = nullptr;
+    if (other.arr_ptr){
+        this->arr_ptr = allocate(nullptr, this->bytes_used());
+        std::memcpy(this->arr_ptr, other.arr_ptr, this->size * element_size(this->val_type));
+    }
+}
+
+NebulaArray& NebulaArray::operator=(const NebulaArray& other){
+    if (this == &other)
+        return *this;
+    NebulaArray tmp(other);
+    std::swap(this->size, tmp.size);
+    std::swap(this->capacity, tmp.capacity);
+    std::swap(this->val_type, tmp.val_type);
+    std::swap(this->arr_ptr, tmp.arr_ptr);
+    return *this;
 }
 
 NebulaArray::~NebulaArray(){
-    delete[] this->arr_ptr;
+    std::free(this->arr_ptr);
 }
 
 //this doubles the capacity of the array
 void NebulaArray::realloc(){
-    // create the new array
-    Value* new_arr = new Value[this->capacity * 2];
-    for (size_t i = 0; i < this->size; i++)
-        new_arr[i] = arr_ptr[i];
-    // clean up and update member variables
-    delete[] this->arr_ptr;
-    this->arr_ptr = new_arr;
+    this->arr_ptr = allocate(this->arr_ptr, this->bytes_used() * 2);
     this->capacity *= 2;
 }
 
-// returns a reference to the value at the given index, or throws a std::runtime_error if the index is out of range
-Value& NebulaArray::get(int index){
-    if (index > this->size)
+// sets the number of elements, growing the buffer if it's too small. Any new elements are left uninitialised
+void NebulaArray::resize(int size){
+    if (size > this->capacity){
+        while (this->capacity < size)
+            this->capacity *= 2;
+        this->arr_ptr = allocate(this->arr_ptr, this->bytes_used());
+    }
+    this->size = size;
+}
+
+// makes room to write the given index, which may be one past the end to append an element. Throws if it's any further out
+void NebulaArray::reserve_index(int index){
+    if (index < 0 || index > this->size)
         throw std::runtime_error("cannot access element out range");
     // check if we are accessing the end o the array, and resize if needed
-    else if (index == this->size){
+    if (index == this->size){
         if (this->size == this->capacity)
             this->realloc();
         this->size++;
     }
-    return this->arr_ptr[index];
+}
+
+// returns a copy of the element at the given index, or throws a std::runtime_error if the index is out of range
+Value NebulaArray::get(int index) const{
+    if (index < 0 || index >= this->size)
+        throw std::runtime_error("cannot access element out range");
+    switch (this->val_type){
+        case INT:
+            return Value::create(INT, this->at<int>(index));
+        case FLOAT:
+            return Value::create(FLOAT, this->at<double>(index));
+        case CHAR:
+            return Value::create(CHAR, this->at<char>(index));
+        case BOOL:
+            return Value::create(BOOL, this->at<bool>(index));
+        default:
+            return Value(NULL_TYPE);
+    }
+}
+
+// overwrites the element at the given index, or appends it if the index is one past the end. The value must match the array's type
+void NebulaArray::set(int index, const Value& val){
+    if (val.get_type() != this->val_type)
+        throw std::runtime_error("cannot store a value of a different type in an array");
+    switch (this->val_type){
+        case INT:
+            this->put(index, val.as<int>());
+            break;
+        case FLOAT:
+            this->put(index, val.as<double>());
+            break;
+        case CHAR:
+            this->put(index, val.as<char>());
+            break;
+        case BOOL:
+            this->put(index, val.as<bool>());
+            break;
+        default:
+            break;
+    }
 }
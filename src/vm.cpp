@@ -0,0 +1,76 @@
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "../inc/bytecode.h"
+#include "../inc/vm.h"
+#include "../inc/nodes.hpp"
+
+// runs a chunk until it halts and returns the value left on top of the stack
+Value VM::run(const Chunk& chunk, Environment& env){
+    this->stack.clear();
+    const Instruction* code = chunk.code.data();
+    const Instruction* ip = code;
+    Value lhs, rhs;
+    while (true){
+        const Instruction& instr = *ip++;
+        switch (instr.op){
+            case OpConst:
+                this->stack.push_back(chunk.constants[instr.arg]);
+                break;
+            case OpNull:
+                this->stack.push_back(Value(NULL_TYPE));
+                break;
+            case OpLoad: {
+                const VarRef& var = chunk.vars[instr.arg];
+                this->stack.push_back(env.at(var.depth, var.slot));
+                break;
+            }
+            case OpStore: {
+                const VarRef& var = chunk.vars[instr.arg];
+                if (this->stack.back().get_type() != var.type)
+                    throw std::runtime_error("cannot assign a variable to a value of a different type");
+                env.at(var.depth, var.slot) = this->stack.back();
+                break;
+            }
+            case OpArith:
+            case OpComp:
+            case OpLogic:
+                rhs = std::move(this->stack.back());
+                this->stack.pop_back();
+                lhs = std::move(this->stack.back());
+                if (instr.op == OpArith)
+                    this->stack.back() = ArithNode::apply(static_cast<Operator>(instr.arg), lhs, rhs);
+                else if (instr.op == OpComp)
+                    this->stack.back() = CompNode::apply(static_cast<Operator>(instr.arg), lhs, rhs);
+                else
+                    this->stack.back() = BoolLogicNode::apply(static_cast<Operator>(instr.arg), lhs, rhs);
+                break;
+            case OpPop:
+                this->stack.pop_back();
+                break;
+            case OpJump:
+                ip = code + instr.arg;
+                break;
+            case OpJumpFalse:
+                if (this->stack.back().get_type() != BOOL)
+                    throw std::runtime_error("invalid conditional");
+                if (!this->stack.back().as<bool>())
+                    ip = code + instr.arg;
+                this->stack.pop_back();
+                break;
+            case OpPrint:
+                this->output->write(this->stack.back());
+                this->stack.pop_back();
+                break;
+            case OpPrintEnd:
+                this->output->end_print(instr.arg);
+                this->stack.push_back(Value(NULL_TYPE));
+                break;
+            case OpTrap:
+                throw std::runtime_error(chunk.messages[instr.arg]);
+            case OpHalt:
+                return this->stack.back();
+        }
+    }
+}
@@ -1,7 +1,21 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <iostream>
 #include <stdexcept>
 #include <vector>
 #include <memory>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <chrono>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <gtest/gtest.h>
 
 #include  "../inc/lexer.h"
@@ -11,8 +25,41 @@
 #include "../inc/block.h"
 #include "../inc/parser.h"
 #include "../inc/interpreter.h"
+#include "../inc/arena.h"
+#include "../inc/source.h"
+#include "../inc/typechecker.h"
+#include "../inc/optimizer.h"
+#include "../inc/cache.h"
+#include "../inc/flatast.h"
+#include "../inc/arrayops.h"
+#include "../inc/output.h"
+#include "../inc/daemon.h"
+#include "../inc/batch.h"
+#include "../inc/profiler.h"
 
 /* DEBUG FUNCTIONS */
+// returns the resident memory of the process in bytes
+size_t resident_memory(){
+    size_t total_pages, resident_pages;
+    std::ifstream statm("/proc/self/statm");
+    statm >> total_pages >> resident_pages;
+    return resident_pages * sysconf(_SC_PAGESIZE);
+}
+// counts every heap allocation made by the process, so tests can check that hot paths don't allocate. It's atomic since some
+// tests allocate on several threads
+std::atomic<size_t> alloc_count {0};
+// these are kept out of line, once inlined GCC sees memory from malloc being passed to operator delete, or from operator new
+// being passed to free, and warns that they're mismatched
+__attribute__((noinline)) void* operator new(size_t size){
+    alloc_count.fetch_add(1, std::memory_order_relaxed);
+    void* ptr = std::malloc(size ? size : 1);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+__attribute__((noinline)) void operator delete(void* ptr) noexcept {std::free(ptr);}
+void operator delete(void* ptr, size_t) noexcept {::operator delete(ptr);}
+
 bool comp_token_types(const std::vector<Token>& tokens, const std::vector<TokenType>& expected){
     if (tokens.size() != expected.size()){
         std::cout << "Non-matching sizes: expected " << expected.size() << " tokens, got " << tokens.size() << std::endl; 
@@ -63,11 +110,75 @@ TEST(LexerTests, Symbols){
     EXPECT_TRUE(comp_token_types(tokens, {Sym, Sym, Sym, Sym}));
     EXPECT_TRUE(comp_token_text(tokens, {"these", "are", "user", "defined"}));
 }
+TEST(LexerTests, Mixed){
+    // words end at any character that forms a token, but not at digits
+    std::vector<Token> tokens;
+    tokenize("let int x1=(x1**2)!=y;\nprintln\t'z' 1.5", tokens);
+    EXPECT_TRUE(comp_token_types(tokens, {Defn, TypeInt, Sym, Asgn, EvalBlock, Sym, Pow, IntLiteral, EvalBlockEnd, Neq, Sym, Break, Break, Println, CharLiteral, FloatLiteral}));
+    EXPECT_TRUE(comp_token_text(tokens, {"let", "int", "x1", "=", "(", "x1", "**", "2", ")", "!=", "y", ";", "\n", "println", "z", "1.5"}));
+    // malformed literals should be rejected
+    tokens.clear();
+    EXPECT_THROW(tokenize("1.2.3", tokens), std::runtime_error);
+    EXPECT_THROW(tokenize("'ab'", tokens), std::runtime_error);
+    EXPECT_THROW(tokenize("'a", tokens), std::runtime_error);
+}
+TEST(LexerTests, Spans){
+    // tokens should view the source directly and know where they start
+    std::string src = "let int x = 5\n  x * 2";
+    std::vector<Token> tokens;
+    tokenize(src, tokens);
+    EXPECT_EQ(tokens[2].txt.data(), src.data() + 8);
+    EXPECT_EQ(tokens[2].line, 1);
+    EXPECT_EQ(tokens[2].col, 9);
+    EXPECT_EQ(tokens[6].txt, "x");
+    EXPECT_EQ(tokens[6].line, 2);
+    EXPECT_EQ(tokens[6].col, 3);
+    EXPECT_EQ(tokens[7].type, Mul);
+    EXPECT_EQ(tokens[7].col, 5);
+    // errors should point at the source location
+    Interpreter interpreter;
+    EXPECT_EQ(interpreter.run("let int y = 1\n y = 'ab'"), 1);
+    EXPECT_EQ(interpreter.run("let int z = 1\n end"), 1);
+    std::ostringstream err;
+    std::streambuf* old_buf = std::cerr.rdbuf(err.rdbuf());
+    interpreter.display_err();
+    std::cerr.rdbuf(old_buf);
+    EXPECT_NE(err.str().find("(line 2, col 2)"), std::string::npos);
+}
+TEST(LexerTests, Parallel){
+    // the parallel lexer must produce exactly the same tokens as the serial one, including breaks inside character literals
+    std::string src;
+    for (int i = 0; src.size() < 3 * 1024 * 1024; i++)
+        src += "let int x" + std::to_string(i) + " = (" + std::to_string(i) + " ** 2); println ';' '\n' x" + std::to_string(i) + "\n";
+    auto expect_same = [&](unsigned threads){
+        std::vector<Token> serial, parallel;
+        std::string serial_err, parallel_err;
+        try {tokenize(src, serial);} catch (std::runtime_error& e) {serial_err = e.what();}
+        try {tokenize_parallel(src, parallel, threads);} catch (std::runtime_error& e) {parallel_err = e.what();}
+        EXPECT_EQ(serial_err, parallel_err);
+        ASSERT_EQ(serial.size(), parallel.size());
+        for (size_t i = 0; i < serial.size(); i++){
+            ASSERT_EQ(serial[i].type, parallel[i].type) << i;
+            ASSERT_EQ(serial[i].txt.data(), parallel[i].txt.data()) << i;
+            ASSERT_EQ(serial[i].txt.size(), parallel[i].txt.size()) << i;
+            ASSERT_EQ(serial[i].line, parallel[i].line) << i;
+            ASSERT_EQ(serial[i].col, parallel[i].col) << i;
+        }
+    };
+    for (unsigned threads : {1, 2, 3, 8})
+        expect_same(threads);
+    // statements split by semicolons alone still start new chunks, so their columns must continue from the previous chunk
+    std::replace(src.begin(), src.end(), '\n', ';');
+    expect_same(4);
+    // errors are reported at the same place, with the same tokens before them
+    src.insert(src.size() - 1000, "'ab'");
+    expect_same(4);
+    src.insert(1000, "1.2.3");
+    expect_same(4);
+}
 
 /* SYMBOL TABLE TESTS */
 TEST(SymbolTableTests, General){   
-    Value int_val = Value::create(INT, 15);
-    Value char_val = Value::create(CHAR, '!');
     SymbolTable sym_table;
     SymbolTable child_table(&sym_table);
     sym_table.create("int_var", INT);
@@ -77,34 +188,219 @@ TEST(SymbolTableTests, General){
     EXPECT_FALSE(sym_table.exists("char_var"));
     EXPECT_TRUE(child_table.exists("int_var"));
     EXPECT_TRUE(child_table.exists("char_var"));
-    // ensure that pointers are disributed properly
-    VarNode int_var(sym_table.get("int_var"), true);
-    VarNode int_var_copy(child_table.get("int_var"), true);
+    // ensure that slots are disributed properly
+    Environment env;
+    env.reserve(sym_table.frame_size());
+    VarNode int_var(&env, *sym_table.get("int_var"), true);
+    VarNode int_var_copy(&env, *child_table.get("int_var"), true);
     int_var.assign(std::move(Value::create(INT, 256)));
     EXPECT_EQ(int_var_copy.eval().as<int>(), 256);
 
 }
+TEST(SymbolTableTests, Slots){
+    // a child scope's slots follow its parent's, and sibling scopes reuse the same slots
+    SymbolTable global;
+    global.create("a", INT);
+    global.create("b", FLOAT);
+    SymbolTable first(&global), second(&global);
+    EXPECT_EQ(first.create("c", CHAR).slot, 2);
+    EXPECT_EQ(first.create("d", BOOL).slot, 3);
+    EXPECT_EQ(second.create("e", INT).slot, 2);
+    EXPECT_EQ(second.get("b")->slot, 1);
+    EXPECT_EQ(second.get("b")->type, FLOAT);
+    EXPECT_EQ(second.get("b")->depth, 0);
+    EXPECT_EQ(second.get("d"), nullptr);
+    EXPECT_EQ(global.frame_size(), 4);
+}
+
+/* VALUE TESTS */
+TEST(ValueTest, Inline){
+    // scalars are stored inline, so creating, copying and operating on them shouldn't allocate
+    size_t init_count = alloc_count;
+    Value total = Value::create(INT, 0);
+    for (int i = 0; i < 1000; i++){
+        Value num = Value::create(INT, i);
+        Value copy = num;
+        total = ArithNode::apply(ArithAdd, total, copy);
+    }
+    Value flag = CompNode::apply(Equal, total, Value::create(INT, 499500));
+    EXPECT_EQ(alloc_count, init_count);
+    EXPECT_EQ(total.as<int>(), 499500);
+    EXPECT_TRUE(flag.as<bool>());
+    EXPECT_THROW(CompNode::apply(Equal, Value(NULL_TYPE), Value(NULL_TYPE)), std::runtime_error);
+    // ensure each type round trips through the union
+    EXPECT_EQ(Value::create(FLOAT, 2.5).as<double>(), 2.5);
+    EXPECT_EQ(Value::create(CHAR, 'z').as<char>(), 'z');
+    EXPECT_EQ(Value::create(BOOL, true).as<bool>(), true);
+    Value updated = Value::create(INT, 1);
+    updated.update(42);
+    EXPECT_EQ(updated.as<int>(), 42);
+}
+TEST(ValueTest, Arrays){
+    // copies of array values must not share storage, moves should transfer it
+    Value arr(INT, true);
+    arr.as_arr().set(0, Value::create(INT, 1));
+    Value copy = arr;
+    copy.as_arr().set(0, Value::create(INT, 2));
+    EXPECT_EQ(arr.as_arr().get(0).as<int>(), 1);
+    EXPECT_EQ(copy.as_arr().get(0).as<int>(), 2);
+    Value moved = std::move(copy);
+    EXPECT_TRUE(moved.is_array());
+    EXPECT_EQ(moved.as_arr().get(0).as<int>(), 2);
+    EXPECT_THROW(Value::create(INT, 1).as_arr(), std::runtime_error);
+}
+
+/* ARENA TESTS */
+TEST(ArenaTest, Basic){
+    Arena arena(1024);
+    // objects should be laid out contiguously in allocation order
+    LiteralNode* first = arena.make<LiteralNode>(Value::create(INT, 1));
+    LiteralNode* second = arena.make<LiteralNode>(Value::create(INT, 2));
+    EXPECT_EQ(reinterpret_cast<char*>(second) - reinterpret_cast<char*>(first), sizeof(LiteralNode));
+    EXPECT_EQ(second->eval().as<int>(), 2);
+    std::string_view str = arena.copy_str("symbol");
+    EXPECT_EQ(str, "symbol");
+    // allocations larger than a chunk should still succeed
+    std::byte* large = static_cast<std::byte*>(arena.allocate(4096, 8));
+    large[4095] = std::byte{1};
+    // resetting the arena should reuse its memory
+    arena.reset();
+    EXPECT_EQ(arena.bytes_used(), 0);
+    size_t init_count = alloc_count;
+    for (int i = 0; i < 16; i++)
+        arena.make<LiteralNode>(Value::create(INT, i));
+    EXPECT_EQ(alloc_count, init_count);
+}
+TEST(ArenaTest, ParserReuse){
+    // nodes from a previous parse are released when the parser is reset, so the same parser can run many programs
+    Interpreter interpreter;
+    for (int i = 0; i < 100; i++){
+        EXPECT_EQ(interpreter.run("begin\n let int x = 2\n if (x == 2)\n x = x * 3\n else\n x = 0\n end\n x\n end"), 0);
+        EXPECT_EQ(interpreter.result().as<int>(), 6);
+    }
+}
 
 /* ARRAY TESTS */
 TEST(ArrayTest, Basic){
     // ensure basic opperations work
     NebulaArray int_arr(INT);
-    for (int i = 0; i < 10; i++){
-        Value* val = &int_arr.get(i);
-        *val = Value::create(INT, i * 2);
-    }
+    for (int i = 0; i < 10; i++)
+        int_arr.set(i, Value::create(INT, i * 2));
     EXPECT_EQ(int_arr.get(5).as<int>(), 10);
+    EXPECT_EQ(int_arr.at<int>(6), 12);
+    EXPECT_EQ(int_arr.length(), 10);
+    // elements can only be read in range, and written in range or at the end
+    EXPECT_THROW(int_arr.get(10), std::runtime_error);
+    EXPECT_THROW(int_arr.get(-1), std::runtime_error);
+    EXPECT_THROW(int_arr.set(11, Value::create(INT, 0)), std::runtime_error);
+    EXPECT_THROW(int_arr.set(0, Value::create(FLOAT, 1.5)), std::runtime_error);
+    NebulaArray float_arr(FLOAT);
+    float_arr.put(0, 2.5);
+    float_arr.set(1, Value::create(FLOAT, 0.25));
+    EXPECT_EQ(float_arr.get(0).as<double>(), 2.5);
+    EXPECT_EQ(float_arr.get(1).get_type(), FLOAT);
+    EXPECT_EQ(float_arr.data<double>()[1], 0.25);
 }
 TEST(ArrayTest, Large){
     // ensure that resizing works as expected
     NebulaArray int_arr(INT);
-    for (int i = 0; i < 128; i++){
-        Value* val = &int_arr.get(i);
-        *val = Value::create(INT, i + 1);
-    }
+    for (int i = 0; i < 128; i++)
+        int_arr.set(i, Value::create(INT, i + 1));
     for (int i = 0; i < 128; i++){
         EXPECT_EQ(int_arr.get(i).as<int>(), i + 1);
     }
+    // elements are unboxed, so a million ints should take 4 MB
+    NebulaArray million(INT);
+    for (int i = 0; i < 1000000; i++)
+        million.put(i, i);
+    EXPECT_LE(million.bytes_used(), 1048576 * sizeof(int));
+    long long total = 0;
+    const int* data = million.data<int>();
+    for (int i = 0; i < million.length(); i++)
+        total += data[i];
+    EXPECT_EQ(total, 499999500000LL);
+}
+TEST(ArrayTest, Simd){
+    // every kernel level should agree with the scalar loops, including on the elements left over after the last whole vector
+    Value ints(INT, true), other_ints(INT, true), floats(FLOAT, true), other_floats(FLOAT, true), big_ints(INT, true);
+    Value nan_floats(FLOAT, true), nan_first(FLOAT, true), nan_after(FLOAT, true);
+    for (int i = 0; i < 1003; i++){
+        ints.as_arr().put(i, (i * 37) % 101 - 50);
+        // products of these overflow, which every level has to wrap the same way
+        big_ints.as_arr().put(i, static_cast<int>(i * 2654435761u));
+        other_ints.as_arr().put(i, 1 + i % 7);
+        floats.as_arr().put(i, (i % 13) * 0.5 - 2.0);
+        other_floats.as_arr().put(i, 0.25 + i % 5);
+        // the min and max skip NaNs, unless the first element is one, so a NaN can't replace an extreme found before it
+        nan_floats.as_arr().put(i, i % 3 == 1 ? NAN : (i % 11) * 0.5);
+        nan_first.as_arr().put(i, i == 0 ? NAN : (i % 11) * 0.5);
+        nan_after.as_arr().put(i, i < 8 ? (i % 2 ? 1000.0 : -1000.0) : (i >= 500 && i < 508) ? NAN : (i % 11) * 0.5);
+    }
+    Value int_scalar = Value::create(INT, 3), float_scalar = Value::create(FLOAT, 1.5);
+    auto run_all = [&](){
+        std::vector<Value> results;
+        for (Operator op : {ArithAdd, ArithSub, ArithMul, ArithDiv, ArithMod}){
+            results.push_back(array_arith(op, ints, other_ints));
+            results.push_back(array_arith(op, ints, int_scalar));
+            results.push_back(array_arith(op, int_scalar, other_ints));
+            if (op != ArithMod){
+                results.push_back(array_arith(op, floats, other_floats));
+                results.push_back(array_arith(op, float_scalar, other_floats));
+            }
+        }
+        for (Value* arr : {&ints, &floats}){
+            results.push_back(array_sum(*arr));
+            results.push_back(array_min(*arr));
+            results.push_back(array_max(*arr));
+        }
+        results.push_back(array_dot(ints, other_ints));
+        results.push_back(array_dot(floats, other_floats));
+        results.push_back(array_arith(ArithMul, big_ints, ints));
+        results.push_back(array_dot(big_ints, big_ints));
+        for (Value* arr : {&nan_floats, &nan_first, &nan_after}){
+            results.push_back(array_min(*arr));
+            results.push_back(array_max(*arr));
+        }
+        return results;
+    };
+    SimdLevel detected = get_simd_level();
+    set_simd_level(SimdScalar);
+    std::vector<Value> expected = run_all();
+    for (SimdLevel level : {SimdSSE2, SimdAVX2}){
+        set_simd_level(level);
+        std::vector<Value> results = run_all();
+        ASSERT_EQ(results.size(), expected.size());
+        for (size_t i = 0; i < results.size(); i++){
+            ASSERT_EQ(results[i].get_type(), expected[i].get_type());
+            ASSERT_EQ(results[i].is_array(), expected[i].is_array());
+            if (!results[i].is_array()){
+                // vectors sum floats in a different order, so only ints are exact
+                if (results[i].get_type() == FLOAT && std::isnan(expected[i].as<double>()))
+                    EXPECT_TRUE(std::isnan(results[i].as<double>())) << i;
+                else if (results[i].get_type() == FLOAT)
+                    EXPECT_NEAR(results[i].as<double>(), expected[i].as<double>(), 1e-9) << i;
+                else
+                    EXPECT_TRUE(results[i] == expected[i]) << i;
+                continue;
+            }
+            ASSERT_EQ(results[i].as_arr().length(), 1003);
+            for (int j = 0; j < 1003; j++)
+                ASSERT_TRUE(results[i].as_arr().get(j) == expected[i].as_arr().get(j)) << i << ", " << j;
+        }
+    }
+    set_simd_level(detected);
+    EXPECT_EQ(get_simd_level(), detected);
+    // the element-wise results should match scalar arithmetic, and arrays go through the same operator as scalars
+    Value sum = array_arith(ArithAdd, ints, other_ints);
+    EXPECT_EQ(sum.as_arr().get(10).as<int>(), ints.as_arr().get(10).as<int>() + other_ints.as_arr().get(10).as<int>());
+    Value diff = ArithNode::apply(ArithSub, int_scalar, ints);
+    EXPECT_EQ(diff.as_arr().get(4).as<int>(), ints.as_arr().get(4).as<int>() - 3);
+    EXPECT_EQ(array_sum(other_ints).as<int>(), 4007);
+    EXPECT_EQ(array_max(other_ints).as<int>(), 7);
+    EXPECT_THROW(array_arith(ArithAdd, ints, floats), std::runtime_error);
+    EXPECT_THROW(array_arith(ArithMod, floats, other_floats), std::runtime_error);
+    EXPECT_THROW(array_min(Value(INT, true)), std::runtime_error);
+    EXPECT_THROW(array_sum(int_scalar), std::runtime_error);
 }
 
 /* PARSER TESTS */
@@ -251,7 +547,837 @@ TEST(ParserTest, Params){
     param = static_cast<ParamNode*>(parser.next_expr());
     EXPECT_EQ(param->get_index(), 5);
 }
+TEST(ParserTest, LazyBlocks){
+    // deferred bodies must behave exactly as if they had been parsed up front, including which names they can see
+    const std::vector<std::string> programs = {
+        "let int x = 0\nif x > 5\n  let int y = 2\n  println y\nelse\n  let int z = 3\n  println z\nend\nlet int y = 7\nprintln y\ny",
+        "begin\n  let float f = 1.5\n  println f\nend\nlet float f = 2.5\nf",
+        "let int i = 0\nlet int total = 0\nwhile i < 2000\n  let int j = 0\n  while j < 3\n    if j > 1\n      total = total + j\n    end\n    j = j + 1\n  end\n  i = i + 1\nend\ntotal",
+        "let int n = 0\nwhile n < 1500\n  n = n + 1\nend\nif n == 1500\n  begin\n    'y'\n  end\nend",
+    };
+    for (Backend backend : {TreeWalker, Tiered}){
+        for (const std::string& program : programs){
+            std::string outputs[2];
+            Value results[2];
+            for (int lazy = 0; lazy < 2; lazy++){
+                Interpreter interpreter;
+                interpreter.set_backend(backend);
+                interpreter.set_lazy(lazy);
+                testing::internal::CaptureStdout();
+                EXPECT_EQ(interpreter.run(program), 0) << program;
+                outputs[lazy] = testing::internal::GetCapturedStdout();
+                results[lazy] = interpreter.result();
+            }
+            EXPECT_EQ(outputs[0], outputs[1]) << program;
+            EXPECT_TRUE(results[0] == results[1]) << program;
+        }
+    }
+    // a body is only parsed when it's first evaluated, so nothing is built for one that never runs
+    std::string src = "let int x = 1\nif x > 5\n  x = (x + 2) * 3\n  x = (x + 2) * 3\nend\nwhile x < 3\n  x = x + 1\nend\nx";
+    size_t used[2];
+    for (int lazy = 0; lazy < 2; lazy++){
+        std::vector<Token> tokens;
+        tokenize(src, tokens);
+        Parser parser(std::move(tokens));
+        parser.set_lazy(lazy);
+        parser.parse();
+        used[lazy] = parser.get_arena().bytes_used();
+        BlockNode* cond = static_cast<BlockNode*>(parser.get_statements()[1]);
+        BlockNode* loop = static_cast<BlockNode*>(parser.get_statements()[2]);
+        EXPECT_EQ(cond->is_deferred(), lazy == 1);
+        EXPECT_EQ(loop->is_deferred(), lazy == 1);
+        while (Node* expr = parser.next_expr())
+            expr->eval();
+        EXPECT_FALSE(loop->is_deferred());
+        EXPECT_EQ(cond->is_deferred(), lazy == 1);
+        EXPECT_EQ(parser.get_environment().at(0, 0).as<int>(), 3);
+    }
+    EXPECT_LT(used[1], used[0]);
+    // syntax errors in a deferred body are only reported if it runs
+    Interpreter interpreter;
+    interpreter.set_backend(TreeWalker);
+    interpreter.set_lazy(true);
+    EXPECT_EQ(interpreter.run("let int x = 1\nif x > 5\n  ] x\nend\nx"), 0);
+    EXPECT_EQ(interpreter.result().as<int>(), 1);
+    EXPECT_EQ(interpreter.run("let int x = 1\nif x < 5\n  ] x\nend\nx"), 1);
+    EXPECT_EQ(interpreter.run("let int x = 1\nif x > 5\n  x\nelse\n  ] x\nend\nx"), 1);
+}
 
+/* BACKEND TESTS */
+TEST(BackendTest, MatchesTreeWalker){
+    // every program should evaluate to the same value on the VM as it does when walking the tree
+    std::vector<std::string> programs = {
+        "let int num = 12; num * 2;",
+        "let int a = 7; let int b = 3; (a - b) + (a % b) + (a ** b);",
+        "let char a = 'a'; let char b = 'b'; (a != b) && (1 < 2);",
+        "let bool flag = false; flag || (3 == 3);",
+        "begin\n let int x = 5\n if (x > 10)\n x = 0\n else\n x = x * 2\n end\n x\n end",
+        "let int ctr = 0\n while (ctr != 10)\n ctr = (ctr + 1)\n end\n ctr",
+        "let int n = 1\n if (n == 2)\n n = 3\n end",
+        "let float f = 2.5\n let int i = 0\n while (i < 4)\n f = f * 1.5 - 0.25\n i = i + 1\n end\n f",
+        "let int x = 1\n x + (x = 6)",
+    };
+    for (const std::string& program : programs){
+        Interpreter tree;
+        tree.set_backend(TreeWalker);
+        EXPECT_EQ(tree.run(program), 0);
+        Value tree_val = tree.result();
+        for (Backend backend : {StackVM, RegisterVM, FlatTreeWalker}){
+            Interpreter vm;
+            vm.set_backend(backend);
+            EXPECT_EQ(vm.run(program), 0);
+            Value vm_val = vm.result();
+            EXPECT_EQ(tree_val.get_type(), vm_val.get_type()) << program;
+            if (!tree_val.is_null()){
+                EXPECT_TRUE(tree_val == vm_val) << program;
+            }
+        }
+    }
+}
+TEST(BackendTest, Errors){
+    // runtime errors should be reported by the VMs as well
+    for (Backend backend : {StackVM, RegisterVM, FlatTreeWalker}){
+        Interpreter interpreter;
+        interpreter.set_backend(backend);
+        EXPECT_EQ(interpreter.run("let int x = 'a';"), 1);
+        EXPECT_EQ(interpreter.run("if (1) 2 end"), 1);
+        EXPECT_EQ(interpreter.run("let int y; y;"), 1);
+    }
+}
+TEST(BackendTest, DivisionErrors){
+    // dividing an integer by zero and taking the modulo of floats are errors on every backend, rather than crashing
+    std::vector<std::pair<std::string, std::string>> programs = {
+        {"let float z = 0.5\nprintln (z % z)", "cannot use the '%' operator on floats"},
+        {"let int a = 0\nprintln (a / 1)", "cannot divide by zero"},
+        {"let int a = 0\nprintln (a % 7)", "cannot divide by zero"},
+        // the divisor only reaches zero once the loop is hot enough to be compiled
+        {"let int i = 0\nlet int q = 0\nwhile (i < 3000)\nq = (2999 - i) / 5\ni = i + 1\nend", "cannot divide by zero"},
+    };
+    for (Backend backend : {TreeWalker, StackVM, RegisterVM, Tiered, FlatTreeWalker}){
+        for (auto& [program, error] : programs){
+            Interpreter interpreter;
+            std::ostringstream out;
+            interpreter.set_backend(backend);
+            interpreter.set_output(out);
+            EXPECT_EQ(interpreter.run(program), 1) << program;
+            EXPECT_NE(interpreter.get_err().find(error), std::string::npos) << program << ": " << interpreter.get_err();
+        }
+    }
+    // the specialised and generic nodes check their operands themselves, for programs the type checker can't see into
+    EXPECT_THROW(ArithNode::calculate(ArithMod, 0.5, 0.5, false), std::runtime_error);
+    EXPECT_THROW(ArithNode::apply(ArithDiv, Value::create(INT, 0), Value::create(INT, 3)), std::runtime_error);
+    EXPECT_EQ(ArithNode::apply(ArithDiv, Value::create(FLOAT, 0.0), Value::create(FLOAT, 1.0)).as<double>(), INFINITY);
+}
+TEST(BackendTest, Dispatch){
+    // the register VM should produce the same results whether it dispatches through a switch or threaded code
+    std::string program = "let int a = 0\n let int b = 1\n let int i = 0\n while (i < 30)\n let int t = a + b\n a = b\n b = t\n i = i + 1\n end\n a";
+    for (Dispatch dispatch : {SwitchDispatch, ThreadedDispatch}){
+        Interpreter interpreter;
+        interpreter.set_dispatch(dispatch);
+        EXPECT_EQ(interpreter.run(program), 0);
+        EXPECT_EQ(interpreter.result().as<int>(), 832040);
+    }
+}
+TEST(BackendTest, BoundedMemory){
+    // a long running loop should not grow memory with its iteration count, on any backend
+    std::string warmup = "let int warm = 0\n while (warm < 1000)\n warm = warm + 1\n warm\n end";
+    std::string program = "let int ctr = 0\n while (ctr < 300000)\n ctr = ctr + 1\n ctr\n end";
+    for (Backend backend : {TreeWalker, StackVM, RegisterVM, FlatTreeWalker}){
+        Interpreter interpreter;
+        interpreter.set_backend(backend);
+        EXPECT_EQ(interpreter.run(warmup), 0);
+        size_t init_mem = resident_memory();
+        EXPECT_EQ(interpreter.run(program), 0);
+        EXPECT_EQ(interpreter.result().as<int>(), 300000);
+        EXPECT_LT(resident_memory(), init_mem + 1024 * 1024);
+    }
+}
+TEST(BackendTest, FlatTree){
+    // the flat tree should print the same output as the tree it was built from, in much less memory
+    std::string program = "let int i = 0\nwhile (i < 5)\nif (i > 2)\nprint i ' '\nelse\nprint 'x'\nend\ni = i + 1\nend\nprintln ' ' i";
+    Interpreter tree;
+    tree.set_backend(TreeWalker);
+    testing::internal::CaptureStdout();
+    EXPECT_EQ(tree.run(program), 0);
+    std::string expected = testing::internal::GetCapturedStdout();
+    Interpreter flat;
+    flat.set_backend(FlatTreeWalker);
+    testing::internal::CaptureStdout();
+    EXPECT_EQ(flat.run(program), 0);
+    EXPECT_EQ(testing::internal::GetCapturedStdout(), expected);
+    EXPECT_EQ(flat.result().get_type(), NULL_TYPE);
+    Parser parser;
+    std::vector<Token> tokens;
+    tokenize(program, tokens);
+    parser.reset(std::move(tokens));
+    parser.parse();
+    FlatTree flat_tree;
+    Flattener flattener(flat_tree);
+    for (Node* statement : parser.get_statements())
+        flattener.add_statement(statement);
+    EXPECT_EQ(sizeof(FlatNode), 16);
+    EXPECT_EQ(flat_tree.statements.size(), 3);
+    EXPECT_LT(flat_tree.memory_used(), parser.get_arena().bytes_used());
+}
+/* TYPE CHECKER TESTS */
+TEST(TypeCheckerTest, Errors){
+    // type errors should be reported before anything is evaluated, even in branches that never run
+    Interpreter interpreter;
+    for (Backend backend : {TreeWalker, StackVM}){
+        interpreter.set_backend(backend);
+        testing::internal::CaptureStdout();
+        EXPECT_EQ(interpreter.run("println 1\nif false\nlet int q = 1.5\nend"), 1);
+        EXPECT_EQ(testing::internal::GetCapturedStdout(), "");
+    }
+    EXPECT_EQ(interpreter.run("let int a = 1\nlet float b = 2.0\na + b"), 1);
+    EXPECT_EQ(interpreter.run("let char c = 'c'\nc > 'a'"), 1);
+    EXPECT_EQ(interpreter.run("while 1\nend"), 1);
+    EXPECT_EQ(interpreter.run("true && 1"), 1);
+    // errors should point at the offending expression
+    testing::internal::CaptureStderr();
+    EXPECT_EQ(interpreter.run("let int n = 0\n\nn = 'x'"), 1);
+    interpreter.display_err();
+    EXPECT_NE(testing::internal::GetCapturedStderr().find("(line 3, col 3)"), std::string::npos);
+}
+TEST(TypeCheckerTest, Annotations){
+    std::vector<Token> tokens;
+    tokenize("let int i = 0\nwhile (i < 3)\ni = i + 1\nend\nif i == 3\n2\nelse\n'a'\nend", tokens);
+    Parser parser(std::move(tokens));
+    parser.parse();
+    TypeChecker checker;
+    for (Node* statement : parser.get_statements())
+        checker.check(statement);
+    // every node whose operand types are known should be marked
+    Node* loop = parser.get_statements()[1];
+    EXPECT_TRUE(loop->is_checked());
+    EXPECT_TRUE(static_cast<EvalBlockNode*>(static_cast<LoopBlockNode*>(loop)->get_condition())->get_body()->is_checked());
+    AsgnNode* asgn = static_cast<AsgnNode*>(static_cast<BlockNode*>(loop)->get_statements()[0]);
+    EXPECT_TRUE(asgn->is_checked());
+    EXPECT_TRUE(asgn->get_rhs()->is_checked());
+    EXPECT_TRUE(parser.get_statements()[2]->is_checked());
+    // the branches of this if differ in type, so comparing its value can only be checked at runtime
+    Arena arena;
+    CondBlockNode* cond = static_cast<CondBlockNode*>(parser.get_statements()[2]);
+    CompNode* comp = arena.make<CompNode>(cond, arena.make<LiteralNode>(Value::create(INT, 2)), Equal);
+    checker.check(comp);
+    EXPECT_FALSE(comp->is_checked());
+}
+
+/* OPTIMIZER TESTS */
+// parses and optimizes a program, returning its statements
+std::deque<Node*>& optimize_program(Parser& parser, std::string_view src){
+    std::vector<Token> tokens;
+    tokenize(src, tokens);
+    parser.reset(std::move(tokens));
+    parser.parse();
+    Optimizer optimizer(parser.get_arena());
+    for (Node*& statement : parser.get_statements())
+        statement = optimizer.optimize(statement);
+    return parser.get_statements();
+}
+TEST(OptimizerTest, Folding){
+    Parser parser;
+    // constant expressions should become a single literal, with any parentheses removed
+    std::deque<Node*>& statements = optimize_program(parser, "(2 * (3 + 4)) == 14\n(1.5 * 2.0)\n3 % 0");
+    ASSERT_EQ(statements[0]->get_node_type(), Literal_N);
+    EXPECT_TRUE(statements[0]->eval().as<bool>());
+    ASSERT_EQ(statements[1]->get_node_type(), Literal_N);
+    EXPECT_DOUBLE_EQ(statements[1]->eval().as<double>(), 3.0);
+    // expressions that would fail are left for the evaluator
+    EXPECT_EQ(statements[2]->get_node_type(), Arith_N);
+    // an int power is only folded if it fits in an int
+    statements = optimize_program(parser, "(64 ** 64)\n(2 ** 5)\n(2.0 ** 8.0)");
+    EXPECT_EQ(statements[0]->get_node_type(), Arith_N);
+    ASSERT_EQ(statements[1]->get_node_type(), Literal_N);
+    EXPECT_EQ(statements[1]->eval().as<int>(), ArithNode::apply(ArithPow, Value::create(INT, 2), Value::create(INT, 5)).as<int>());
+    EXPECT_EQ(statements[2]->get_node_type(), Literal_N);
+    // variables are never folded, but constant operands next to them are
+    statements = optimize_program(parser, "let int x = 1\nx + (2 * 3)");
+    ASSERT_EQ(statements[1]->get_node_type(), Arith_N);
+    EXPECT_EQ(static_cast<ArithNode*>(statements[1])->get_rhs()->get_node_type(), Literal_N);
+}
+TEST(OptimizerTest, DeadBranches){
+    Parser parser;
+    std::deque<Node*>& statements = optimize_program(parser, "if (1 < 2)\n5\nelse\n6\nend\nif false\n7\nend\nwhile (1 > 2)\n8\nend");
+    // a constant condition should leave only the branch that runs
+    ASSERT_EQ(statements[0]->get_node_type(), Block_N);
+    EXPECT_EQ(static_cast<BlockNode*>(statements[0])->block_type(), Base);
+    EXPECT_EQ(statements[0]->eval().as<int>(), 5);
+    EXPECT_EQ(statements[1]->get_node_type(), Literal_N);
+    EXPECT_TRUE(statements[1]->eval().is_null());
+    EXPECT_EQ(statements[2]->get_node_type(), Literal_N);
+}
+TEST(OptimizerTest, SameOutput){
+    // the examples should print the same thing with and without optimization
+    for (const char* name : {"fib.neb", "math.neb", "fib_no_print.neb"}){
+        std::string example = std::string(NEBULA_EXAMPLES_DIR "/") + name;
+        std::string outputs[2];
+        for (int level = 0; level < 2; level++){
+            Interpreter interpreter;
+            interpreter.set_opt_level(level);
+            testing::internal::CaptureStdout();
+            EXPECT_EQ(interpreter.run_file(example), 0);
+            outputs[level] = testing::internal::GetCapturedStdout();
+        }
+        EXPECT_EQ(outputs[0], outputs[1]) << example;
+    }
+}
+
+/* QUICKENING TESTS */
+// a node whose value can be swapped out between evaluations
+class StubNode: public Node{
+    public:
+        StubNode(const Value& val) {this->val = val; this->node_type = Literal_N;}
+        Value eval() override {return this->val;}
+        Value val;
+};
+TEST(QuickenTest, Deoptimise){
+    Arena arena;
+    StubNode lhs(Value::create(INT, 7)), rhs(Value::create(INT, 2));
+    ArithNode* generic = arena.make<ArithNode>(&lhs, &rhs, ArithMul, &arena);
+    EvalBlockNode parent(&arena);
+    parent.set_body(generic);
+    // the first evaluation should rewrite the node to a specialised one
+    EXPECT_EQ(parent.eval().as<int>(), 14);
+    EXPECT_NE(parent.get_body(), generic);
+    EXPECT_EQ(parent.get_body()->get_node_type(), Arith_N);
+    EXPECT_EQ(parent.eval().as<int>(), 14);
+    // a change in operand types should revert it to the generic node, without changing the result
+    lhs.val = Value::create(FLOAT, 1.5);
+    rhs.val = Value::create(FLOAT, 3.0);
+    Value res = parent.eval();
+    EXPECT_EQ(res.get_type(), FLOAT);
+    EXPECT_DOUBLE_EQ(res.as<double>(), 4.5);
+    EXPECT_EQ(parent.get_body(), generic);
+    // once deoptimised, the node should stay generic
+    lhs.val = Value::create(INT, 3);
+    rhs.val = Value::create(INT, 3);
+    EXPECT_EQ(parent.eval().as<int>(), 9);
+    EXPECT_EQ(parent.get_body(), generic);
+    // mismatched operands should still be reported by the specialised nodes
+    CompNode* comp = arena.make<CompNode>(&lhs, &rhs, LessThan, &arena);
+    parent.set_body(comp);
+    EXPECT_FALSE(parent.eval().as<bool>());
+    rhs.val = Value::create(CHAR, 'a');
+    EXPECT_THROW(parent.eval(), std::runtime_error);
+}
+TEST(QuickenTest, Programs){
+    // specialised nodes should give the same results as the VM, which never specialises
+    std::vector<std::string> programs = {
+        "let float f = 1.5\nlet int i = 0\nwhile (i < 10)\nf = f * 2.0\ni = i + 1\nend\nf",
+        "let int n = 0\nlet bool b = false\nwhile (n < 50)\nn = n + 3\nb = (n > 20) && (n < 40) || b\nend\nb",
+        "let int acc = 100\nlet int k = 1\nwhile (k < 8)\nacc = acc - (k ** 2) * 3 + (k % 5)\nk = k + 1\nend\nacc",
+    };
+    for (const std::string& program : programs){
+        Interpreter tree, vm;
+        tree.set_backend(TreeWalker);
+        ASSERT_EQ(tree.run(program), 0) << program;
+        ASSERT_EQ(vm.run(program), 0) << program;
+        EXPECT_EQ(tree.result().get_type(), vm.result().get_type());
+        EXPECT_TRUE(tree.result() == vm.result()) << program;
+    }
+}
+
+/* JIT TESTS */
+TEST(JitTest, HotLoops){
+    // loops that are compiled part way through should leave the same values behind as loops that are only interpreted
+    std::vector<std::string> programs = {
+        "let int i = 0\nlet int acc = 7\nwhile (i < 3000)\nacc = acc * 3 - i\ni = i + 1\nacc / 7\nend",
+        "let int i = 1\nlet int q = 0\nwhile (i < 2500)\nq = (q + 1000) % i - (5000 / i)\ni = i + 1\nend\nq",
+        "let float f = 1.0\nlet float g = 0.5\nlet int i = 0\nwhile (i < 4000)\nf = f * 1.0001 + g / 3.0 - 0.1\ni = i + 1\nend\nf",
+        "let int n = 0\nlet float x = 0.0\nlet bool b = false\nwhile (n < 2000)\nn = n + 1\nx = x + 0.5\nb = (x > 300.0) && (n != 700) || (x == 2.0)\nend\nb",
+        "let int i = 0\nlet int fib = 0\nwhile (i < 1500)\nlet int t = 977 % (fib + i + 1)\nfib = t\ni = i + 1\nend\nfib",
+        "let int ctr = 0\nlet int prev = 0\nlet int curr = 1\nlet int tmp = 0\nwhile (ctr < 3000)\ntmp = (curr + prev) % 1000\nprev = curr\ncurr = tmp\nctr = ctr + 1\nend\ncurr",
+        "let int outer = 0\nlet int total = 0\nwhile (outer < 30)\nlet int j = 0\nwhile (j < 100)\ntotal = total + j * outer\nj = j + 1\nend\nouter = outer + 1\nend\ntotal",
+    };
+    for (const std::string& program : programs){
+        Interpreter tree, jit;
+        tree.set_backend(TreeWalker);
+        jit.set_backend(Tiered);
+        ASSERT_EQ(tree.run(program), 0) << program;
+        ASSERT_EQ(jit.run(program), 0) << program;
+        EXPECT_EQ(tree.result().get_type(), jit.result().get_type()) << program;
+        EXPECT_TRUE(tree.result() == jit.result()) << program;
+    }
+}
+TEST(JitTest, Compiled){
+#ifdef NEBULA_JIT
+    // only loops made up entirely of supported nodes should be compiled
+    std::vector<Token> tokens;
+    tokenize("let int i = 0\nlet float f = 0.5\nwhile (i < 5000)\nf = f + 0.25\ni = i + 1\nend\nwhile (i < 6000)\ni = i + (1 ** 1)\nend", tokens);
+    Parser parser(std::move(tokens));
+    parser.set_jit(true);
+    parser.parse();
+    std::vector<LoopBlockNode*> loops;
+    while (Node* expr = parser.next_expr()){
+        expr->eval();
+        if (expr->get_node_type() == Block_N && static_cast<BlockNode*>(expr)->block_type() == Loop)
+            loops.push_back(static_cast<LoopBlockNode*>(expr));
+    }
+    ASSERT_EQ(loops.size(), 2);
+    EXPECT_TRUE(loops[0]->is_compiled());
+    EXPECT_FALSE(loops[1]->is_compiled());
+    EXPECT_EQ(parser.get_environment().at(0, 0).as<int>(), 6000);
+    EXPECT_DOUBLE_EQ(parser.get_environment().at(0, 1).as<double>(), 1250.5);
+#endif
+}
+
+/* C EMITTER TESTS */
+// compiles a C program with the system compiler, and returns everything it printed
+std::string run_c(const std::string& source){
+    std::string path = testing::TempDir() + "nebula_emit_test";
+    std::ofstream(path + ".c") << source;
+    if (std::system(("cc -O2 -o " + path + " " + path + ".c").c_str()) != 0)
+        return "<failed to compile>";
+    std::string output;
+    char buffer[256];
+    FILE* pipe = popen(path.c_str(), "r");
+    while (size_t count = fread(buffer, 1, sizeof(buffer), pipe))
+        output.append(buffer, count);
+    pclose(pipe);
+    return output;
+}
+// runs a program on the interpreter, and returns everything it printed
+std::string run_interpreted(std::string_view program){
+    Interpreter interpreter;
+    testing::internal::CaptureStdout();
+    EXPECT_EQ(interpreter.run(program), 0);
+    return testing::internal::GetCapturedStdout();
+}
+TEST(EmitCTest, Examples){
+    if (std::system("cc --version > /dev/null 2>&1") != 0)
+        GTEST_SKIP() << "no C compiler is available";
+    // every example should print the same thing when it's compiled as when it's interpreted
+    for (const char* name : {"fib.neb", "fib_no_print.neb", "math.neb"}){
+        SourceFile source;
+        ASSERT_TRUE(source.open(std::string(NEBULA_EXAMPLES_DIR) + "/" + name)) << name;
+        std::ostringstream c_source;
+        Interpreter emitter;
+        ASSERT_EQ(emitter.emit_c(source.view(), c_source), 0) << name;
+        EXPECT_EQ(run_c(c_source.str()), run_interpreted(source.view())) << name;
+    }
+}
+TEST(EmitCTest, Programs){
+    if (std::system("cc --version > /dev/null 2>&1") != 0)
+        GTEST_SKIP() << "no C compiler is available";
+    // operands with side effects must be evaluated in the same order as the interpreter evaluates them
+    std::vector<std::string> programs = {
+        "let int x = 1\nlet int i = 0\nwhile (i < 10)\nx = x * 3 - i\nif (x > 100)\nprint x ' '\nelse\nprint i ' '\nend\ni = i + 1\nend\nprintln x",
+        "let float f = 2.5\nlet bool b = true\nlet int n = 0\nwhile (n < 5)\nf = f * 1.5 - 0.25\nb = (f > 4.0) && b || (n == 3)\nprintln b\nn = n + 1\nend\nprintln f",
+        "let int x = 1\nlet int y = (x = 6) * x\nprintln y",
+        "println (2 ** 5)\nprintln (7 % 3)\nprintln (2.0 ** 3.0)\nlet char c = 'q'\nprintln c",
+    };
+    for (const std::string& program : programs){
+        std::ostringstream c_source;
+        Interpreter emitter;
+        ASSERT_EQ(emitter.emit_c(program, c_source), 0) << program;
+        EXPECT_EQ(run_c(c_source.str()), run_interpreted(program)) << program;
+    }
+    // an error should be reported for anything that can't be translated
+    Interpreter emitter;
+    std::ostringstream c_source;
+    EXPECT_EQ(emitter.emit_c("let int y\ny", c_source), 1);
+    EXPECT_EQ(Interpreter().emit_c("let float z = 0.5\nprintln (z % z)", c_source), 1);
+    // dividing by zero exits with an error instead of trapping, so everything printed before it is still written
+    c_source.str("");
+    ASSERT_EQ(emitter.emit_c("let int a = 0\nprintln 'x'\nprintln (a / 1)", c_source), 0);
+    EXPECT_EQ(run_c(c_source.str()), "x\n");
+}
+
+/* SOURCE TESTS */
+TEST(SourceTest, Files){
+    std::string path = testing::TempDir() + "nebula_source_test.neb";
+    std::ofstream(path) << "let int x = 3\nx * 4";
+    // regular files should be mapped rather than copied
+    SourceFile source;
+    EXPECT_TRUE(source.open(path));
+    EXPECT_TRUE(source.is_mapped());
+    EXPECT_EQ(source.view(), "let int x = 3\nx * 4");
+    Interpreter interpreter;
+    EXPECT_EQ(interpreter.run_file(path), 0);
+    EXPECT_EQ(interpreter.result().as<int>(), 12);
+    // empty files can't be mapped, but are still valid
+    std::ofstream(path, std::ios::trunc).close();
+    EXPECT_TRUE(source.open(path));
+    EXPECT_EQ(source.view().size(), 0);
+    std::remove(path.c_str());
+    EXPECT_FALSE(source.open(path));
+    EXPECT_FALSE(source.open(testing::TempDir()));
+    EXPECT_EQ(interpreter.run_file(path), 1);
+}
+
+/* CACHE TESTS */
+TEST(CacheTest, Files){
+    std::string path = testing::TempDir() + "nebula_cache_test.neb", cache = cache_path(path);
+    EXPECT_EQ(cache, path + "c");
+    EXPECT_EQ(cache_path("script.txt"), "script.txt.nebc");
+    std::remove(cache.c_str());
+    std::ofstream(path) << "let int x = 3\nlet float y = 1.5\nwhile x < 10\n  x = x + 1\nend\nprintln x, ' ', y\nx * 4";
+    std::string outputs[2];
+    // the first run compiles the program and saves it, the second loads it without parsing
+    for (int i = 0; i < 2; i++){
+        Interpreter interpreter;
+        interpreter.set_cache(true);
+        testing::internal::CaptureStdout();
+        EXPECT_EQ(interpreter.run_file(path), 0);
+        outputs[i] = testing::internal::GetCapturedStdout();
+        EXPECT_EQ(interpreter.result().as<int>(), 40);
+        EXPECT_TRUE(SourceFile().open(cache));
+    }
+    EXPECT_EQ(outputs[0], outputs[1]);
+    RegProgram program;
+    SourceFile source;
+    ASSERT_TRUE(source.open(path));
+    EXPECT_TRUE(load_program(cache, cache_key(source.view(), 1), program));
+    EXPECT_FALSE(load_program(cache, cache_key(source.view(), 0), program));
+    // changing the source makes the cache stale
+    std::ofstream(path, std::ios::trunc) << "let int x = 5\nx * 4";
+    {
+        Interpreter interpreter;
+        interpreter.set_cache(true);
+        EXPECT_EQ(interpreter.run_file(path), 0);
+        EXPECT_EQ(interpreter.result().as<int>(), 20);
+    }
+    // a damaged cache is ignored, no matter where it is cut off
+    std::ifstream in(cache, std::ios::binary);
+    std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    for (size_t len = 0; len < contents.size(); len += 7){
+        std::ofstream(cache, std::ios::binary | std::ios::trunc) << contents.substr(0, len);
+        Interpreter interpreter;
+        interpreter.set_cache(true);
+        EXPECT_EQ(interpreter.run_file(path), 0);
+        EXPECT_EQ(interpreter.result().as<int>(), 20);
+    }
+    // the cache is off unless it's turned on, in which case it isn't read or written
+    std::remove(cache.c_str());
+    Interpreter interpreter;
+    EXPECT_EQ(interpreter.run_file(path), 0);
+    EXPECT_FALSE(SourceFile().open(cache));
+    std::remove(path.c_str());
+}
+
+TEST(StreamTest, Basic){
+    std::string src = "let int x = 3; let char c = ';'\nwhile x < 10\n  x = x + 1\nend\nprint c\n";
+    std::vector<Token> expected;
+    tokenize(src, expected);
+    // streaming with tiny chunks should produce the same tokens, with the same positions
+    std::istringstream in(src);
+    TokenStream stream(in, 4);
+    std::vector<Token> tokens;
+    while (stream.next(tokens));
+    ASSERT_EQ(tokens.size(), expected.size());
+    for (size_t i = 0; i < tokens.size(); i++){
+        EXPECT_EQ(tokens[i].type, expected[i].type);
+        EXPECT_EQ(tokens[i].txt, expected[i].txt);
+        EXPECT_EQ(tokens[i].line, expected[i].line);
+        EXPECT_EQ(tokens[i].col, expected[i].col);
+    }
+    EXPECT_EQ(find_break("x = ';'"), std::string_view::npos);
+    EXPECT_EQ(find_break("x\ny;z"), 3);
+    // statements should be evaluated before the rest of the source is parsed
+    Interpreter interpreter;
+    std::istringstream partial("let int y = 5\ny * 2\n)");
+    EXPECT_EQ(interpreter.run_stream(partial), 1);
+    EXPECT_EQ(interpreter.result().as<int>(), 10);
+    std::istringstream unclosed("let int z = 5\nwhile z > 0\nz = z - 1\n");
+    EXPECT_EQ(interpreter.run_stream(unclosed), 1);
+    for (Backend backend : {StackVM, TreeWalker}){
+        Interpreter streamed;
+        streamed.set_backend(backend);
+        std::ifstream fib(NEBULA_EXAMPLES_DIR "/fib_no_print.neb");
+        EXPECT_EQ(streamed.run_stream(fib), 0);
+        EXPECT_EQ(streamed.result().as<int>(), 6765);
+    }
+}
+
+TEST(StreamTest, ChunkBoundaries){
+    // a character literal holding a break must never be cut in half, wherever the reads that fill a chunk end
+    std::string src = "let char c = ';'            \nc\nlet char d = ';'\nd";
+    std::vector<Token> expected;
+    tokenize(src, expected);
+    for (size_t chunk_size = 1; chunk_size <= src.size(); chunk_size++){
+        std::istringstream in(src);
+        TokenStream stream(in, chunk_size);
+        std::vector<Token> tokens;
+        EXPECT_NO_THROW(while (stream.next(tokens))) << chunk_size;
+        ASSERT_EQ(tokens.size(), expected.size()) << chunk_size;
+        for (size_t i = 0; i < tokens.size(); i++)
+            EXPECT_EQ(tokens[i].txt, expected[i].txt) << chunk_size;
+    }
+    std::istringstream in(src);
+    Interpreter interpreter;
+    EXPECT_EQ(interpreter.run_stream(in), 0);
+    EXPECT_EQ(interpreter.result().as<char>(), ';');
+}
+
+TEST(StreamTest, BoundedBuffers){
+    // only the chunks holding the statement being parsed should be kept
+    std::string src;
+    for (int i = 0; i < 2000; i++)
+        src += "let int v" + std::to_string(i) + " = " + std::to_string(i) + "\n";
+    std::istringstream in(src);
+    TokenStream stream(in, 64);
+    Parser parser;
+    parser.reset(&stream);
+    size_t max_chunks = 0, count = 0;
+    while (Node* expr = parser.parse_next()){
+        expr->eval();
+        parser.release();
+        max_chunks = std::max(max_chunks, stream.buffered_chunks());
+        count++;
+    }
+    EXPECT_EQ(count, 2000);
+    EXPECT_LE(max_chunks, 2);
+    EXPECT_EQ(parser.get_environment().at(0, 1999).as<int>(), 1999);
+    parser.reset(std::vector<Token>());
+}
+
+/* OUTPUT TESTS */
+TEST(OutputTest, Formatting){
+    // values are printed the same way by every backend, with floats formatted like printf's %g
+    std::string program = "let float f = 2.5\nlet bool b = true\nlet int n = 42\nprintln f ' ' 0.1 ' ' b ' ' false ' ' n ' ' 'c' ' ' (f * 4.0)";
+    for (Backend backend : {TreeWalker, StackVM, RegisterVM, FlatTreeWalker}){
+        Interpreter interpreter;
+        std::ostringstream out;
+        interpreter.set_backend(backend);
+        interpreter.set_output(out);
+        EXPECT_EQ(interpreter.run(program), 0);
+        EXPECT_EQ(out.str(), "2.5 0.1 true false 42 c 10\n");
+    }
+    std::ostringstream out;
+    out << Value::create(FLOAT, 1e20) << ' ' << Value::create(INT, -42) << ' ' << Value(NULL_TYPE);
+    EXPECT_EQ(out.str(), "1e+20 -42 null");
+}
+TEST(OutputTest, FlushPolicy){
+    // output is only written when the policy says so, but always by the time the program has finished
+    std::ostringstream out;
+    OutputBuffer buffer(out, FlushSize);
+    buffer.write(Value::create(INT, 7));
+    buffer.end_print(true);
+    EXPECT_EQ(out.str(), "");
+    EXPECT_EQ(buffer.pending(), 2);
+    buffer.set_policy(FlushLine);
+    buffer.write("x");
+    buffer.end_print(false);
+    EXPECT_EQ(out.str(), "7\nx");
+    // a full buffer is written out, unless everything is held until exit
+    buffer.set_policy(FlushSize);
+    std::string line(1000, 'a');
+    for (int i = 0; i < 100; i++)
+        buffer.write(line);
+    EXPECT_LT(buffer.pending(), OutputBuffer::CAPACITY);
+    EXPECT_EQ(out.str().size() + buffer.pending(), 100003);
+    buffer.flush();
+    buffer.set_policy(FlushExit);
+    for (int i = 0; i < 100; i++)
+        buffer.write(line);
+    EXPECT_EQ(buffer.pending(), 100000);
+    for (FlushPolicy policy : {FlushLine, FlushSize, FlushExit}){
+        Interpreter interpreter;
+        std::ostringstream program_out;
+        interpreter.set_output(program_out);
+        interpreter.set_flush_policy(policy);
+        EXPECT_EQ(interpreter.run("let int i = 0\nwhile (i < 3)\nprintln i\ni = i + 1\nend"), 0);
+        EXPECT_EQ(program_out.str(), "0\n1\n2\n");
+        // output printed before an error is still written
+        EXPECT_EQ(interpreter.run("println 'e'\nlet int q"), 1);
+        EXPECT_EQ(program_out.str(), "0\n1\n2\ne\n");
+    }
+}
+
+/* DAEMON TESTS */
+TEST(DaemonTest, Requests){
+    std::string socket_path = testing::TempDir() + "nebula_daemon_test.sock";
+    Daemon daemon(socket_path);
+    std::thread server([&daemon]{ EXPECT_TRUE(daemon.serve()); });
+    // requests fail until the daemon is listening
+    DaemonReply reply;
+    std::string program = "let int x = 5\nprintln x\nx * 2";
+    bool sent = false;
+    for (int i = 0; i < 200 && !sent; i++){
+        sent = send_request(socket_path, RunSource, program, reply);
+        if (!sent)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_TRUE(sent);
+    EXPECT_EQ(reply.status, 0);
+    EXPECT_EQ(reply.output, "5\n");
+    EXPECT_EQ(reply.result_type, INT);
+    EXPECT_EQ(reply.result, "10");
+    // running the script again reuses its program, and every request starts without any globals
+    ASSERT_TRUE(send_request(socket_path, RunSource, program, reply));
+    EXPECT_EQ(reply.output, "5\n");
+    ASSERT_TRUE(send_request(socket_path, RunSource, "let float x = 1.5\nx", reply));
+    EXPECT_EQ(reply.status, 0);
+    EXPECT_EQ(reply.result, "1.5");
+    // errors are reported back, along with anything printed before them
+    ASSERT_TRUE(send_request(socket_path, RunSource, "let int y = true", reply));
+    EXPECT_EQ(reply.status, 1);
+    EXPECT_FALSE(reply.err_msg.empty());
+    ASSERT_TRUE(send_request(socket_path, RunSource, "println 'e'\nlet int q", reply));
+    EXPECT_EQ(reply.status, 1);
+    EXPECT_EQ(reply.output, "e\n");
+    // the daemon reads scripts sent by path itself
+    std::string file_path = testing::TempDir() + "nebula_daemon_test.neb";
+    {
+        std::ofstream file(file_path);
+        file << "let int i = 0\nwhile (i < 3)\nprint i\ni = i + 1\nend";
+    }
+    ASSERT_TRUE(send_request(socket_path, RunPath, file_path, reply));
+    EXPECT_EQ(reply.status, 0);
+    EXPECT_EQ(reply.output, "012");
+    std::remove(file_path.c_str());
+    ASSERT_TRUE(send_request(socket_path, RunPath, file_path, reply));
+    EXPECT_EQ(reply.status, 1);
+    ASSERT_TRUE(send_request(socket_path, Shutdown, "", reply));
+    EXPECT_EQ(reply.status, 0);
+    server.join();
+    EXPECT_FALSE(send_request(socket_path, RunSource, program, reply));
+    // replies come from workers, so the cache is only checked once the daemon has stopped. Scripts that failed to compile or
+    // couldn't be read aren't cached, and the first script was only compiled once
+    EXPECT_EQ(daemon.cached_programs(), 4);
+}
+TEST(DaemonTest, Isolation){
+    // nothing but a socket left behind by an exited daemon is ever replaced
+    std::string socket_path = testing::TempDir() + "nebula_daemon_isolation.sock";
+    // a socket left behind by a run that was killed can't be opened as a file
+    std::remove(socket_path.c_str());
+    std::ofstream(socket_path) << "not a socket";
+    Daemon blocked(socket_path);
+    EXPECT_FALSE(blocked.serve());
+    EXPECT_TRUE(SourceFile().open(socket_path));
+    std::remove(socket_path.c_str());
+    Daemon daemon(socket_path);
+    std::thread server([&daemon]{ EXPECT_TRUE(daemon.serve()); });
+    DaemonReply reply;
+    bool sent = false;
+    for (int i = 0; i < 200 && !sent; i++){
+        sent = send_request(socket_path, RunSource, "1", reply);
+        if (!sent)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_TRUE(sent);
+    Daemon second(socket_path);
+    EXPECT_FALSE(second.serve());
+    EXPECT_NE(second.get_err().find("already listening"), std::string::npos);
+    // a client that never sends its request is dropped once it times out, rather than holding up everyone else
+    int stalled = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+    ASSERT_EQ(connect(stalled, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+    // a runtime error in one script doesn't stop the daemon serving the next
+    ASSERT_TRUE(send_request(socket_path, RunSource, "let int a = 0\nprintln (a / 1)", reply));
+    EXPECT_EQ(reply.status, 1);
+    EXPECT_EQ(reply.err_msg, "cannot divide by zero");
+    close(stalled);
+    // neither does a script that crashes the compiler by nesting deeply enough to overflow its stack
+    std::string deep = std::string(1000000, '(') + "1" + std::string(1000000, ')');
+    ASSERT_TRUE(send_request(socket_path, RunSource, deep, reply));
+    EXPECT_EQ(reply.status, 1);
+    // or a script the compiler never finishes, which is killed once it runs out of time
+    ASSERT_TRUE(send_request(socket_path, RunSource, "!", reply));
+    EXPECT_EQ(reply.status, 1);
+    EXPECT_EQ(reply.err_msg, "the script took too long to compile");
+    ASSERT_TRUE(send_request(socket_path, RunSource, "let int a = 3\na * 2", reply));
+    EXPECT_EQ(reply.status, 0);
+    EXPECT_EQ(reply.result, "6");
+    // a client that reads a large output slowly still gets all of it, since only the request has to arrive in time
+    int slow = socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT_EQ(connect(slow, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+    std::string request = "let int i = 0\nwhile i < 300000\nprintln i\ni = i + 1\nend";
+    uint32_t size = request.size();
+    request.insert(0, reinterpret_cast<const char*>(&size), sizeof(size));
+    request.insert(request.begin(), RunSource);
+    ASSERT_EQ(send(slow, request.data(), request.size(), 0), static_cast<ssize_t>(request.size()));
+    std::this_thread::sleep_for(std::chrono::milliseconds(Daemon::RECEIVE_TIMEOUT_MS * 3));
+    std::string received;
+    char buffer[4096];
+    for (ssize_t len; (len = recv(slow, buffer, sizeof(buffer), 0)) > 0;)
+        received.append(buffer, len);
+    close(slow);
+    uint32_t output_size = 0;
+    for (int i = 0; i < 300000; i++)
+        output_size += std::to_string(i).size() + 1;
+    // the reply is its status and result type, followed by the output's length and the output itself
+    EXPECT_GT(received.size(), 6 + output_size);
+    if (received.size() > 6){
+        EXPECT_EQ(received[0], 0);
+        EXPECT_EQ(std::memcmp(received.data() + 2, &output_size, sizeof(output_size)), 0);
+    }
+    ASSERT_TRUE(send_request(socket_path, Shutdown, "", reply));
+    server.join();
+}
+
+/* BATCH TESTS */
+TEST(BatchTest, Isolates){
+    // every script declares the same globals, which would be a redeclaration if any two scripts shared an interpreter
+    std::vector<std::string> scripts;
+    for (int i = 0; i < 64; i++){
+        scripts.push_back("let int x = " + std::to_string(i) + "\nlet int total = 0\nlet int j = 0\nwhile (j < 1000)\n"
+                          "total = total + x\nj = j + 1\nend\nprintln x\ntotal");
+    }
+    scripts[10] = "println 'e'\nlet int q";
+    for (Backend backend : {TreeWalker, StackVM, RegisterVM, Tiered, FlatTreeWalker}){
+        BatchRunner runner(4);
+        runner.set_backend(backend);
+        EXPECT_EQ(runner.get_threads(), 4);
+        std::vector<ScriptResult> results = runner.run(scripts);
+        ASSERT_EQ(results.size(), scripts.size());
+        for (int i = 0; i < 64; i++){
+            if (i == 10){
+                EXPECT_EQ(results[i].status, 1);
+                EXPECT_EQ(results[i].output, "e\n");
+                EXPECT_FALSE(results[i].err_msg.empty());
+                continue;
+            }
+            EXPECT_EQ(results[i].status, 0);
+            EXPECT_EQ(results[i].output, std::to_string(i) + "\n");
+            EXPECT_EQ(results[i].result_type, INT);
+            EXPECT_EQ(results[i].result, std::to_string(i * 1000));
+        }
+    }
+    EXPECT_TRUE(BatchRunner(2).run({}).empty());
+}
+
+/* PROFILER TESTS */
+TEST(ProfilerTest, Lines){
+    std::string program = "let int i = 0\nlet int total = 0\nwhile (i < 100)\n    total = total + i\n    i = i + 1\nend\ntotal";
+    Profiler profiler;
+    Interpreter interpreter;
+    interpreter.set_backend(RegisterVM);
+    interpreter.set_profiler(&profiler);
+    EXPECT_EQ(interpreter.get_backend(), TreeWalker);
+    ASSERT_EQ(interpreter.run(program), 0);
+    EXPECT_EQ(interpreter.result().as<int>(), 4950);
+    std::vector<LineProfile> hot = profiler.hot_lines();
+    ASSERT_EQ(hot.size(), 6);
+    std::vector<LineProfile> lines(8);
+    for (const LineProfile& profile : hot){
+        EXPECT_LE(profile.exclusive, profile.inclusive);
+        lines[profile.line] = profile;
+    }
+    EXPECT_GE(lines[3].evals, 101);
+    EXPECT_GE(lines[4].evals, 100);
+    EXPECT_GE(lines[5].evals, 100);
+    EXPECT_EQ(lines[6].evals, 0);
+    // the loop's time includes its body
+    EXPECT_GE(lines[3].inclusive, lines[4].inclusive + lines[5].inclusive);
+    std::ostringstream folded;
+    profiler.write_folded(folded, program);
+    EXPECT_NE(folded.str().find("3: while (i < 100);4: total = total + i "), std::string::npos);
+    std::ostringstream report;
+    profiler.report(report, program, 2);
+    std::string table = report.str();
+    EXPECT_EQ(std::count(table.begin(), table.end(), '\n'), 3);
+    // an error part way through a line closes its frames, and the profiler is only active while the interpreter is running
+    profiler.clear();
+    EXPECT_EQ(interpreter.run("let int j = 0\nwhile (j < 5)\n    j = j + 1\n    let int q\nend"), 1);
+    EXPECT_EQ(active_profiler, nullptr);
+    hot = profiler.hot_lines();
+    ASSERT_EQ(hot.size(), 4);
+    EXPECT_GT(std::find_if(hot.begin(), hot.end(), [](const LineProfile& profile){ return profile.line == 2; })->inclusive, 0);
+}
 
 TEST(InterpreterTest, Final){
     // this simple program serves as the first "real" test of nebula, it should calculate the 20th fibonacci number
@@ -261,6 +1387,13 @@ TEST(InterpreterTest, Final){
         interpreter.display_err();
     Value val = interpreter.result();
     EXPECT_EQ(val.as<int>(), 6765);
+    // ensure the tree walker agrees
+    interpreter.set_backend(TreeWalker);
+    res = interpreter.run_file("../examples/fib_no_print.neb");
+    if (res != 0)
+        interpreter.display_err();
+    val = interpreter.result();
+    EXPECT_EQ(val.as<int>(), 6765);
 }
 
 int main(int argc, char** argv){